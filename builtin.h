@@ -15,9 +15,15 @@
 extern const char ndctl_usage_string[];
 extern const char ndctl_more_info_string[];
 
+/*
+ * @reset: restore the command's option state to its initial values, for
+ * running the command more than once per process. Commands without one
+ * can not be run from 'ndctl batch'.
+ */
 struct cmd_struct {
 	const char *cmd;
 	int (*fn)(int, const char **, void *ctx);
+	void (*reset)(void);
 };
 
 int cmd_create_nfit(int argc, const char **argv, void *ctx);
@@ -48,4 +54,18 @@ int cmd_bat(int argc, const char **argv, void *ctx);
 #endif
 int cmd_update_firmware(int argc, const char **argv, void *ctx);
 int cmd_inject_smart(int argc, const char **argv, void *ctx);
+
+void builtin_xaction_namespace_reset(void);
+void builtin_xaction_region_reset(void);
+void builtin_xaction_dimm_reset(void);
+void builtin_bus_reset(void);
+void builtin_list_reset(void);
+
+int batch_run(int argc, const char **argv, void *ctx,
+		struct cmd_struct *cmds, int num_cmds);
+int batch_split(char *line, const char **argv, int max);
+struct cmd_struct *batch_find(const char *name, struct cmd_struct *cmds,
+		int num_cmds);
+int daemon_serve(int argc, const char **argv, void *ctx,
+		struct cmd_struct *cmds, int num_cmds);
 #endif /* _NDCTL_BUILTIN_H_ */
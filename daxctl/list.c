@@ -80,8 +80,7 @@ int cmd_list(int argc, const char **argv, void *ctx)
 		"daxctl list [<options>]",
 		NULL
 	};
-	struct json_object *jregions = NULL;
-	struct json_object *jdevs = NULL;
+	struct util_json_stream js;
 	struct daxctl_region *region;
 	unsigned long list_flags;
 	int i;
@@ -102,39 +101,46 @@ int cmd_list(int argc, const char **argv, void *ctx)
 		list.devs = true;
 
 	list_flags = listopts_to_flags();
+	util_json_stream_init(&js, stdout, list_flags);
+	util_json_stream_list_begin(&js);
 
 	daxctl_region_foreach(ctx, region) {
-		struct json_object *jregion = NULL;
+		struct json_object *jregion;
+		struct daxctl_dev *dev;
 
 		if (param.region_id >= 0 && param.region_id
 				!= daxctl_region_get_id(region))
 			continue;
 
 		if (list.regions) {
-			if (!jregions) {
-				jregions = json_object_new_array();
-				if (!jregions) {
-					fail("\n");
-					continue;
-				}
-			}
-
 			jregion = util_daxctl_region_to_json(region,
 					param.dev, list_flags);
 			if (!jregion) {
 				fail("\n");
 				continue;
 			}
-			json_object_array_add(jregions, jregion);
-		} else if (list.devs)
-			jdevs = util_daxctl_devs_to_list(region, jdevs,
-					param.dev, list_flags);
-	}
+			util_json_stream_add(&js, NULL, jregion);
+			continue;
+		}
+
+		daxctl_dev_foreach(region, dev) {
+			struct json_object *jdev;
+
+			if (!util_daxctl_dev_filter(dev, param.dev))
+				continue;
+
+			if (!list.idle && !daxctl_dev_get_size(dev))
+				continue;
 
-	if (jregions)
-		util_display_json_array(stdout, jregions, list_flags);
-	else if (jdevs)
-		util_display_json_array(stdout, jdevs, list_flags);
+			jdev = util_daxctl_dev_to_json(dev, list_flags);
+			if (!jdev) {
+				fail("\n");
+				continue;
+			}
+			util_json_stream_add(&js, NULL, jdev);
+		}
+	}
+	util_json_stream_end(&js);
 
 	if (did_fail)
 		return -ENOMEM;
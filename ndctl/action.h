@@ -5,6 +5,8 @@
  */
 #ifndef __NDCTL_ACTION_H__
 #define __NDCTL_ACTION_H__
+#include <stdbool.h>
+
 enum device_action {
 	ACTION_ENABLE,
 	ACTION_DISABLE,
@@ -14,4 +16,22 @@ enum device_action {
 	ACTION_WAIT,
 	ACTION_START,
 };
+
+struct ndctl_region;
+
+/**
+ * struct region_job - one region's share of a bulk action
+ * @region: region to act on, along with its namespaces
+ * @rc: result of the last operation, set by the job function
+ * @processed: count of objects successfully acted on
+ * @acted: whether the job found any object to act on
+ */
+struct region_job {
+	struct ndctl_region *region;
+	int rc, processed;
+	bool acted;
+};
+
+void region_jobs_run(struct region_job *jobs, int count,
+		void (*fn)(struct region_job *job, void *arg), void *arg);
 #endif /* __NDCTL_ACTION_H__ */
@@ -0,0 +1,185 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* Copyright(c) 2018 Intel Corporation. All rights reserved. */
+#include <stdio.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <builtin.h>
+#include <util/util.h>
+#include <util/parse-options.h>
+#include <ndctl/libndctl.h>
+#include <ccan/array_size/array_size.h>
+
+#define BATCH_MAX_ARGS 64
+
+static struct {
+	bool keep_going;
+	bool verbose;
+} param;
+
+/*
+ * Split @line in place into at most @max - 1 arguments, honoring single
+ * and double quotes and backslash escapes. A '#' starting an argument
+ * comments out the rest of the line.
+ */
+int batch_split(char *line, const char **argv, int max)
+{
+	char *in = line, *out = line;
+	int argc = 0;
+
+	for (;;) {
+		char quote = 0;
+
+		while (isspace((unsigned char) *in))
+			in++;
+		if (!*in || *in == '#')
+			break;
+		if (argc == max - 1)
+			return -E2BIG;
+
+		argv[argc++] = out;
+		while (*in && (quote || !isspace((unsigned char) *in))) {
+			if (quote && *in == quote) {
+				quote = 0;
+				in++;
+				continue;
+			}
+			if (!quote && (*in == '\'' || *in == '"')) {
+				quote = *in++;
+				continue;
+			}
+			if (*in == '\\' && quote != '\'' && in[1])
+				in++;
+			*out++ = *in++;
+		}
+		if (quote)
+			return -EINVAL;
+		if (*in)
+			in++;
+		*out++ = '\0';
+	}
+
+	argv[argc] = NULL;
+	return argc;
+}
+
+struct cmd_struct *batch_find(const char *name,
+		struct cmd_struct *cmds, int num_cmds)
+{
+	int i;
+
+	for (i = 0; i < num_cmds; i++)
+		if (strcmp(cmds[i].cmd, name) == 0)
+			return &cmds[i];
+	return NULL;
+}
+
+/*
+ * Run each line of the input as an ndctl command against the one @ctx.
+ * Commands keep the library's view of the objects they change current,
+ * and with the udev monitor enabled, changes the kernel reports in
+ * between refresh only the affected objects, so the topology is
+ * enumerated once for the whole batch. Without it, the ctx is
+ * invalidated before each command instead.
+ */
+int batch_run(int argc, const char **argv, void *ctx,
+		struct cmd_struct *cmds, int num_cmds)
+{
+	const struct option options[] = {
+		OPT_BOOLEAN('k', "keep-going", &param.keep_going,
+				"continue after a command fails"),
+		OPT_BOOLEAN('v', "verbose", &param.verbose,
+				"echo each command to stderr"),
+		OPT_END(),
+	};
+	const char * const u[] = {
+		"ndctl batch [<file>] [<options>]",
+		NULL
+	};
+	const char *cmd_argv[BATCH_MAX_ARGS];
+	int i, rc = 0, cmd_rc, nargs, priority, lineno = 0;
+	const char *file = "-";
+	struct cmd_struct *cmd;
+	bool udev = true;
+	size_t size = 0;
+	char *line = NULL;
+	ssize_t len;
+	FILE *f;
+
+	argc = parse_options(argc, argv, options, u, 0);
+	for (i = 1; i < argc; i++)
+		error("unknown extra parameter \"%s\"\n", argv[i]);
+	if (argc > 1)
+		usage_with_options(u, options);
+	if (argc)
+		file = argv[0];
+
+	if (strcmp(file, "-") == 0)
+		f = stdin;
+	else
+		f = fopen(file, "r");
+	if (!f) {
+		rc = -errno;
+		error("failed to open %s: %s\n", file, strerror(-rc));
+		return rc;
+	}
+
+	if (ndctl_enable_udev_monitor(ctx) < 0)
+		udev = false;
+	priority = ndctl_get_log_priority(ctx);
+
+	while ((len = getline(&line, &size, f)) >= 0) {
+		lineno++;
+		if (len && line[len - 1] == '\n')
+			line[len - 1] = '\0';
+
+		nargs = batch_split(line, cmd_argv, ARRAY_SIZE(cmd_argv));
+		if (nargs == 0)
+			continue;
+		if (nargs < 0) {
+			error("%s:%d: %s\n", file, lineno, nargs == -E2BIG
+					? "too many arguments"
+					: "unterminated quote");
+			cmd_rc = nargs;
+			goto next;
+		}
+
+		cmd = batch_find(cmd_argv[0], cmds, num_cmds);
+		if (!cmd || !cmd->reset) {
+			error("%s:%d: '%s' is not a batch command\n", file,
+					lineno, cmd_argv[0]);
+			cmd_rc = -EINVAL;
+			goto next;
+		}
+
+		if (param.verbose) {
+			fprintf(stderr, "%s:%d:", file, lineno);
+			for (i = 0; i < nargs; i++)
+				fprintf(stderr, " %s", cmd_argv[i]);
+			fprintf(stderr, "\n");
+		}
+
+		if (udev)
+			ndctl_process_udev_events(ctx);
+		else
+			ndctl_invalidate(ctx);
+		cmd->reset();
+		cmd_rc = cmd->fn(nargs, cmd_argv, ctx);
+		fflush(stdout);
+		ndctl_set_log_priority(ctx, priority);
+ next:
+		if (cmd_rc) {
+			rc = cmd_rc;
+			if (!param.keep_going) {
+				error("%s:%d: stopping batch\n", file, lineno);
+				break;
+			}
+		}
+	}
+
+	free(line);
+	if (f != stdin)
+		fclose(f);
+	return rc;
+}
@@ -2,12 +2,16 @@
 /* Copyright(c) 2015-2018 Intel Corporation. All rights reserved. */
 #include <stdio.h>
 #include <errno.h>
+#include <limits.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <ndctl.h>
 #include "action.h"
 #include <syslog.h>
 #include <builtin.h>
 #include <util/json.h>
+#include <util/size.h>
 #include <util/filter.h>
 #include <json-c/json.h>
 #include <util/parse-options.h>
@@ -16,23 +20,328 @@
 
 static struct {
 	bool verbose;
+	bool wait;
+	bool badblocks;
+	const char *range;
+	const char *namespace;
 } param;
 
+void builtin_bus_reset(void)
+{
+	memset(&param, 0, sizeof(param));
+}
+
 static const struct option bus_options[] = {
 	OPT_BOOLEAN('v',"verbose", &param.verbose, "turn on debug"),
 	OPT_END(),
 };
 
-static int scrub_action(struct ndctl_bus *bus, enum device_action action)
+static const struct option start_options[] = {
+	OPT_BOOLEAN('v',"verbose", &param.verbose, "turn on debug"),
+	OPT_BOOLEAN('w', "wait", &param.wait,
+			"wait for the scrubs to complete"),
+	OPT_STRING('R', "range", &param.range, "range-list",
+			"scrub only the comma separated <address>[+<length>] ranges"),
+	OPT_STRING('n', "namespace", &param.namespace, "namespace-id",
+			"scrub only within <namespace>, --range in its 512-byte sectors"),
+	OPT_BOOLEAN('B', "badblocks", &param.badblocks,
+			"scrub only the known badblocks"),
+	OPT_END(),
+};
+
+static int add_range(struct ndctl_range **ranges, int *count,
+		unsigned long long address, unsigned long long length)
+{
+	struct ndctl_range *r;
+
+	r = realloc(*ranges, (*count + 1) * sizeof(*r));
+	if (!r)
+		return -ENOMEM;
+	*ranges = r;
+	r[*count].address = address;
+	r[(*count)++].length = length;
+	return 0;
+}
+
+/*
+ * Parse the --range list into system physical address ranges. Within a
+ * namespace the ranges are in 512-byte sectors from the start of its
+ * data, as 'ndctl list --media-errors' reports badblocks.
+ */
+static int parse_ranges(const char *list, unsigned long long base,
+		unsigned long long size, struct ndctl_range **ranges,
+		int *count)
+{
+	char *buf, *tok, *save, *end;
+	unsigned long long addr, len;
+	int rc = 0;
+
+	buf = strdup(list);
+	if (!buf)
+		return -ENOMEM;
+
+	for (tok = strtok_r(buf, ",", &save); tok && rc == 0;
+			tok = strtok_r(NULL, ",", &save)) {
+		addr = strtoull(tok, &end, 0);
+		len = 1;
+		if (end == tok) {
+			rc = -EINVAL;
+		} else if (*end == '+') {
+			len = parse_size64(end + 1);
+			if (len == ULLONG_MAX || len == 0)
+				rc = -EINVAL;
+		} else if (*end)
+			rc = -EINVAL;
+		if (rc) {
+			error("invalid range: '%s'\n", tok);
+			break;
+		}
+
+		if (param.namespace) {
+			if (addr >= size >> 9 || len > (size >> 9) - addr) {
+				error("range '%s' exceeds %s\n", tok,
+						param.namespace);
+				rc = -ERANGE;
+				break;
+			}
+			addr = base + (addr << 9);
+			len <<= 9;
+		}
+		rc = add_range(ranges, count, addr, len);
+	}
+
+	free(buf);
+	return rc;
+}
+
+/* the known badblocks of the pmem on @bus, within @base + @size */
+static int add_badblocks(struct ndctl_bus *bus, unsigned long long base,
+		unsigned long long size, struct ndctl_range **ranges,
+		int *count)
+{
+	struct ndctl_region *region;
+	struct badblock *bb;
+	int rc;
+
+	ndctl_region_foreach(bus, region) {
+		unsigned long long start = ndctl_region_get_resource(region);
+
+		if (ndctl_region_get_type(region) != ND_DEVICE_REGION_PMEM)
+			continue;
+		ndctl_region_badblock_foreach(region, bb) {
+			unsigned long long addr = start + (bb->offset << 9);
+			unsigned long long len = (unsigned long long) bb->len << 9;
+
+			if (addr >= base + size || addr + len <= base)
+				continue;
+			rc = add_range(ranges, count, addr, len);
+			if (rc)
+				return rc;
+		}
+	}
+	return 0;
+}
+
+static void scrub_record(struct ndctl_bus *bus, unsigned long long address,
+		unsigned long long length, void *data)
+{
+	struct json_object *jerrors = data, *jerr, *jobj;
+
+	jerr = json_object_new_object();
+	if (!jerr)
+		return;
+	jobj = util_json_object_hex(address, 0);
+	if (jobj)
+		json_object_object_add(jerr, "address", jobj);
+	jobj = json_object_new_int64(length);
+	if (jobj)
+		json_object_object_add(jerr, "length", jobj);
+	json_object_array_add(jerrors, jerr);
+}
+
+static struct ndctl_namespace *find_namespace(struct ndctl_ctx *ctx,
+		const char *ident)
+{
+	struct ndctl_namespace *ndns;
+	struct ndctl_region *region;
+	struct ndctl_bus *bus;
+
+	ndctl_bus_foreach(ctx, bus)
+		ndctl_region_foreach(bus, region)
+			ndctl_namespace_foreach(region, ndns)
+				if (util_namespace_filter(ndns, ident))
+					return ndns;
+	return NULL;
+}
+
+/*
+ * Scrub just the ranges given with --range, --namespace, and
+ * --badblocks rather than all of the persistent memory of each bus, see
+ * ndctl_bus_scrub_ranges(). The scrubs complete before this returns, and
+ * each bus is listed with the media errors they found.
+ */
+static int scrub_targeted(struct ndctl_ctx *ctx, struct ndctl_bus **buses,
+		int count, struct json_object *jbuses, int *success)
+{
+	unsigned long long base = 0, size = ULLONG_MAX;
+	struct ndctl_range *ranges = NULL, *bus_ranges;
+	struct ndctl_namespace *ndns = NULL;
+	int i, rc = 0, fail = 0, nr = 0;
+
+	if (param.namespace) {
+		struct ndctl_pfn *pfn;
+		struct ndctl_dax *dax;
+
+		ndns = find_namespace(ctx, param.namespace);
+		if (!ndns) {
+			error("namespace %s not found\n", param.namespace);
+			return -ENXIO;
+		}
+		pfn = ndctl_namespace_get_pfn(ndns);
+		dax = ndctl_namespace_get_dax(ndns);
+		if (pfn) {
+			base = ndctl_pfn_get_resource(pfn);
+			size = ndctl_pfn_get_size(pfn);
+		} else if (dax) {
+			base = ndctl_dax_get_resource(dax);
+			size = ndctl_dax_get_size(dax);
+		} else {
+			base = ndctl_namespace_get_resource(ndns);
+			size = ndctl_namespace_get_size(ndns);
+		}
+		if (base == ULLONG_MAX || size == ULLONG_MAX) {
+			error("%s: unable to determine its address range\n",
+					param.namespace);
+			return -ENXIO;
+		}
+		if (!param.range && !param.badblocks)
+			rc = add_range(&ranges, &nr, base, size);
+	}
+	if (param.range)
+		rc = parse_ranges(param.range, base, size, &ranges, &nr);
+	if (rc) {
+		free(ranges);
+		return rc;
+	}
+
+	for (i = 0; i < count; i++) {
+		struct json_object *jbus, *jerrors, *jobj;
+		int nr_bus = nr;
+
+		if (ndns && ndctl_namespace_get_bus(ndns) != buses[i])
+			continue;
+
+		bus_ranges = nr ? malloc(nr * sizeof(*ranges)) : NULL;
+		if (nr && !bus_ranges) {
+			rc = -ENOMEM;
+			break;
+		}
+		if (nr)
+			memcpy(bus_ranges, ranges, nr * sizeof(*ranges));
+		if (param.badblocks)
+			rc = add_badblocks(buses[i], base, size, &bus_ranges,
+					&nr_bus);
+
+		jerrors = json_object_new_array();
+		if (!jerrors)
+			rc = -ENOMEM;
+		if (rc == 0)
+			rc = ndctl_bus_scrub_ranges(buses[i], bus_ranges,
+					nr_bus, scrub_record, jerrors);
+		free(bus_ranges);
+		if (rc < 0) {
+			error("%s: failed to scrub ranges: %s\n",
+					ndctl_bus_get_devname(buses[i]),
+					strerror(-rc));
+			if (jerrors)
+				json_object_put(jerrors);
+			if (!fail)
+				fail = rc;
+			rc = 0;
+			continue;
+		}
+
+		(*success)++;
+		jbus = util_bus_to_json(buses[i]);
+		if (!jbus) {
+			json_object_put(jerrors);
+			continue;
+		}
+		jobj = json_object_new_int(rc);
+		if (jobj)
+			json_object_object_add(jbus, "scrubbed_ranges", jobj);
+		json_object_object_add(jbus, "media_errors", jerrors);
+		json_object_array_add(jbuses, jbus);
+		rc = 0;
+	}
+
+	free(ranges);
+	return rc ? rc : fail;
+}
+
+struct scrub_wait {
+	struct ndctl_bus **buses;
+	int *rcs, count;
+};
+
+static void scrub_done(struct ndctl_bus *bus, int rc, void *data)
 {
-	switch (action) {
-	case ACTION_WAIT:
-		return ndctl_bus_wait_for_scrub_completion(bus);
-	case ACTION_START:
-		return ndctl_bus_start_scrub(bus);
-	default:
-		return -EINVAL;
+	struct scrub_wait *sw = data;
+	int i;
+
+	for (i = 0; i < sw->count; i++)
+		if (sw->buses[i] == bus)
+			sw->rcs[i] = rc;
+
+	if (!param.wait)
+		return;
+	if (rc == 0)
+		fprintf(stderr, "%s: scrub complete\n",
+				ndctl_bus_get_devname(bus));
+	else
+		fprintf(stderr, "%s: error waiting for scrub completion: %s\n",
+				ndctl_bus_get_devname(bus), strerror(-rc));
+}
+
+/*
+ * Start the scrubs of all of @buses before waiting on any of them, and
+ * wait on them together, see ndctl_bus_wait_for_scrubs().
+ */
+static void scrub_action(struct ndctl_bus **buses, int *rcs, int count,
+		enum device_action action)
+{
+	struct scrub_wait sw = {
+		.buses = buses,
+		.rcs = rcs,
+		.count = count,
+	};
+	struct ndctl_bus **wait;
+	int i, nr = 0;
+
+	for (i = 0; i < count; i++) {
+		if (action == ACTION_START)
+			rcs[i] = ndctl_bus_start_scrub(buses[i]);
+		else
+			rcs[i] = 0;
 	}
+
+	if (action == ACTION_START && !param.wait)
+		return;
+
+	wait = calloc(count, sizeof(*wait));
+	if (!wait) {
+		for (i = 0; i < count; i++)
+			if (rcs[i] == 0)
+				rcs[i] = -ENOMEM;
+		return;
+	}
+
+	/* with --wait, also wait out a scrub that was already running */
+	for (i = 0; i < count; i++)
+		if (rcs[i] == 0 || rcs[i] == -EBUSY)
+			wait[nr++] = buses[i];
+	ndctl_bus_wait_for_scrubs(wait, nr, scrub_done, &sw);
+	free(wait);
 }
 
 static int bus_action(int argc, const char **argv, const char *usage,
@@ -43,9 +352,9 @@ static int bus_action(int argc, const char **argv, const char *usage,
 		usage,
 		NULL
 	};
+	int i, j, *rcs = NULL, count = 0, success = 0, fail = 0;
+	struct ndctl_bus *bus, **buses = NULL, **b;
 	struct json_object *jbuses, *jbus;
-	int i, rc, success = 0, fail = 0;
-	struct ndctl_bus *bus;
 	const char *all = "all";
 
 	argc = parse_options(argc, argv, options, u, 0);
@@ -64,9 +373,6 @@ static int bus_action(int argc, const char **argv, const char *usage,
 				break;
 			}
 
-	jbuses = json_object_new_array();
-	if (!jbuses)
-		return -ENOMEM;
 	for (i = 0; i < argc; i++) {
 		int found = 0;
 
@@ -74,19 +380,52 @@ static int bus_action(int argc, const char **argv, const char *usage,
 			if (!util_bus_filter(bus, argv[i]))
 				continue;
 			found++;
-			rc = scrub_action(bus, action);
-			if (rc == 0) {
-				success++;
-				jbus = util_bus_to_json(bus);
-				if (jbus)
-					json_object_array_add(jbuses, jbus);
-			} else if (!fail)
-				fail = rc;
+			for (j = 0; j < count; j++)
+				if (buses[j] == bus)
+					break;
+			if (j < count)
+				continue;
+			b = realloc(buses, (count + 1) * sizeof(*buses));
+			if (!b) {
+				free(buses);
+				return -ENOMEM;
+			}
+			buses = b;
+			buses[count++] = bus;
 		}
 		if (!found && param.verbose)
 			fprintf(stderr, "no bus matches id: %s\n", argv[i]);
 	}
 
+	jbuses = json_object_new_array();
+	if (jbuses && action == ACTION_START && (param.range
+				|| param.namespace || param.badblocks)) {
+		fail = scrub_targeted(ctx, buses, count, jbuses, &success);
+		free(buses);
+		goto out;
+	}
+	rcs = calloc(count ? count : 1, sizeof(*rcs));
+	if (!jbuses || !rcs) {
+		if (jbuses)
+			json_object_put(jbuses);
+		free(buses);
+		free(rcs);
+		return -ENOMEM;
+	}
+
+	scrub_action(buses, rcs, count, action);
+	for (i = 0; i < count; i++) {
+		if (rcs[i] == 0) {
+			success++;
+			jbus = util_bus_to_json(buses[i]);
+			if (jbus)
+				json_object_array_add(jbuses, jbus);
+		} else if (!fail)
+			fail = rcs[i];
+	}
+	free(buses);
+	free(rcs);
+ out:
 	if (success)
 		util_display_json_array(stdout, jbuses, 0);
 	else
@@ -100,7 +439,7 @@ static int bus_action(int argc, const char **argv, const char *usage,
 int cmd_start_scrub(int argc, const char **argv, void *ctx)
 {
 	char *usage = "ndctl start-scrub [<bus-id> <bus-id2> ... <bus-idN>] [<options>]";
-	int start = bus_action(argc, argv, usage, bus_options,
+	int start = bus_action(argc, argv, usage, start_options,
 			ACTION_START, ctx);
 
 	if (start <= 0) {
@@ -0,0 +1,766 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* Copyright(c) 2018 Intel Corporation. All rights reserved. */
+#include <stdio.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <builtin.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/signalfd.h>
+#include <util/json.h>
+#include <util/util.h>
+#include <util/filter.h>
+#include <json-c/json.h>
+#include <ndctl/libndctl.h>
+#include <util/parse-options.h>
+#include <ndctl.h>
+#include <ccan/list/list.h>
+#include <ccan/array_size/array_size.h>
+
+#define DAEMON_SOCKET "/run/ndctl/ndctl.sock"
+#define DAEMON_HEALTH_TTL 60
+#define DAEMON_MAX_ARGS 64
+#define DAEMON_REQUEST_SIZE 4096
+
+static struct {
+	const char *socket;
+	const char *health_ttl;
+	bool verbose;
+} param;
+
+/* each object in the epoll set starts with its source type */
+enum daemon_source {
+	DAEMON_CLIENT,
+	DAEMON_DIMM,
+};
+
+/*
+ * While a command runs for a client, reading further requests from it is
+ * paused so that replies stay in request order, and the reply is sent
+ * once the daemon reaps the command's process.
+ */
+struct daemon_client {
+	enum daemon_source source;
+	int fd;
+	bool hangup;
+	bool closed;
+	pid_t pid;
+	const char *cmd;
+	FILE *fout, *ferr;
+	size_t len;
+	char buf[DAEMON_REQUEST_SIZE];
+	struct list_node list;
+};
+
+/*
+ * The health of a dimm as of the last smart command, discarded when the
+ * dimm signals a health event or after the ttl.
+ */
+struct daemon_dimm {
+	enum daemon_source source;
+	struct ndctl_dimm *dimm;
+	int health_eventfd;
+	struct json_object *jhealth;
+	time_t expires;
+	struct list_node list;
+};
+
+struct daemon {
+	struct ndctl_ctx *ctx;
+	int epollfd;
+	int sockfd;
+	int sigfd;
+	int udevfd;
+	unsigned long health_ttl;
+	struct cmd_struct *cmds;
+	int num_cmds;
+	struct list_head clients;
+	struct list_head closed;
+	struct list_head dimms;
+};
+
+static struct daemon_dimm *daemon_get_dimm(struct daemon *d,
+		struct ndctl_dimm *dimm)
+{
+	struct daemon_dimm *ddimm;
+	struct epoll_event ev;
+	char buf;
+
+	list_for_each(&d->dimms, ddimm, list)
+		if (ddimm->dimm == dimm)
+			return ddimm;
+
+	ddimm = calloc(1, sizeof(*ddimm));
+	if (!ddimm)
+		return NULL;
+	ddimm->source = DAEMON_DIMM;
+	ddimm->dimm = dimm;
+	ddimm->health_eventfd = ndctl_dimm_get_health_eventfd(dimm);
+	list_add_tail(&d->dimms, &ddimm->list);
+
+	/* without health events the ttl alone bounds staleness */
+	if (ddimm->health_eventfd < 0
+			|| pread(ddimm->health_eventfd, &buf, 1, 0) < 0)
+		return ddimm;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLPRI;
+	ev.data.ptr = ddimm;
+	epoll_ctl(d->epollfd, EPOLL_CTL_ADD, ddimm->health_eventfd, &ev);
+	return ddimm;
+}
+
+static struct json_object *daemon_health(struct daemon *d, int argc,
+		const char **argv)
+{
+	struct json_object *jdimms, *jdimm, *jhealth;
+	struct daemon_dimm *ddimm;
+	struct ndctl_dimm *dimm;
+	struct ndctl_bus *bus;
+	time_t now = time(NULL);
+	int i;
+
+	jdimms = json_object_new_array();
+	if (!jdimms)
+		return NULL;
+
+	ndctl_bus_foreach(d->ctx, bus)
+	ndctl_dimm_foreach(bus, dimm) {
+		for (i = 1; i < argc; i++)
+			if (util_dimm_filter(dimm, argv[i]))
+				break;
+		if (argc > 1 && i >= argc)
+			continue;
+		if (!ndctl_dimm_is_cmd_supported(dimm, ND_CMD_SMART))
+			continue;
+
+		ddimm = daemon_get_dimm(d, dimm);
+		if (!ddimm)
+			continue;
+		if (ddimm->jhealth && now >= ddimm->expires) {
+			json_object_put(ddimm->jhealth);
+			ddimm->jhealth = NULL;
+		}
+		if (!ddimm->jhealth) {
+			ddimm->jhealth = util_dimm_health_to_json(dimm);
+			ddimm->expires = now + d->health_ttl;
+		}
+
+		jdimm = util_dimm_to_json(dimm, 0);
+		if (!jdimm)
+			continue;
+		jhealth = json_object_get(ddimm->jhealth);
+		if (jhealth)
+			json_object_object_add(jdimm, "health", jhealth);
+		json_object_array_add(jdimms, jdimm);
+	}
+
+	return jdimms;
+}
+
+static char *read_file(FILE *f)
+{
+	long size;
+	char *buf;
+
+	fflush(f);
+	size = ftell(f);
+	if (size < 0)
+		return NULL;
+	buf = calloc(1, size + 1);
+	if (!buf)
+		return NULL;
+	rewind(f);
+	if (fread(buf, 1, size, f) != (size_t) size) {
+		free(buf);
+		return NULL;
+	}
+	return buf;
+}
+
+/*
+ * Commands run in a child forked from the daemon, so they start from the
+ * warm context without inheriting state from earlier requests, and a
+ * command exiting on bad options does not take the daemon down. The
+ * daemon's own context learns of the changes a command made through the
+ * udev monitor. The child is reaped from the epoll loop on SIGCHLD, see
+ * daemon_reply(), so the daemon keeps serving other clients, and stays
+ * responsive to SIGTERM, while it runs.
+ */
+static int daemon_run(struct daemon *d, struct daemon_client *client,
+		struct cmd_struct *cmd, int argc, const char **argv)
+{
+	FILE *fout, *ferr;
+	int rc;
+	pid_t pid;
+
+	fout = tmpfile();
+	ferr = tmpfile();
+	if (!fout || !ferr) {
+		rc = -errno;
+		goto err;
+	}
+
+	fflush(stdout);
+	fflush(stderr);
+	pid = fork();
+	if (pid < 0) {
+		rc = -errno;
+		goto err;
+	}
+
+	if (pid == 0) {
+		struct daemon_client *c;
+		sigset_t mask;
+
+		sigemptyset(&mask);
+		sigaddset(&mask, SIGINT);
+		sigaddset(&mask, SIGTERM);
+		sigaddset(&mask, SIGCHLD);
+		sigprocmask(SIG_UNBLOCK, &mask, NULL);
+		close(d->sigfd);
+		close(d->sockfd);
+		close(d->epollfd);
+		list_for_each(&d->clients, c, list)
+			close(c->fd);
+		if (dup2(fileno(fout), STDOUT_FILENO) < 0
+				|| dup2(fileno(ferr), STDERR_FILENO) < 0)
+			_exit(EIO);
+		cmd->reset();
+		rc = cmd->fn(argc, argv, d->ctx);
+		fflush(stdout);
+		fflush(stderr);
+		if (rc < 0)
+			rc = -rc;
+		_exit(rc > 255 ? 255 : rc);
+	}
+
+	client->pid = pid;
+	client->cmd = cmd->cmd;
+	client->fout = fout;
+	client->ferr = ferr;
+	return 0;
+ err:
+	if (fout)
+		fclose(fout);
+	if (ferr)
+		fclose(ferr);
+	return rc;
+}
+
+static void daemon_run_release(struct daemon_client *client)
+{
+	fclose(client->fout);
+	fclose(client->ferr);
+	client->fout = NULL;
+	client->ferr = NULL;
+	client->pid = 0;
+}
+
+static struct json_object *daemon_request(struct daemon *d,
+		struct daemon_client *client, char *line)
+{
+	const char *argv[DAEMON_MAX_ARGS];
+	struct json_object *jresp, *jobj;
+	struct cmd_struct *cmd;
+	int argc, rc;
+
+	argc = batch_split(line, argv, ARRAY_SIZE(argv));
+	if (argc == 0)
+		return NULL;
+
+	jresp = json_object_new_object();
+	if (!jresp)
+		return NULL;
+
+	if (argc < 0) {
+		rc = argc;
+		jobj = json_object_new_string(argc == -E2BIG
+				? "too many arguments" : "unterminated quote");
+		if (jobj)
+			json_object_object_add(jresp, "message", jobj);
+	} else if (strcmp(argv[0], "health") == 0) {
+		jobj = daemon_health(d, argc, argv);
+		rc = jobj ? 0 : -ENOMEM;
+		if (jobj)
+			json_object_object_add(jresp, "result", jobj);
+	} else {
+		cmd = batch_find(argv[0], d->cmds, d->num_cmds);
+		if (cmd && cmd->reset) {
+			rc = daemon_run(d, client, cmd, argc, argv);
+			if (rc == 0) {
+				/* answered by daemon_reply() */
+				json_object_put(jresp);
+				return NULL;
+			}
+		} else {
+			rc = -EOPNOTSUPP;
+			jobj = json_object_new_string("unsupported command");
+			if (jobj)
+				json_object_object_add(jresp, "message",
+						jobj);
+		}
+	}
+
+	if (param.verbose && argc > 0)
+		fprintf(stderr, "ndctl daemon: %s: %d\n", argv[0], rc);
+
+	jobj = json_object_new_int(rc);
+	if (jobj)
+		json_object_object_add(jresp, "status", jobj);
+	return jresp;
+}
+
+/*
+ * Later entries of the current epoll batch may still point at @client, so
+ * it is only freed by daemon_client_free() once the batch is done.
+ */
+static void daemon_client_close(struct daemon *d,
+		struct daemon_client *client)
+{
+	int status;
+
+	if (client->pid) {
+		kill(client->pid, SIGTERM);
+		while (waitpid(client->pid, &status, 0) < 0 && errno == EINTR)
+			;
+		daemon_run_release(client);
+	}
+	if (!client->hangup)
+		epoll_ctl(d->epollfd, EPOLL_CTL_DEL, client->fd, NULL);
+	close(client->fd);
+	client->closed = true;
+	list_del(&client->list);
+	list_add_tail(&d->closed, &client->list);
+}
+
+static void daemon_client_free(struct daemon *d)
+{
+	struct daemon_client *client, *_c;
+
+	list_for_each_safe(&d->closed, client, _c, list) {
+		list_del(&client->list);
+		free(client);
+	}
+}
+
+static int daemon_send(struct daemon_client *client,
+		struct json_object *jresp)
+{
+	const char *resp;
+	size_t len;
+	ssize_t rc;
+
+	resp = json_object_to_json_string_ext(jresp, JSON_C_TO_STRING_PLAIN);
+	len = strlen(resp);
+	while (len) {
+		rc = send(client->fd, resp, len, MSG_NOSIGNAL);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		resp += rc;
+		len -= rc;
+	}
+	if (send(client->fd, "\n", 1, MSG_NOSIGNAL) < 0)
+		return -errno;
+	return 0;
+}
+
+static int daemon_client_events(struct daemon *d,
+		struct daemon_client *client, unsigned int events)
+{
+	struct epoll_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = events;
+	ev.data.ptr = client;
+	return epoll_ctl(d->epollfd, EPOLL_CTL_MOD, client->fd, &ev);
+}
+
+/*
+ * Requests are newline terminated, each gets one line of json back.
+ * Returns -ENOTCONN when @client was closed.
+ */
+static int daemon_client_process(struct daemon *d,
+		struct daemon_client *client)
+{
+	struct json_object *jresp;
+	char *line, *end;
+	int rc;
+
+	line = client->buf;
+	while (!client->pid && (end = strchr(line, '\n'))) {
+		*end = '\0';
+		jresp = daemon_request(d, client, line);
+		line = end + 1;
+		if (!jresp)
+			continue;
+		rc = daemon_send(client, jresp);
+		json_object_put(jresp);
+		if (rc) {
+			daemon_client_close(d, client);
+			return -ENOTCONN;
+		}
+	}
+
+	client->len -= line - client->buf;
+	memmove(client->buf, line, client->len + 1);
+
+	/* while busy, epoll still reports a hangup */
+	if (client->pid)
+		return daemon_client_events(d, client, 0);
+
+	if (client->len == sizeof(client->buf) - 1) {
+		error("ndctl daemon: request too long\n");
+		daemon_client_close(d, client);
+		return -ENOTCONN;
+	}
+	return 0;
+}
+
+static void daemon_client_read(struct daemon *d,
+		struct daemon_client *client, unsigned int events)
+{
+	ssize_t rc;
+
+	/* a client that hangs up on its running command abandons it */
+	if (client->pid) {
+		if (events & (EPOLLHUP | EPOLLERR)) {
+			epoll_ctl(d->epollfd, EPOLL_CTL_DEL, client->fd, NULL);
+			client->hangup = true;
+			kill(client->pid, SIGTERM);
+		}
+		return;
+	}
+
+	rc = recv(client->fd, client->buf + client->len,
+			sizeof(client->buf) - client->len - 1, 0);
+	if (rc <= 0) {
+		if (rc < 0 && errno == EINTR)
+			return;
+		daemon_client_close(d, client);
+		return;
+	}
+	client->len += rc;
+	client->buf[client->len] = '\0';
+
+	daemon_client_process(d, client);
+}
+
+/* answer the request whose command, run by daemon_run(), exited */
+static void daemon_reply(struct daemon *d, struct daemon_client *client,
+		int status)
+{
+	char *out = NULL, *errbuf = NULL;
+	struct json_object *jresp, *jobj;
+	int rc;
+
+	if (WIFEXITED(status))
+		rc = -WEXITSTATUS(status);
+	else
+		rc = -EINTR;
+
+	if (param.verbose)
+		fprintf(stderr, "ndctl daemon: %s: %d\n", client->cmd, rc);
+
+	jresp = client->hangup ? NULL : json_object_new_object();
+	if (jresp) {
+		/* output is the command's json if it produced any, otherwise text */
+		out = read_file(client->fout);
+		if (out && *out) {
+			jobj = json_tokener_parse(out);
+			if (!jobj)
+				jobj = json_object_new_string(out);
+			if (jobj)
+				json_object_object_add(jresp, "result", jobj);
+		}
+		errbuf = read_file(client->ferr);
+		if (errbuf && *errbuf) {
+			jobj = json_object_new_string(errbuf);
+			if (jobj)
+				json_object_object_add(jresp, "message", jobj);
+		}
+		jobj = json_object_new_int(rc);
+		if (jobj)
+			json_object_object_add(jresp, "status", jobj);
+	}
+	free(out);
+	free(errbuf);
+	daemon_run_release(client);
+
+	if (!jresp) {
+		daemon_client_close(d, client);
+		return;
+	}
+	rc = daemon_send(client, jresp);
+	json_object_put(jresp);
+	if (rc || daemon_client_events(d, client, EPOLLIN) < 0) {
+		daemon_client_close(d, client);
+		return;
+	}
+
+	/* resume the requests that arrived while the command ran */
+	daemon_client_process(d, client);
+}
+
+static void daemon_reap(struct daemon *d)
+{
+	struct daemon_client *client, *_c;
+	int status;
+
+	list_for_each_safe(&d->clients, client, _c, list)
+		if (client->pid && waitpid(client->pid, &status, WNOHANG) > 0)
+			daemon_reply(d, client, status);
+}
+
+static void daemon_accept(struct daemon *d)
+{
+	struct daemon_client *client;
+	struct epoll_event ev;
+	int fd;
+
+	fd = accept4(d->sockfd, NULL, NULL, SOCK_CLOEXEC);
+	if (fd < 0)
+		return;
+
+	client = calloc(1, sizeof(*client));
+	if (!client) {
+		close(fd);
+		return;
+	}
+	client->source = DAEMON_CLIENT;
+	client->fd = fd;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = client;
+	if (epoll_ctl(d->epollfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		close(fd);
+		free(client);
+		return;
+	}
+	list_add_tail(&d->clients, &client->list);
+}
+
+static int daemon_listen(const char *path)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	mode_t mask;
+	char *dir;
+	int fd, rc;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return -ENAMETOOLONG;
+	strcpy(addr.sun_path, path);
+
+	dir = strdup(path);
+	if (!dir)
+		return -ENOMEM;
+	if (mkdir(dirname(dir), 0755) < 0 && errno != EEXIST) {
+		free(dir);
+		return -errno;
+	}
+	free(dir);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -errno;
+
+	/* the requests include destructive ones, owner only */
+	unlink(path);
+	mask = umask(0177);
+	rc = bind(fd, (struct sockaddr *) &addr, sizeof(addr));
+	umask(mask);
+	if (rc < 0 || listen(fd, 16) < 0) {
+		rc = -errno;
+		close(fd);
+		return rc;
+	}
+	return fd;
+}
+
+static int daemon_add_fd(struct daemon *d, int fd, void *ptr)
+{
+	struct epoll_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = ptr;
+	if (epoll_ctl(d->epollfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+		return -errno;
+	return 0;
+}
+
+static int daemon_loop(struct daemon *d)
+{
+	struct epoll_event events[16];
+	struct signalfd_siginfo si;
+	struct daemon_client *client;
+	struct daemon_dimm *ddimm;
+	int i, nfds;
+	char buf;
+
+	for (;;) {
+		nfds = epoll_wait(d->epollfd, events, ARRAY_SIZE(events), -1);
+		if (nfds < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+
+		for (i = 0; i < nfds; i++) {
+			void *ptr = events[i].data.ptr;
+
+			if (ptr == &d->sigfd) {
+				if (read(d->sigfd, &si, sizeof(si)) != sizeof(si))
+					continue;
+				if (si.ssi_signo != SIGCHLD)
+					return 0;
+				daemon_reap(d);
+				continue;
+			}
+			if (ptr == &d->sockfd) {
+				daemon_accept(d);
+				continue;
+			}
+			if (ptr == &d->udevfd) {
+				ndctl_process_udev_events(d->ctx);
+				continue;
+			}
+			if (*(enum daemon_source *) ptr == DAEMON_DIMM) {
+				ddimm = ptr;
+				json_object_put(ddimm->jhealth);
+				ddimm->jhealth = NULL;
+				if (pread(ddimm->health_eventfd, &buf, 1, 0) < 0)
+					epoll_ctl(d->epollfd, EPOLL_CTL_DEL,
+						ddimm->health_eventfd, NULL);
+				continue;
+			}
+			client = ptr;
+			if (!client->closed)
+				daemon_client_read(d, client, events[i].events);
+		}
+		daemon_client_free(d);
+	}
+}
+
+int daemon_serve(int argc, const char **argv, void *ctx,
+		struct cmd_struct *cmds, int num_cmds)
+{
+	const struct option options[] = {
+		OPT_STRING('s', "socket", &param.socket, "path",
+				"listen on <path> (default: " DAEMON_SOCKET ")"),
+		OPT_STRING(0, "health-ttl", &param.health_ttl, "seconds",
+				"maximum age of cached dimm health"),
+		OPT_BOOLEAN('v', "verbose", &param.verbose,
+				"log each request to stderr"),
+		OPT_END(),
+	};
+	const char * const u[] = {
+		"ndctl daemon [<options>]",
+		NULL
+	};
+	struct daemon d = {
+		.ctx = ctx,
+		.epollfd = -1,
+		.sockfd = -1,
+		.sigfd = -1,
+		.udevfd = -1,
+		.health_ttl = DAEMON_HEALTH_TTL,
+		.cmds = cmds,
+		.num_cmds = num_cmds,
+	};
+	struct daemon_client *client, *_c;
+	struct daemon_dimm *ddimm, *_d;
+	const char *path;
+	sigset_t mask;
+	char *end;
+	int i, rc;
+
+	argc = parse_options(argc, argv, options, u, 0);
+	for (i = 0; i < argc; i++)
+		error("unknown parameter \"%s\"\n", argv[i]);
+	if (argc)
+		usage_with_options(u, options);
+
+	if (param.health_ttl) {
+		d.health_ttl = strtoul(param.health_ttl, &end, 0);
+		if (!*param.health_ttl || *end) {
+			error("invalid --health-ttl: %s\n", param.health_ttl);
+			return -EINVAL;
+		}
+	}
+
+	list_head_init(&d.clients);
+	list_head_init(&d.closed);
+	list_head_init(&d.dimms);
+	path = param.socket ? param.socket : DAEMON_SOCKET;
+
+	d.epollfd = epoll_create1(EPOLL_CLOEXEC);
+	if (d.epollfd < 0)
+		return -errno;
+
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGTERM);
+	sigaddset(&mask, SIGCHLD);
+	sigprocmask(SIG_BLOCK, &mask, NULL);
+	d.sigfd = signalfd(-1, &mask, SFD_CLOEXEC);
+	if (d.sigfd < 0) {
+		rc = -errno;
+		goto out;
+	}
+	rc = daemon_add_fd(&d, d.sigfd, &d.sigfd);
+	if (rc)
+		goto out;
+
+	/* commands run in children, the daemon only sees their changes here */
+	rc = ndctl_enable_udev_monitor(ctx);
+	if (rc) {
+		error("failed to monitor udev events: %s\n", strerror(-rc));
+		goto out;
+	}
+	d.udevfd = ndctl_get_udev_monitor_fd(ctx);
+	rc = daemon_add_fd(&d, d.udevfd, &d.udevfd);
+	if (rc)
+		goto out;
+
+	d.sockfd = daemon_listen(path);
+	if (d.sockfd < 0) {
+		rc = d.sockfd;
+		error("failed to listen on %s: %s\n", path, strerror(-rc));
+		goto out;
+	}
+	rc = daemon_add_fd(&d, d.sockfd, &d.sockfd);
+	if (rc)
+		goto out;
+
+	rc = daemon_loop(&d);
+	unlink(path);
+ out:
+	list_for_each_safe(&d.clients, client, _c, list)
+		daemon_client_close(&d, client);
+	daemon_client_free(&d);
+	list_for_each_safe(&d.dimms, ddimm, _d, list) {
+		json_object_put(ddimm->jhealth);
+		list_del(&ddimm->list);
+		free(ddimm);
+	}
+	if (d.sockfd >= 0)
+		close(d.sockfd);
+	if (d.sigfd >= 0)
+		close(d.sigfd);
+	close(d.epollfd);
+	return rc;
+}
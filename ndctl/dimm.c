@@ -13,6 +13,8 @@
 #include <stdio.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <string.h>
+#include <builtin.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -836,6 +838,12 @@ static struct parameters {
 	.labelversion = "1.1",
 };
 
+void builtin_xaction_dimm_reset(void)
+{
+	memset(&param, 0, sizeof(param));
+	param.labelversion = "1.1";
+}
+
 static int __action_init(struct ndctl_dimm *dimm,
 		enum ndctl_namespace_version version, int chk_only)
 {
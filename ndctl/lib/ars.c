@@ -11,7 +11,11 @@
  * more details.
  */
 #include <stdlib.h>
+#include <limits.h>
+#include <unistd.h>
+#include <util/size.h>
 #include <ndctl/libndctl.h>
+#include <ccan/minmax/minmax.h>
 #include "private.h"
 
 NDCTL_EXPORT struct ndctl_cmd *ndctl_bus_cmd_new_ars_cap(struct ndctl_bus *bus,
@@ -349,3 +353,272 @@ NDCTL_EXPORT unsigned long long ndctl_cmd_clear_error_get_cleared(
 	dbg(ctx, "invalid clear_err\n");
 	return 0;
 }
+
+/* bounds for polling a directed scrub, in microseconds */
+#define ARS_POLL_MIN 1000
+#define ARS_POLL_MAX 100000
+
+static int cmp_range(const void *a, const void *b)
+{
+	const struct ndctl_range *r1 = a, *r2 = b;
+
+	if (r1->address < r2->address)
+		return -1;
+	return r1->address > r2->address;
+}
+
+/* sort @ranges and merge the overlapping and adjacent ones in place */
+static int merge_ranges(struct ndctl_range *ranges, int count)
+{
+	int i, nr = 0;
+
+	qsort(ranges, count, sizeof(*ranges), cmp_range);
+	for (i = 0; i < count; i++) {
+		unsigned long long end = ranges[i].address + ranges[i].length;
+		struct ndctl_range *last;
+
+		if (!ranges[i].length)
+			continue;
+		if (nr) {
+			last = &ranges[nr - 1];
+			if (ranges[i].address <= last->address + last->length) {
+				last->length = max(last->address + last->length,
+						end) - last->address;
+				continue;
+			}
+		}
+		ranges[nr++] = ranges[i];
+	}
+	return nr;
+}
+
+/*
+ * Submit an ARS capabilities query for @address/@length, the ARS start
+ * commands for that range are built from it. Returns 1 and sets @cap if
+ * the range is ARS capable, 0 if not.
+ */
+static int ars_cap_query(struct ndctl_bus *bus, unsigned long long address,
+		unsigned long long length, struct ndctl_cmd **cap)
+{
+	struct ndctl_ctx *ctx = ndctl_bus_get_ctx(bus);
+	int rc;
+
+	*cap = ndctl_bus_cmd_new_ars_cap(bus, address, length);
+	if (!*cap)
+		return -EOPNOTSUPP;
+	rc = ndctl_cmd_submit(*cap);
+	if (rc == 0 && !__validate_ars_cap(*cap)) {
+		dbg(ctx, "%llx - %llx: not ars capable, skipping\n",
+				address, length);
+		rc = 0;
+	} else if (rc == 0)
+		return 1;
+
+	ndctl_cmd_unref(*cap);
+	*cap = NULL;
+	return rc;
+}
+
+/*
+ * Scrub @range with directed ARS, skipping the part below @done_end that
+ * an earlier range already covered once aligned to the clear unit.
+ * Returns 1 if the range was scrubbed, 0 if there was nothing to scrub.
+ */
+static int scrub_range(struct ndctl_bus *bus, struct ndctl_range *range,
+		unsigned long long *done_end,
+		void (*record)(struct ndctl_bus *bus, unsigned long long address,
+			unsigned long long length, void *data),
+		void *data)
+{
+	struct ndctl_ctx *ctx = ndctl_bus_get_ctx(bus);
+	struct ndctl_cmd *cap, *start, *status = NULL;
+	unsigned long long begin, end, unit;
+	struct ndctl_range r;
+	unsigned int i;
+	int rc, delay;
+
+	rc = ars_cap_query(bus, range->address, range->length, &cap);
+	if (rc <= 0)
+		return rc;
+
+	unit = ndctl_cmd_ars_cap_get_clear_unit(cap);
+	ndctl_cmd_unref(cap);
+	if (!unit) {
+		dbg(ctx, "%llx - %llx: no clear unit, scrubbing unaligned\n",
+				range->address, range->length);
+		unit = 1;
+	}
+	begin = max(ALIGN_DOWN(range->address, unit), *done_end);
+	end = ALIGN(range->address + range->length, unit);
+	if (begin >= end)
+		return 0;
+
+	/* the aligned range gets its own query, and is limited to its answer */
+	rc = ars_cap_query(bus, begin, end - begin, &cap);
+	if (rc <= 0)
+		return rc;
+	if (ndctl_cmd_ars_cap_get_range(cap, &r) < 0) {
+		rc = -ENXIO;
+		goto out;
+	}
+	begin = max(begin, r.address);
+	end = min(end, r.address + r.length);
+	if (begin >= end) {
+		rc = 0;
+		goto out;
+	}
+
+	status = ndctl_bus_cmd_new_ars_status(cap);
+	if (!status) {
+		rc = -ENOMEM;
+		goto out;
+	}
+
+	for (;;) {
+		start = ndctl_bus_cmd_new_ars_start(cap, ND_ARS_PERSISTENT);
+		if (!start) {
+			rc = -EOPNOTSUPP;
+			goto out;
+		}
+		rc = ndctl_cmd_submit(start);
+		if (rc == 0 && (ndctl_cmd_get_firmware_status(start)
+					& ARS_STATUS_MASK))
+			rc = -EBUSY;
+		ndctl_cmd_unref(start);
+		if (rc < 0) {
+			dbg(ctx, "%llx - %llx: failed to start ars: %s\n",
+					begin, end - begin, strerror(-rc));
+			goto out;
+		}
+
+		for (delay = ARS_POLL_MIN;; delay = min(delay * 2, ARS_POLL_MAX)) {
+			rc = ndctl_cmd_submit(status);
+			if (rc < 0)
+				goto out;
+			if (!ndctl_cmd_ars_in_progress(status))
+				break;
+			usleep(delay);
+		}
+		if (!__validate_ars_stat(status)) {
+			rc = -ENXIO;
+			goto out;
+		}
+
+		for (i = 0; i < ndctl_cmd_ars_num_records(status); i++)
+			if (record)
+				record(bus, ndctl_cmd_ars_get_record_addr(
+							status, i),
+						ndctl_cmd_ars_get_record_len(
+							status, i), data);
+
+		if (ndctl_cmd_ars_stat_get_flag_overflow(status) <= 0)
+			break;
+		/* the record buffer filled up, resume where firmware stopped */
+		r.address = status->ars_status->restart_address;
+		r.length = status->ars_status->restart_length;
+		dbg(ctx, "%llx - %llx: overflow, restarting at %llx\n",
+				begin, end - begin, r.address);
+		ndctl_cmd_unref(cap);
+		rc = ars_cap_query(bus, r.address, r.length, &cap);
+		if (rc <= 0) {
+			rc = rc ? rc : -ENXIO;
+			goto out;
+		}
+	}
+
+	dbg(ctx, "%llx - %llx: scrubbed\n", begin, end - begin);
+	*done_end = end;
+	rc = 1;
+ out:
+	ndctl_cmd_unref(status);
+	ndctl_cmd_unref(cap);
+	return rc;
+}
+
+/**
+ * ndctl_bus_scrub_ranges - scrub only the given address ranges of a bus
+ * @bus: bus to scrub
+ * @ranges: system physical address ranges to scrub, in any order
+ * @count: number of entries in @ranges
+ * @record: optional callback for each media error the scrubs report
+ * @data: passed through to @record
+ *
+ * Rather than a scrub of all persistent memory, re-verify just the
+ * suspect ranges, e.g. known badblocks or addresses from a machine check.
+ * The ranges are merged, limited to the pmem regions of @bus, aligned to
+ * the ARS clear unit, and scrubbed one at a time with directed ARS.
+ * Returns the number of ranges scrubbed, or a negative error code.
+ */
+NDCTL_EXPORT int ndctl_bus_scrub_ranges(struct ndctl_bus *bus,
+		const struct ndctl_range *ranges, int count,
+		void (*record)(struct ndctl_bus *bus, unsigned long long address,
+			unsigned long long length, void *data),
+		void *data)
+{
+	struct ndctl_ctx *ctx = ndctl_bus_get_ctx(bus);
+	struct ndctl_range *merged, *pieces = NULL, *p;
+	int i, nr, nr_pieces = 0, scrubbed = 0, rc = 0;
+	unsigned long long done_end = 0;
+	struct ndctl_region *region;
+
+	if (count <= 0)
+		return 0;
+
+	merged = calloc(count, sizeof(*merged));
+	if (!merged)
+		return -ENOMEM;
+	for (i = 0; i < count; i++) {
+		merged[i] = ranges[i];
+		/* clamp ranges that wrap the address space */
+		if (merged[i].length > ULLONG_MAX - merged[i].address)
+			merged[i].length = ULLONG_MAX - merged[i].address;
+	}
+	nr = merge_ranges(merged, count);
+
+	/* ARS only covers persistent memory, split ranges at region ends */
+	ndctl_region_foreach(bus, region) {
+		unsigned long long r_begin = ndctl_region_get_resource(region);
+		unsigned long long r_end = r_begin
+			+ ndctl_region_get_size(region);
+
+		if (ndctl_region_get_type(region) != ND_DEVICE_REGION_PMEM
+				|| r_begin == ULLONG_MAX)
+			continue;
+
+		for (i = 0; i < nr; i++) {
+			unsigned long long begin = max(merged[i].address,
+					r_begin);
+			unsigned long long end = min(merged[i].address
+					+ merged[i].length, r_end);
+
+			if (begin >= end)
+				continue;
+			p = realloc(pieces, (nr_pieces + 1) * sizeof(*pieces));
+			if (!p) {
+				rc = -ENOMEM;
+				goto out;
+			}
+			pieces = p;
+			pieces[nr_pieces].address = begin;
+			pieces[nr_pieces++].length = end - begin;
+		}
+	}
+	if (!nr_pieces) {
+		dbg(ctx, "bus%d: no pmem in the given ranges\n",
+				ndctl_bus_get_id(bus));
+		goto out;
+	}
+	qsort(pieces, nr_pieces, sizeof(*pieces), cmp_range);
+
+	for (i = 0; i < nr_pieces; i++) {
+		rc = scrub_range(bus, &pieces[i], &done_end, record, data);
+		if (rc < 0)
+			goto out;
+		scrubbed += rc;
+	}
+	rc = scrubbed;
+ out:
+	free(pieces);
+	free(merged);
+	return rc;
+}
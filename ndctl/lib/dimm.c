@@ -480,7 +480,7 @@ NDCTL_EXPORT struct ndctl_cmd *ndctl_dimm_read_labels(struct ndctl_dimm *dimm)
         struct ndctl_cmd *cmd_size, *cmd_read;
         int rc;
 
-        rc = ndctl_bus_wait_probe(bus);
+        rc = bus_wait_probe(bus);
         if (rc < 0)
                 return NULL;
 
@@ -0,0 +1,369 @@
+/*
+ * Copyright (c) 2018, Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ */
+#include <stdio.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <ndctl/libndctl.h>
+#include "private.h"
+
+#define EVENT_RING_MAGIC "NDEVRING"
+#define EVENT_RING_VERSION 1
+#define EVENT_RING_DEFAULT_RECORDS 256
+#define EVENT_RING_MAX_RECORDS (1U << 20)
+
+/*
+ * The shared file is this header followed by @nr_records slots of
+ * @record_size bytes. Slots are written by a single producer and read
+ * without locks by any number of consumers: @head is the count of records
+ * ever published, and the seq field of each slot doubles as a sequence
+ * lock, it is zero while the slot is being rewritten and the 1-based
+ * sequence number of the record once complete. A consumer that copies a
+ * slot and sees the same expected seq before and after the copy has a
+ * consistent record, anything else means the producer lapped it. @wake is
+ * bumped on each publish and is the futex consumers sleep on.
+ */
+struct event_ring_header {
+	char magic[8];
+	u32 version;
+	u32 record_size;
+	u32 nr_records;
+	u32 wake;
+	u64 head;
+	u32 closed;
+	u8 reserved[28];
+};
+
+struct ndctl_event_ring {
+	struct ndctl_ctx *ctx;
+	struct event_ring_header *hdr;
+	char *slots;
+	size_t size;
+	bool producer;
+	u64 pos;
+	u64 lost;
+};
+
+static struct ndctl_event_record *ring_slot(struct ndctl_event_ring *ring,
+		u64 seq)
+{
+	struct event_ring_header *hdr = ring->hdr;
+
+	return (struct ndctl_event_record *) (ring->slots
+			+ (seq & (hdr->nr_records - 1)) * hdr->record_size);
+}
+
+static int futex(u32 *uaddr, int op, u32 val, const struct timespec *ts)
+{
+	return syscall(SYS_futex, uaddr, op, val, ts, NULL, 0);
+}
+
+/**
+ * ndctl_event_ring_new - create the shared event ring at @path
+ * @ctx: ndctl library context
+ * @path: file to hold the ring, typically under /dev/shm
+ * @nr_records: capacity, rounded up to a power of 2, 0 for the default
+ *
+ * The ring is built in a temporary file and renamed over @path, so
+ * consumers never map a partially initialized ring, and a ring still
+ * mapped by consumers of a previous producer is never truncated under
+ * them.
+ */
+NDCTL_EXPORT struct ndctl_event_ring *ndctl_event_ring_new(
+		struct ndctl_ctx *ctx, const char *path,
+		unsigned int nr_records)
+{
+	struct ndctl_event_ring *ring;
+	unsigned int nr = 1;
+	char *tmp = NULL;
+	int fd = -1, rc;
+	void *addr;
+	size_t size;
+
+	if (!nr_records)
+		nr_records = EVENT_RING_DEFAULT_RECORDS;
+	if (nr_records > EVENT_RING_MAX_RECORDS) {
+		err(ctx, "%s: %u records exceeds max %u\n", path, nr_records,
+				EVENT_RING_MAX_RECORDS);
+		return NULL;
+	}
+	while (nr < nr_records)
+		nr <<= 1;
+	size = sizeof(struct event_ring_header)
+		+ nr * sizeof(struct ndctl_event_record);
+
+	ring = calloc(1, sizeof(*ring));
+	if (!ring)
+		return NULL;
+
+	if (asprintf(&tmp, "%s.XXXXXX", path) < 0) {
+		tmp = NULL;
+		goto err;
+	}
+
+	fd = mkostemp(tmp, O_CLOEXEC);
+	if (fd < 0) {
+		err(ctx, "%s: failed to create: %s\n", path, strerror(errno));
+		goto err;
+	}
+
+	if (fchmod(fd, 0644) < 0 || ftruncate(fd, size) < 0) {
+		err(ctx, "%s: failed to size: %s\n", path, strerror(errno));
+		goto err;
+	}
+
+	addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (addr == MAP_FAILED) {
+		err(ctx, "%s: failed to map: %s\n", path, strerror(errno));
+		goto err;
+	}
+
+	ring->ctx = ctx;
+	ring->hdr = addr;
+	ring->slots = (char *) addr + sizeof(struct event_ring_header);
+	ring->size = size;
+	ring->producer = true;
+
+	memcpy(ring->hdr->magic, EVENT_RING_MAGIC, sizeof(ring->hdr->magic));
+	ring->hdr->version = EVENT_RING_VERSION;
+	ring->hdr->record_size = sizeof(struct ndctl_event_record);
+	ring->hdr->nr_records = nr;
+
+	rc = rename(tmp, path);
+	if (rc < 0) {
+		err(ctx, "%s: failed to publish: %s\n", path, strerror(errno));
+		munmap(addr, size);
+		goto err;
+	}
+
+	dbg(ctx, "%s: %u records\n", path, nr);
+	close(fd);
+	free(tmp);
+	return ring;
+ err:
+	if (fd >= 0) {
+		unlink(tmp);
+		close(fd);
+	}
+	free(tmp);
+	free(ring);
+	return NULL;
+}
+
+/**
+ * ndctl_event_ring_open - attach to the event ring at @path as a consumer
+ * @ctx: ndctl library context
+ * @path: ring file passed to ndctl_event_ring_new() by the producer
+ *
+ * Reading starts with the next record published after the open.
+ */
+NDCTL_EXPORT struct ndctl_event_ring *ndctl_event_ring_open(
+		struct ndctl_ctx *ctx, const char *path)
+{
+	struct event_ring_header *hdr;
+	struct ndctl_event_ring *ring;
+	struct stat st;
+	void *addr;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		err(ctx, "%s: failed to open: %s\n", path, strerror(errno));
+		return NULL;
+	}
+
+	if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(*hdr)) {
+		err(ctx, "%s: not an event ring\n", path);
+		close(fd);
+		return NULL;
+	}
+
+	addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED) {
+		err(ctx, "%s: failed to map: %s\n", path, strerror(errno));
+		return NULL;
+	}
+
+	hdr = addr;
+	if (memcmp(hdr->magic, EVENT_RING_MAGIC, sizeof(hdr->magic)) != 0
+			|| hdr->version != EVENT_RING_VERSION
+			|| hdr->record_size < sizeof(struct ndctl_event_record)
+			|| !hdr->nr_records
+			|| (hdr->nr_records & (hdr->nr_records - 1))
+			|| sizeof(*hdr) + (size_t) hdr->nr_records
+				* hdr->record_size > (size_t) st.st_size) {
+		err(ctx, "%s: invalid event ring\n", path);
+		munmap(addr, st.st_size);
+		return NULL;
+	}
+
+	ring = calloc(1, sizeof(*ring));
+	if (!ring) {
+		munmap(addr, st.st_size);
+		return NULL;
+	}
+
+	ring->ctx = ctx;
+	ring->hdr = hdr;
+	ring->slots = (char *) addr + sizeof(*hdr);
+	ring->size = st.st_size;
+	ring->pos = __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+	return ring;
+}
+
+/**
+ * ndctl_event_ring_close - unmap the ring and release @ring
+ * @ring: ring from ndctl_event_ring_new() or ndctl_event_ring_open()
+ *
+ * When the producer closes, consumers drain the remaining records and
+ * then see -EPIPE.
+ */
+NDCTL_EXPORT void ndctl_event_ring_close(struct ndctl_event_ring *ring)
+{
+	if (!ring)
+		return;
+
+	if (ring->producer) {
+		__atomic_store_n(&ring->hdr->closed, 1, __ATOMIC_RELEASE);
+		__atomic_add_fetch(&ring->hdr->wake, 1, __ATOMIC_RELEASE);
+		futex(&ring->hdr->wake, FUTEX_WAKE, INT_MAX, NULL);
+	}
+	munmap(ring->hdr, ring->size);
+	free(ring);
+}
+
+/**
+ * ndctl_event_ring_post - publish @rec to all consumers
+ * @ring: ring from ndctl_event_ring_new()
+ * @rec: record to publish, its seq field is assigned here
+ *
+ * Never blocks, consumers that fall more than the ring capacity behind
+ * lose the oldest records.
+ */
+NDCTL_EXPORT int ndctl_event_ring_post(struct ndctl_event_ring *ring,
+		struct ndctl_event_record *rec)
+{
+	struct event_ring_header *hdr = ring->hdr;
+	struct ndctl_event_record *slot;
+	u64 seq;
+
+	if (!ring->producer)
+		return -EPERM;
+
+	seq = hdr->head;
+	slot = ring_slot(ring, seq);
+
+	__atomic_store_n(&slot->seq, 0, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	rec->seq = 0;
+	memcpy(slot, rec, sizeof(*rec));
+	__atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELEASE);
+	__atomic_store_n(&hdr->head, seq + 1, __ATOMIC_RELEASE);
+	rec->seq = seq + 1;
+
+	__atomic_add_fetch(&hdr->wake, 1, __ATOMIC_RELEASE);
+	futex(&hdr->wake, FUTEX_WAKE, INT_MAX, NULL);
+	return 0;
+}
+
+/**
+ * ndctl_event_ring_read - copy out the next unread record
+ * @ring: ring from ndctl_event_ring_open()
+ * @rec: destination for the record
+ *
+ * Returns 1 when a record was copied, 0 when there are no unread records,
+ * or -EPIPE once the producer has closed the ring and it is drained.
+ * Records the producer overwrote before they could be read are skipped
+ * and counted by ndctl_event_ring_get_lost().
+ */
+NDCTL_EXPORT int ndctl_event_ring_read(struct ndctl_event_ring *ring,
+		struct ndctl_event_record *rec)
+{
+	struct event_ring_header *hdr = ring->hdr;
+	struct ndctl_event_record *slot;
+	u64 head, seq;
+
+	for (;;) {
+		head = __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+		if (ring->pos == head)
+			return __atomic_load_n(&hdr->closed, __ATOMIC_ACQUIRE)
+				? -EPIPE : 0;
+
+		if (head - ring->pos > hdr->nr_records) {
+			ring->lost += head - hdr->nr_records - ring->pos;
+			ring->pos = head - hdr->nr_records;
+		}
+
+		slot = ring_slot(ring, ring->pos);
+		seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		if (seq == ring->pos + 1) {
+			memcpy(rec, slot, sizeof(*rec));
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED)
+					== seq) {
+				rec->seq = seq;
+				ring->pos++;
+				return 1;
+			}
+		}
+
+		/* lapped by the producer while reading this slot */
+		ring->lost++;
+		ring->pos++;
+	}
+}
+
+/**
+ * ndctl_event_ring_wait - sleep until a record is available to read
+ * @ring: ring from ndctl_event_ring_open()
+ * @timeout_ms: maximum time to sleep, negative to wait indefinitely
+ *
+ * Returns 0 when ndctl_event_ring_read() has a record, -ETIMEDOUT, -EINTR,
+ * or -EPIPE when the producer has closed the ring.
+ */
+NDCTL_EXPORT int ndctl_event_ring_wait(struct ndctl_event_ring *ring,
+		int timeout_ms)
+{
+	struct event_ring_header *hdr = ring->hdr;
+	struct timespec ts, *tsp = NULL;
+	u32 wake;
+
+	if (timeout_ms >= 0) {
+		ts.tv_sec = timeout_ms / 1000;
+		ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+		tsp = &ts;
+	}
+
+	for (;;) {
+		wake = __atomic_load_n(&hdr->wake, __ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE) != ring->pos)
+			return 0;
+		if (__atomic_load_n(&hdr->closed, __ATOMIC_ACQUIRE))
+			return -EPIPE;
+
+		if (futex(&hdr->wake, FUTEX_WAIT, wake, tsp) < 0
+				&& errno != EAGAIN)
+			return -errno;
+	}
+}
+
+NDCTL_EXPORT unsigned long long ndctl_event_ring_get_lost(
+		struct ndctl_event_ring *ring)
+{
+	return ring->lost;
+}
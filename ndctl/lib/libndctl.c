@@ -25,6 +25,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/ioctl.h>
+#include <sys/epoll.h>
 #include <ccan/list/list.h>
 #include <ccan/minmax/minmax.h>
 #include <ccan/array_size/array_size.h>
@@ -42,11 +43,26 @@ static uuid_t null_uuid;
 
 /**
  * DOC: General note, the structure layouts are privately defined.
- * Access struct member fields with ndctl_<object>_get_<property>.  This
- * library is multithread-aware in that it supports multiple
- * simultaneous reference-counted contexts, but it is not multithread
- * safe.  Also note that there is no coordination between contexts,
- * changes made in one context instance may not be reflected in another.
+ * Access struct member fields with ndctl_<object>_get_<property>.  Also
+ * note that there is no coordination between contexts, changes made in
+ * one context instance may not be reflected in another.
+ *
+ * A context may be shared by several threads within these rules:
+ *
+ * - Walking the bus, dimm, region, namespace, btt, pfn, dax and mapping
+ *   lists may run concurrently. Each list is populated once, on first
+ *   walk, and is complete by the time any thread sees its first entry.
+ * - ndctl_process_udev_events() and ndctl_invalidate() edit the lists,
+ *   and wait for threads inside ndctl_topology_read_lock() to leave.
+ *   Threads that walk while another thread may apply events hold that
+ *   lock across the walk, and must not apply events while holding it.
+ * - Objects are not locked internally. Calls on distinct dimms (e.g.
+ *   health commands) may run concurrently with each other and with
+ *   calls on regions. Calls on one region and its children, including
+ *   namespace creation and region enable / disable, and calls on one
+ *   dimm, must be serialized by the caller.
+ * - ndctl_new(), ndctl_unref() of the last reference, and the log and
+ *   timeout setters are not synchronized.
  */
 
 /**
@@ -281,6 +297,7 @@ NDCTL_EXPORT void ndctl_set_userdata(struct ndctl_ctx *ctx, void *userdata)
 NDCTL_EXPORT int ndctl_new(struct ndctl_ctx **ctx)
 {
 	struct daxctl_ctx *daxctl_ctx;
+	pthread_mutexattr_t attr;
 	struct kmod_ctx *kmod_ctx;
 	struct ndctl_ctx *c;
 	struct udev *udev;
@@ -307,11 +324,20 @@ NDCTL_EXPORT int ndctl_new(struct ndctl_ctx **ctx)
 		goto err_ctx;
 	}
 
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&c->lock, &attr);
+	pthread_mutexattr_destroy(&attr);
+	pthread_rwlock_init(&c->topology_lock, NULL);
+
 	c->refcount = 1;
 	log_init(&c->ctx, "libndctl", "NDCTL_LOG");
 	c->udev = udev;
 	c->timeout = 5000;
 	list_head_init(&c->busses);
+	list_head_init(&c->stale_busses);
+	list_head_init(&c->bind_hints);
+	list_head_init(&c->module_aliases);
 
 	info(c, "ctx %p created\n", c);
 	dbg(c, "log_priority=%d\n", c->ctx.log_priority);
@@ -371,7 +397,7 @@ NDCTL_EXPORT struct ndctl_ctx *ndctl_ref(struct ndctl_ctx *ctx)
 {
 	if (ctx == NULL)
 		return NULL;
-	ctx->refcount++;
+	__atomic_add_fetch(&ctx->refcount, 1, __ATOMIC_RELAXED);
 	return ctx;
 }
 
@@ -560,9 +586,8 @@ static void free_stale_daxs(struct ndctl_region *region)
 		free_dax(dax, &region->stale_daxs);
 }
 
-static void free_region(struct ndctl_region *region)
+static void free_region(struct ndctl_region *region, struct list_head *head)
 {
-	struct ndctl_bus *bus = region->bus;
 	struct ndctl_mapping *mapping, *_m;
 
 	list_for_each_safe(&region->mappings, mapping, _m, list) {
@@ -577,7 +602,8 @@ static void free_region(struct ndctl_region *region)
 	free_stale_daxs(region);
 	free_namespaces(region);
 	free_stale_namespaces(region);
-	list_del_from(&bus->regions, &region->list);
+	if (head)
+		list_del_from(head, &region->list);
 	kmod_module_unref(region->module);
 	free(region->region_buf);
 	free(region->region_path);
@@ -611,8 +637,14 @@ static void free_bus(struct ndctl_bus *bus, struct list_head *head)
 		list_del_from(&bus->dimms, &dimm->list);
 		free_dimm(dimm);
 	}
+	list_for_each_safe(&bus->stale_dimms, dimm, _d, list) {
+		list_del_from(&bus->stale_dimms, &dimm->list);
+		free_dimm(dimm);
+	}
 	list_for_each_safe(&bus->regions, region, _r, list)
-		free_region(region);
+		free_region(region, &bus->regions);
+	list_for_each_safe(&bus->stale_regions, region, _r, list)
+		free_region(region, &bus->stale_regions);
 	if (head)
 		list_del_from(head, &bus->list);
 	free(bus->provider);
@@ -625,10 +657,29 @@ static void free_bus(struct ndctl_bus *bus, struct list_head *head)
 
 static void free_context(struct ndctl_ctx *ctx)
 {
+	struct module_alias *ma, *_m;
+	struct bind_hint *hint, *_h;
 	struct ndctl_bus *bus, *_b;
 
 	list_for_each_safe(&ctx->busses, bus, _b, list)
 		free_bus(bus, &ctx->busses);
+	list_for_each_safe(&ctx->stale_busses, bus, _b, list)
+		free_bus(bus, &ctx->stale_busses);
+	list_for_each_safe(&ctx->bind_hints, hint, _h, list) {
+		list_del_from(&ctx->bind_hints, &hint->list);
+		free(hint->devtype);
+		free(hint->modname);
+		free(hint->driver);
+		free(hint);
+	}
+	list_for_each_safe(&ctx->module_aliases, ma, _m, list) {
+		list_del_from(&ctx->module_aliases, &ma->list);
+		kmod_module_unref(ma->module);
+		free(ma->alias);
+		free(ma);
+	}
+	pthread_rwlock_destroy(&ctx->topology_lock);
+	pthread_mutex_destroy(&ctx->lock);
 	free(ctx);
 }
 
@@ -643,9 +694,9 @@ NDCTL_EXPORT struct ndctl_ctx *ndctl_unref(struct ndctl_ctx *ctx)
 {
 	if (ctx == NULL)
 		return NULL;
-	ctx->refcount--;
-	if (ctx->refcount > 0)
+	if (__atomic_sub_fetch(&ctx->refcount, 1, __ATOMIC_ACQ_REL) > 0)
 		return NULL;
+	udev_monitor_unref(ctx->udev_monitor);
 	udev_queue_unref(ctx->udev_queue);
 	udev_unref(ctx->udev);
 	kmod_unref(ctx->kmod_ctx);
@@ -718,7 +769,7 @@ static int device_parse(struct ndctl_ctx *ctx, struct ndctl_bus *bus,
 		add_dev_fn add_dev)
 {
 	if (bus)
-		ndctl_bus_wait_probe(bus);
+		bus_wait_probe(bus);
 	return sysfs_device_parse(ctx, base_path, dev_name, parent, add_dev);
 }
 
@@ -827,7 +878,10 @@ static void *add_bus(void *parent, int id, const char *ctl_base)
 		goto err_bus;
 	list_head_init(&bus->dimms);
 	list_head_init(&bus->regions);
+	list_head_init(&bus->stale_dimms);
+	list_head_init(&bus->stale_regions);
 	bus->ctx = ctx;
+	bus->probe_gen = 1;
 	bus->id = id;
 
 	sprintf(path, "%s/dev", ctl_base);
@@ -908,18 +962,73 @@ static void *add_bus(void *parent, int id, const char *ctl_base)
 	return NULL;
 }
 
+/*
+ * The *_init flags are 0 until a list is populated, INIT_BUSY while the
+ * thread holding ctx->lock populates it (so that re-entry from the add
+ * path is a nop, as before), and INIT_DONE once the list is complete.
+ * INIT_DONE is stored with release semantics, so a walker that sees it
+ * without the lock also sees the whole list.
+ */
+enum {
+	INIT_BUSY = 1,
+	INIT_DONE,
+};
+
+static bool init_begin(struct ndctl_ctx *ctx, int *init)
+{
+	if (__atomic_load_n(init, __ATOMIC_ACQUIRE) == INIT_DONE)
+		return false;
+
+	pthread_mutex_lock(&ctx->lock);
+	if (*init) {
+		pthread_mutex_unlock(&ctx->lock);
+		return false;
+	}
+	*init = INIT_BUSY;
+	return true;
+}
+
+static void init_end(struct ndctl_ctx *ctx, int *init)
+{
+	__atomic_store_n(init, INIT_DONE, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&ctx->lock);
+}
+
 static void busses_init(struct ndctl_ctx *ctx)
 {
-	if (ctx->busses_init)
+	if (!init_begin(ctx, &ctx->busses_init))
 		return;
-	ctx->busses_init = 1;
-
 	device_parse(ctx, NULL, "/sys/class/nd", "ndctl", ctx, add_bus);
+	init_end(ctx, &ctx->busses_init);
 }
 
 NDCTL_EXPORT void ndctl_invalidate(struct ndctl_ctx *ctx)
 {
+	struct ndctl_bus *bus;
+
+	pthread_rwlock_wrlock(&ctx->topology_lock);
+	list_for_each(&ctx->busses, bus, list)
+		bus_probe_changed(bus);
 	ctx->busses_init = 0;
+	pthread_rwlock_unlock(&ctx->topology_lock);
+}
+
+/**
+ * ndctl_topology_read_lock - hold off concurrent object list edits
+ * @ctx: ndctl library context
+ *
+ * Lists are only edited by ndctl_process_udev_events() and
+ * ndctl_invalidate(), which wait for all holders to release the lock.
+ * The lock is shared, walkers in several threads may hold it at once.
+ */
+NDCTL_EXPORT void ndctl_topology_read_lock(struct ndctl_ctx *ctx)
+{
+	pthread_rwlock_rdlock(&ctx->topology_lock);
+}
+
+NDCTL_EXPORT void ndctl_topology_read_unlock(struct ndctl_ctx *ctx)
+{
+	pthread_rwlock_unlock(&ctx->topology_lock);
 }
 
 /**
@@ -1175,9 +1284,12 @@ NDCTL_EXPORT struct ndctl_ctx *ndctl_bus_get_ctx(struct ndctl_bus *bus)
 NDCTL_EXPORT int ndctl_bus_wait_probe(struct ndctl_bus *bus)
 {
 	struct ndctl_ctx *ctx = ndctl_bus_get_ctx(bus);
+	unsigned long gen = __atomic_load_n(&bus->probe_gen, __ATOMIC_ACQUIRE);
 	unsigned long tmo = ctx->timeout;
+	unsigned long flushed = __atomic_load_n(&bus->probe_flushed,
+			__ATOMIC_RELAXED);
 	char buf[SYSFS_ATTR_SIZE];
-	int rc, sleep = 0;
+	int rc, empty, sleep = 0;
 
 	do {
 		rc = sysfs_read_attr(bus->ctx, bus->wait_probe_path, buf);
@@ -1185,7 +1297,10 @@ NDCTL_EXPORT int ndctl_bus_wait_probe(struct ndctl_bus *bus)
 			break;
 		if (!ctx->udev_queue)
 			break;
-		if (udev_queue_get_queue_is_empty(ctx->udev_queue))
+		pthread_mutex_lock(&ctx->lock);
+		empty = udev_queue_get_queue_is_empty(ctx->udev_queue);
+		pthread_mutex_unlock(&ctx->lock);
+		if (empty)
 			break;
 		sleep++;
 		usleep(1000);
@@ -1195,7 +1310,41 @@ NDCTL_EXPORT int ndctl_bus_wait_probe(struct ndctl_bus *bus)
 		dbg(ctx, "waited %d millisecond%s for bus%d...\n", sleep,
 				sleep == 1 ? "" : "s", ndctl_bus_get_id(bus));
 
-	return rc < 0 ? -ENXIO : 0;
+	if (rc < 0)
+		return -ENXIO;
+
+	/* probing started before @gen was sampled is now flushed */
+	while ((long) (gen - flushed) > 0
+			&& !__atomic_compare_exchange_n(&bus->probe_flushed,
+				&flushed, gen, false, __ATOMIC_RELEASE,
+				__ATOMIC_RELAXED))
+		/* retry with the updated flushed */;
+	return 0;
+}
+
+/*
+ * Probe flushes taken on the library's own behalf, before reading state
+ * that async probing may still change, are only needed if a device was
+ * bound or unbound, or the kernel reported a change, since the last
+ * flush. Every such change bumps the bus probe generation, and a flush
+ * records the generation it covers, so bulk operations pay for one
+ * flush per change rather than one per object looked at. The bump comes
+ * after the bind or unbind write has returned: bumped before it, a flush
+ * racing in from another thread would be recorded as covering a probe
+ * that had not started yet. The exported ndctl_bus_wait_probe() always
+ * flushes, for changes made outside the library.
+ */
+void bus_probe_changed(struct ndctl_bus *bus)
+{
+	__atomic_add_fetch(&bus->probe_gen, 1, __ATOMIC_RELEASE);
+}
+
+int bus_wait_probe(struct ndctl_bus *bus)
+{
+	if (__atomic_load_n(&bus->probe_flushed, __ATOMIC_ACQUIRE)
+			== __atomic_load_n(&bus->probe_gen, __ATOMIC_ACQUIRE))
+		return 0;
+	return ndctl_bus_wait_probe(bus);
 }
 
 static int __ndctl_bus_get_scrub_state(struct ndctl_bus *bus,
@@ -1337,9 +1486,138 @@ NDCTL_EXPORT int ndctl_bus_wait_for_scrub_completion(struct ndctl_bus *bus)
 	return rc;
 }
 
-static int ndctl_bind(struct ndctl_ctx *ctx, struct kmod_module *module,
+/**
+ * ndctl_bus_wait_for_scrubs - wait for scrubs to complete on several busses
+ * @buses: busses to wait on
+ * @count: number of entries in @buses
+ * @done: optional callback invoked for each bus as its scrub completes
+ * @data: passed through to @done
+ *
+ * Like ndctl_bus_wait_for_scrub_completion(), but the 'scrub' attributes
+ * of all of the busses are waited on at once, in one epoll set, so the
+ * total wait is that of the longest scrub rather than the sum. @done is
+ * called with the bus and 0 when its scrub completes, or a negative
+ * error code when the bus can not be waited on, in completion order.
+ * Returns 0 when every scrub completed, otherwise the first error.
+ */
+NDCTL_EXPORT int ndctl_bus_wait_for_scrubs(struct ndctl_bus **buses, int count,
+		void (*done)(struct ndctl_bus *bus, int rc, void *data),
+		void *data)
+{
+	struct epoll_event ev, events[8];
+	int i, n, efd, rc = 0, pending = 0;
+	struct ndctl_ctx *ctx;
+	char buf[1];
+	int *fds;
+
+	if (count <= 0)
+		return 0;
+	ctx = ndctl_bus_get_ctx(buses[0]);
+
+	fds = calloc(count, sizeof(*fds));
+	if (!fds)
+		return -ENOMEM;
+	efd = epoll_create1(EPOLL_CLOEXEC);
+	if (efd < 0) {
+		free(fds);
+		return -errno;
+	}
+
+	for (i = 0; i < count; i++) {
+		struct ndctl_bus *bus = buses[i];
+		unsigned int scrub_count;
+		bool active = false;
+		int bus_rc;
+
+		/* open before checking so a completion in between is seen */
+		fds[i] = open(bus->scrub_path, O_RDONLY|O_CLOEXEC);
+		if (fds[i] < 0)
+			bus_rc = -EOPNOTSUPP;
+		else
+			bus_rc = __ndctl_bus_get_scrub_state(bus, &scrub_count,
+					&active);
+		if (bus_rc == 0 && active) {
+			memset(&ev, 0, sizeof(ev));
+			ev.events = EPOLLPRI;
+			ev.data.u32 = i;
+			if (epoll_ctl(efd, EPOLL_CTL_ADD, fds[i], &ev) == 0) {
+				pending++;
+				continue;
+			}
+			bus_rc = -errno;
+		}
+
+		if (bus_rc == 0)
+			dbg(ctx, "bus%d: scrub complete\n",
+					ndctl_bus_get_id(bus));
+		else
+			dbg(ctx, "bus%d: error waiting for scrub completion: %s\n",
+					ndctl_bus_get_id(bus), strerror(-bus_rc));
+		if (fds[i] >= 0)
+			close(fds[i]);
+		fds[i] = -1;
+		if (bus_rc && !rc)
+			rc = bus_rc;
+		if (done)
+			done(bus, bus_rc, data);
+	}
+
+	while (pending) {
+		n = epoll_wait(efd, events, ARRAY_SIZE(events), -1);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if (!rc)
+				rc = -errno;
+			dbg(ctx, "epoll error: %s\n", strerror(errno));
+			break;
+		}
+
+		for (n--; n >= 0; n--) {
+			struct ndctl_bus *bus;
+			unsigned int scrub_count;
+			bool active = false;
+			int bus_rc;
+
+			i = events[n].data.u32;
+			bus = buses[i];
+			if (pread(fds[i], buf, 1, 0) == -1)
+				bus_rc = -errno;
+			else
+				bus_rc = __ndctl_bus_get_scrub_state(bus,
+						&scrub_count, &active);
+			if (bus_rc == 0 && active)
+				continue;
+
+			if (bus_rc == 0)
+				dbg(ctx, "bus%d: scrub complete\n",
+						ndctl_bus_get_id(bus));
+			else
+				dbg(ctx, "bus%d: error waiting for scrub completion: %s\n",
+						ndctl_bus_get_id(bus),
+						strerror(-bus_rc));
+			epoll_ctl(efd, EPOLL_CTL_DEL, fds[i], NULL);
+			close(fds[i]);
+			fds[i] = -1;
+			pending--;
+			if (bus_rc && !rc)
+				rc = bus_rc;
+			if (done)
+				done(bus, bus_rc, data);
+		}
+	}
+
+	for (i = 0; i < count; i++)
+		if (fds[i] >= 0)
+			close(fds[i]);
+	close(efd);
+	free(fds);
+	return rc;
+}
+
+static int ndctl_bind(struct ndctl_bus *bus, struct kmod_module *module,
 		const char *devname);
-static int ndctl_unbind(struct ndctl_ctx *ctx, const char *devpath);
+static int ndctl_unbind(struct ndctl_bus *bus, const char *devpath);
 static struct kmod_module *to_module(struct ndctl_ctx *ctx, const char *alias);
 
 static void *add_dimm(void *parent, int id, const char *dimm_base)
@@ -1524,11 +1802,10 @@ static void *add_dimm(void *parent, int id, const char *dimm_base)
 
 static void dimms_init(struct ndctl_bus *bus)
 {
-	if (bus->dimms_init)
+	if (!init_begin(bus->ctx, &bus->dimms_init))
 		return;
-
-	bus->dimms_init = 1;
 	device_parse(bus->ctx, bus, bus->bus_path, "nmem", bus, add_dimm);
+	init_end(bus->ctx, &bus->dimms_init);
 }
 
 NDCTL_EXPORT struct ndctl_dimm *ndctl_dimm_get_first(struct ndctl_bus *bus)
@@ -1861,7 +2138,7 @@ NDCTL_EXPORT int ndctl_dimm_disable(struct ndctl_dimm *dimm)
 	if (!ndctl_dimm_is_enabled(dimm))
 		return 0;
 
-	ndctl_unbind(ctx, dimm->dimm_path);
+	ndctl_unbind(dimm->bus, dimm->dimm_path);
 
 	if (ndctl_dimm_is_enabled(dimm)) {
 		err(ctx, "%s: failed to disable\n", devname);
@@ -1880,7 +2157,7 @@ NDCTL_EXPORT int ndctl_dimm_enable(struct ndctl_dimm *dimm)
 	if (ndctl_dimm_is_enabled(dimm))
 		return 0;
 
-	ndctl_bind(ctx, dimm->module, devname);
+	ndctl_bind(dimm->bus, dimm->module, devname);
 
 	if (!ndctl_dimm_is_enabled(dimm)) {
 		err(ctx, "%s: failed to enable\n", devname);
@@ -2138,11 +2415,10 @@ static void *add_region(void *parent, int id, const char *region_base)
 
 static void regions_init(struct ndctl_bus *bus)
 {
-	if (bus->regions_init)
+	if (!init_begin(bus->ctx, &bus->regions_init))
 		return;
-
-	bus->regions_init = 1;
 	device_parse(bus->ctx, bus, bus->bus_path, "region", bus, add_region);
+	init_end(bus->ctx, &bus->regions_init);
 }
 
 NDCTL_EXPORT struct ndctl_region *ndctl_region_get_first(struct ndctl_bus *bus)
@@ -2248,6 +2524,212 @@ NDCTL_EXPORT unsigned long long ndctl_region_get_max_available_extent(
 	return strtoull(buf, NULL, 0);
 }
 
+struct region_extent {
+	unsigned long long start, size;
+};
+
+static int cmp_extent(const void *a, const void *b)
+{
+	const struct region_extent *x = a, *y = b;
+
+	if (x->start < y->start)
+		return -1;
+	return x->start > y->start;
+}
+
+/*
+ * The free ranges of a pmem region are the gaps in its physical address
+ * range between the namespaces that have been given a size. Returns the
+ * number of ranges stored in @extents, to be freed by the caller.
+ */
+static int region_free_extents(struct ndctl_region *region,
+		struct region_extent **extents)
+{
+	unsigned long long start = ndctl_region_get_resource(region);
+	unsigned long long end = start + ndctl_region_get_size(region);
+	struct region_extent *used = NULL, *free_ext, *e;
+	struct ndctl_namespace *ndns;
+	int i, nr_used = 0, nr_free = 0;
+
+	if (start == ULLONG_MAX)
+		return -ENXIO;
+
+	ndctl_namespace_foreach(region, ndns) {
+		unsigned long long size = ndctl_namespace_get_size(ndns);
+		unsigned long long res = ndctl_namespace_get_resource(ndns);
+
+		if (!size)
+			continue;
+		if (res == ULLONG_MAX) {
+			free(used);
+			return -ENXIO;
+		}
+		e = realloc(used, (nr_used + 1) * sizeof(*used));
+		if (!e) {
+			free(used);
+			return -ENOMEM;
+		}
+		used = e;
+		used[nr_used++] = (struct region_extent) {
+			.start = res,
+			.size = size,
+		};
+	}
+
+	free_ext = calloc(nr_used + 1, sizeof(*free_ext));
+	if (!free_ext) {
+		free(used);
+		return -ENOMEM;
+	}
+
+	if (nr_used)
+		qsort(used, nr_used, sizeof(*used), cmp_extent);
+	for (i = 0; i <= nr_used; i++) {
+		unsigned long long next = i < nr_used ? used[i].start : end;
+
+		if (next > start)
+			free_ext[nr_free++] = (struct region_extent) {
+				.start = start,
+				.size = next - start,
+			};
+		if (i < nr_used)
+			start = max(start, used[i].start + used[i].size);
+	}
+	free(used);
+
+	*extents = free_ext;
+	return nr_free;
+}
+
+/**
+ * ndctl_region_get_num_free_extents - count the free ranges of a pmem region
+ * @region: pmem region
+ *
+ * Returns the number of physical address ranges of the region not used
+ * by a sized namespace, or a negative error code. Retrieve the ranges, in
+ * address order, with ndctl_region_get_free_extent().
+ */
+NDCTL_EXPORT int ndctl_region_get_num_free_extents(struct ndctl_region *region)
+{
+	struct region_extent *extents;
+	int nr;
+
+	if (ndctl_region_get_nstype(region) != ND_DEVICE_NAMESPACE_PMEM)
+		return -EOPNOTSUPP;
+	nr = region_free_extents(region, &extents);
+	if (nr >= 0)
+		free(extents);
+	return nr;
+}
+
+NDCTL_EXPORT int ndctl_region_get_free_extent(struct ndctl_region *region,
+		int i, unsigned long long *start, unsigned long long *size)
+{
+	struct region_extent *extents;
+	int nr;
+
+	if (ndctl_region_get_nstype(region) != ND_DEVICE_NAMESPACE_PMEM)
+		return -EOPNOTSUPP;
+	nr = region_free_extents(region, &extents);
+	if (nr < 0)
+		return nr;
+	if (i < 0 || i >= nr) {
+		free(extents);
+		return -ENXIO;
+	}
+	*start = extents[i].start;
+	*size = extents[i].size;
+	free(extents);
+	return 0;
+}
+
+static bool extents_fit(struct region_extent *extents, int nr,
+		unsigned long long available, unsigned int count,
+		unsigned long long size)
+{
+	unsigned long long fit = 0;
+	int i;
+
+	if (!size || size > available / count)
+		return false;
+	for (i = 0; i < nr && fit < count; i++)
+		fit += extents[i].size / size;
+	return fit >= count;
+}
+
+/**
+ * ndctl_region_plan_namespaces - size @count namespaces before creating them
+ * @region: pmem or blk region to carve
+ * @count: number of namespaces to create
+ * @align: size granule of each namespace before interleave, e.g. 2M
+ * @size: size of each namespace, or 0 to find the largest that fits
+ *
+ * A pmem namespace needs a contiguous range of the region, so @count
+ * namespaces fit if the free ranges between the existing namespaces hold
+ * that many, and the region's available size, which also accounts for
+ * capacity aliased by blk namespaces, covers them. A blk namespace only
+ * needs available capacity. Nothing is allocated, the plan holds as long
+ * as the region is not changed by others before the namespaces are made.
+ *
+ * Returns 0 with @size set, -ENOSPC if the namespaces do not fit, or
+ * -EINVAL if @size is not a multiple of @align times the interleave ways.
+ */
+NDCTL_EXPORT int ndctl_region_plan_namespaces(struct ndctl_region *region,
+		unsigned int count, unsigned long long align,
+		unsigned long long *size)
+{
+	unsigned long long available, granule, lo, hi, mid;
+	unsigned int ways = ndctl_region_get_interleave_ways(region);
+	struct region_extent *extents, blk_extent;
+	int nr, rc = 0;
+
+	if (!count || !align || !ways)
+		return -EINVAL;
+	granule = align * ways;
+	if (*size % granule)
+		return -EINVAL;
+
+	available = ndctl_region_get_available_size(region);
+	if (available == ULLONG_MAX)
+		return -ENXIO;
+
+	if (ndctl_region_get_nstype(region) == ND_DEVICE_NAMESPACE_PMEM) {
+		nr = region_free_extents(region, &extents);
+		if (nr < 0)
+			return nr;
+	} else {
+		blk_extent.start = 0;
+		blk_extent.size = available;
+		extents = &blk_extent;
+		nr = 1;
+	}
+
+	if (*size) {
+		if (!extents_fit(extents, nr, available, count, *size))
+			rc = -ENOSPC;
+		goto out;
+	}
+
+	/* the fit only shrinks as the size grows, find the last that fits */
+	lo = 0;
+	hi = available / count / granule;
+	while (lo < hi) {
+		mid = lo + (hi - lo + 1) / 2;
+		if (extents_fit(extents, nr, available, count, mid * granule))
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	if (lo)
+		*size = lo * granule;
+	else
+		rc = -ENOSPC;
+ out:
+	if (extents != &blk_extent)
+		free(extents);
+	return rc;
+}
+
 NDCTL_EXPORT unsigned int ndctl_region_get_range_index(struct ndctl_region *region)
 {
 	return region->range_index;
@@ -2838,7 +3320,7 @@ static int is_enabled(struct ndctl_bus *bus, const char *drvpath)
 {
 	struct stat st;
 
-	ndctl_bus_wait_probe(bus);
+	bus_wait_probe(bus);
 	if (lstat(drvpath, &st) < 0 || !S_ISLNK(st.st_mode))
 		return 0;
 	else
@@ -2868,7 +3350,7 @@ NDCTL_EXPORT int ndctl_region_enable(struct ndctl_region *region)
 	if (ndctl_region_is_enabled(region))
 		return 0;
 
-	ndctl_bind(ctx, region->module, devname);
+	ndctl_bind(region->bus, region->module, devname);
 
 	if (!ndctl_region_is_enabled(region)) {
 		err(ctx, "%s: failed to enable\n", devname);
@@ -2891,10 +3373,15 @@ void region_flag_refresh(struct ndctl_region *region)
 
 NDCTL_EXPORT void ndctl_region_cleanup(struct ndctl_region *region)
 {
+	struct ndctl_ctx *ctx = ndctl_region_get_ctx(region);
+
+	/* module references are dropped into the shared kmod ctx */
+	pthread_mutex_lock(&ctx->lock);
 	free_stale_namespaces(region);
 	free_stale_btts(region);
 	free_stale_pfns(region);
 	free_stale_daxs(region);
+	pthread_mutex_unlock(&ctx->lock);
 }
 
 static int ndctl_region_disable(struct ndctl_region *region, int cleanup)
@@ -2905,7 +3392,7 @@ static int ndctl_region_disable(struct ndctl_region *region, int cleanup)
 	if (!ndctl_region_is_enabled(region))
 		return 0;
 
-	ndctl_unbind(ctx, region->region_path);
+	ndctl_unbind(region->bus, region->region_path);
 
 	if (ndctl_region_is_enabled(region)) {
 		err(ctx, "%s: failed to disable\n", devname);
@@ -3068,15 +3555,14 @@ static void mappings_init(struct ndctl_region *region)
 	struct ndctl_ctx *ctx = bus->ctx;
 	int i;
 
-	if (region->mappings_init)
+	if (!init_begin(ctx, &region->mappings_init))
 		return;
-	region->mappings_init = 1;
 
 	mapping_path = calloc(1, strlen(region->region_path) + 100);
 	if (!mapping_path) {
 		err(ctx, "bus%d region%d: allocation failure\n",
 				bus->id, region->id);
-		return;
+		goto out;
 	}
 
 	for (i = 0; i < region->num_mappings; i++) {
@@ -3125,6 +3611,8 @@ static void mappings_init(struct ndctl_region *region)
 		list_add(&region->mappings, &mapping->list);
 	}
 	free(mapping_path);
+ out:
+	init_end(ctx, &region->mappings_init);
 }
 
 NDCTL_EXPORT struct ndctl_mapping *ndctl_mapping_get_first(struct ndctl_region *region)
@@ -3179,25 +3667,50 @@ NDCTL_EXPORT struct ndctl_ctx *ndctl_mapping_get_ctx(
 	return ndctl_mapping_get_bus(mapping)->ctx;
 }
 
+/*
+ * Every device of a type shares a modalias, so lookups are memoized in
+ * the ctx, including failed ones, and each distinct alias costs one pass
+ * over the kmod indexes. Callers get their own module reference.
+ */
 static struct kmod_module *to_module(struct ndctl_ctx *ctx, const char *alias)
 {
 	struct kmod_list *list = NULL;
-	struct kmod_module *mod;
+	struct kmod_module *mod = NULL;
+	struct module_alias *ma;
 	int rc;
 
 	if (!ctx->kmod_ctx)
 		return NULL;
 
+	pthread_mutex_lock(&ctx->lock);
+	list_for_each(&ctx->module_aliases, ma, list)
+		if (strcmp(ma->alias, alias) == 0) {
+			mod = kmod_module_ref(ma->module);
+			goto out;
+		}
+
 	rc = kmod_module_new_from_lookup(ctx->kmod_ctx, alias, &list);
-	if (rc < 0 || !list) {
+	if (rc < 0 || !list)
 		dbg(ctx, "failed to find module for alias: %s %d list: %s\n",
 				alias, rc, list ? "populated" : "empty");
-		return NULL;
+	else {
+		mod = kmod_module_get_module(list);
+		dbg(ctx, "alias: %s module: %s\n", alias,
+				kmod_module_get_name(mod));
+		kmod_module_unref_list(list);
+	}
+
+	ma = calloc(1, sizeof(*ma));
+	if (ma)
+		ma->alias = strdup(alias);
+	if (!ma || !ma->alias) {
+		free(ma);
+		goto out;
 	}
-	mod = kmod_module_get_module(list);
-	dbg(ctx, "alias: %s module: %s\n", alias, kmod_module_get_name(mod));
-	kmod_module_unref_list(list);
-
+	ma->module = mod ? kmod_module_ref(mod) : NULL;
+	list_add(&ctx->module_aliases, &ma->list);
+ out:
+	pthread_mutex_unlock(&ctx->lock);
 	return mod;
 }
 
@@ -3386,12 +3899,12 @@ static void namespaces_init(struct ndctl_region *region)
 	struct ndctl_ctx *ctx = bus->ctx;
 	char ndns_fmt[20];
 
-	if (region->namespaces_init)
+	if (!init_begin(ctx, &region->namespaces_init))
 		return;
-	region->namespaces_init = 1;
 
 	sprintf(ndns_fmt, "namespace%d.", region->id);
 	device_parse(ctx, bus, region->region_path, ndns_fmt, region, add_namespace);
+	init_end(ctx, &region->namespaces_init);
 }
 
 NDCTL_EXPORT struct ndctl_namespace *ndctl_namespace_get_first(struct ndctl_region *region)
@@ -3531,7 +4044,7 @@ NDCTL_EXPORT const char *ndctl_namespace_get_block_device(struct ndctl_namespace
 		return "";
 	}
 
-	ndctl_bus_wait_probe(bus);
+	bus_wait_probe(bus);
 	ndns->bdev = get_block_device(ctx, path);
 	return ndns->bdev ? ndns->bdev : "";
 }
@@ -3684,9 +4197,67 @@ NDCTL_EXPORT struct badblock *ndctl_namespace_get_first_badblock(
 	return badblocks_iter_first(&ndns->bb_iter, ctx, path);
 }
 
-static int ndctl_bind(struct ndctl_ctx *ctx, struct kmod_module *module,
+/* find or add the hint for devices like @devname, call with ctx->lock */
+static struct bind_hint *bind_hint_get(struct ndctl_ctx *ctx,
+		struct kmod_module *module, const char *devname)
+{
+	const char *modname = module ? kmod_module_get_name(module) : NULL;
+	size_t len = strcspn(devname, "0123456789");
+	struct bind_hint *hint;
+
+	list_for_each(&ctx->bind_hints, hint, list)
+		if (strlen(hint->devtype) == len
+				&& strncmp(hint->devtype, devname, len) == 0
+				&& (modname == hint->modname || (modname
+						&& hint->modname
+						&& strcmp(modname,
+							hint->modname) == 0)))
+			return hint;
+
+	hint = calloc(1, sizeof(*hint));
+	if (!hint)
+		return NULL;
+	hint->devtype = strndup(devname, len);
+	if (modname)
+		hint->modname = strdup(modname);
+	if (!hint->devtype || (modname && !hint->modname)) {
+		free(hint->devtype);
+		free(hint->modname);
+		free(hint);
+		return NULL;
+	}
+	list_add(&ctx->bind_hints, &hint->list);
+	return hint;
+}
+
+static int bind_driver(struct ndctl_ctx *ctx, const char *driver,
 		const char *devname)
 {
+	char *drv_path;
+	int rc;
+
+	if (asprintf(&drv_path, "/sys/bus/nd/drivers/%s/bind", driver) < 0) {
+		err(ctx, "%s: path allocation failure\n", devname);
+		return -ENOMEM;
+	}
+	rc = sysfs_write_attr_quiet(ctx, drv_path, devname);
+	free(drv_path);
+	return rc;
+}
+
+/*
+ * Devices of one type, with one module, are bound by the same driver, so
+ * the driver that accepted the last one is tried first, and a module is
+ * inserted once per context. If the hint fails, say the module has been
+ * removed since, the module is inserted again and every driver is tried.
+ */
+static int ndctl_bind(struct ndctl_bus *bus, struct kmod_module *module,
+		const char *devname)
+{
+	struct ndctl_ctx *ctx = bus->ctx;
+	struct bind_hint *hint = NULL;
+	char *driver = NULL;
+	bool loaded = false;
 	DIR *dir;
 	int rc = 0;
 	char path[200];
@@ -3698,10 +4269,34 @@ static int ndctl_bind(struct ndctl_ctx *ctx, struct kmod_module *module,
 		return -EINVAL;
 	}
 
-	if (module) {
+	pthread_mutex_lock(&ctx->lock);
+	hint = bind_hint_get(ctx, module, devname);
+	if (hint) {
+		loaded = hint->loaded;
+		if (loaded && hint->driver)
+			driver = strdup(hint->driver);
+	}
+	pthread_mutex_unlock(&ctx->lock);
+
+	if (driver) {
+		rc = bind_driver(ctx, driver, devname);
+		free(driver);
+		if (rc == 0) {
+			bus_probe_changed(bus);
+			return 0;
+		}
+		dbg(ctx, "%s: hinted driver failed, trying all\n", devname);
+		loaded = false;
+	}
+
+	if (module && !loaded) {
+		pthread_mutex_lock(&ctx->lock);
 		rc = kmod_module_probe_insert_module(module,
 				KMOD_PROBE_APPLY_BLACKLIST, NULL, NULL, NULL,
 				NULL);
+		if (rc >= 0 && hint)
+			hint->loaded = true;
+		pthread_mutex_unlock(&ctx->lock);
 		if (rc < 0) {
 			err(ctx, "%s: insert failure: %d\n", __func__, rc);
 			return rc;
@@ -3720,43 +4315,51 @@ static int ndctl_bind(struct ndctl_ctx *ctx, struct kmod_module *module,
 	}
 
 	while ((de = readdir(dir)) != NULL) {
-		char *drv_path;
-
 		if (de->d_ino == 0)
 			continue;
 		if (de->d_name[0] == '.')
 			continue;
-		if (asprintf(&drv_path, "%s/%s/bind", path, de->d_name) < 0) {
-			err(ctx, "%s: path allocation failure\n", devname);
-			continue;
-		}
 
-		rc = sysfs_write_attr_quiet(ctx, drv_path, devname);
-		free(drv_path);
+		rc = bind_driver(ctx, de->d_name, devname);
 		if (rc == 0)
 			break;
 	}
+
+	if (rc == 0 && de && hint) {
+		driver = strdup(de->d_name);
+		pthread_mutex_lock(&ctx->lock);
+		free(hint->driver);
+		hint->driver = driver;
+		hint->loaded = true;
+		pthread_mutex_unlock(&ctx->lock);
+	}
 	closedir(dir);
 
 	if (rc) {
 		dbg(ctx, "%s: bind failed\n", devname);
 		return -ENXIO;
 	}
+	bus_probe_changed(bus);
 	return 0;
 }
 
-static int ndctl_unbind(struct ndctl_ctx *ctx, const char *devpath)
+static int ndctl_unbind(struct ndctl_bus *bus, const char *devpath)
 {
 	const char *devname = devpath_to_devname(devpath);
+	struct ndctl_ctx *ctx = bus->ctx;
 	char path[200];
 	const int len = sizeof(path);
+	int rc;
 
 	if (snprintf(path, len, "%s/driver/unbind", devpath) >= len) {
 		err(ctx, "%s: buffer too small!\n", devname);
 		return -ENXIO;
 	}
 
-	return sysfs_write_attr(ctx, path, devname);
+	rc = sysfs_write_attr(ctx, path, devname);
+	if (rc == 0)
+		bus_probe_changed(bus);
+	return rc;
 }
 
 static void *add_btt(void *parent, int id, const char *btt_base);
@@ -3768,12 +4371,12 @@ static void btts_init(struct ndctl_region *region)
 	struct ndctl_bus *bus = ndctl_region_get_bus(region);
 	char btt_fmt[20];
 
-	if (region->btts_init)
+	if (!init_begin(bus->ctx, &region->btts_init))
 		return;
-	region->btts_init = 1;
 
 	sprintf(btt_fmt, "btt%d.", region->id);
 	device_parse(bus->ctx, bus, region->region_path, btt_fmt, region, add_btt);
+	init_end(bus->ctx, &region->btts_init);
 }
 
 static void pfns_init(struct ndctl_region *region)
@@ -3781,12 +4384,12 @@ static void pfns_init(struct ndctl_region *region)
 	struct ndctl_bus *bus = ndctl_region_get_bus(region);
 	char pfn_fmt[20];
 
-	if (region->pfns_init)
+	if (!init_begin(bus->ctx, &region->pfns_init))
 		return;
-	region->pfns_init = 1;
 
 	sprintf(pfn_fmt, "pfn%d.", region->id);
 	device_parse(bus->ctx, bus, region->region_path, pfn_fmt, region, add_pfn);
+	init_end(bus->ctx, &region->pfns_init);
 }
 
 static void daxs_init(struct ndctl_region *region)
@@ -3794,12 +4397,12 @@ static void daxs_init(struct ndctl_region *region)
 	struct ndctl_bus *bus = ndctl_region_get_bus(region);
 	char dax_fmt[20];
 
-	if (region->daxs_init)
+	if (!init_begin(bus->ctx, &region->daxs_init))
 		return;
-	region->daxs_init = 1;
 
 	sprintf(dax_fmt, "dax%d.", region->id);
 	device_parse(bus->ctx, bus, region->region_path, dax_fmt, region, add_dax);
+	init_end(bus->ctx, &region->daxs_init);
 }
 
 static void region_refresh_children(struct ndctl_region *region)
@@ -3814,6 +4417,557 @@ static void region_refresh_children(struct ndctl_region *region)
 	daxs_init(region);
 }
 
+/*
+ * Incremental topology updates from udev events. Objects are only added
+ * to lists that have already been populated, anything else is picked up
+ * by the lazy *_init() paths when first walked. Removed objects move to
+ * the stale lists so that pointers held by the application stay valid
+ * until the region is cleaned up or the ctx is released. Bind and change
+ * events refresh the existing object in place.
+ */
+enum uevent_op {
+	UEVENT_ADD,
+	UEVENT_REMOVE,
+	UEVENT_REFRESH,
+};
+
+static int uevent_bus(struct ndctl_ctx *ctx, int id, const char *path,
+		enum uevent_op op)
+{
+	struct ndctl_bus *bus;
+
+	if (!ctx->busses_init)
+		return 0;
+
+	ndctl_bus_foreach(ctx, bus)
+		if (bus->id == (unsigned int) id)
+			break;
+
+	if (bus) {
+		if (op == UEVENT_ADD)
+			return 0;
+		list_del_from(&ctx->busses, &bus->list);
+		list_add_tail(&ctx->stale_busses, &bus->list);
+		return 1;
+	}
+
+	if (op == UEVENT_REMOVE)
+		return 0;
+	return add_bus(ctx, id, path) ? 1 : -ENOMEM;
+}
+
+/* the bus whose device directory contains @path */
+static struct ndctl_bus *uevent_to_bus(struct ndctl_ctx *ctx,
+		const char *path)
+{
+	struct ndctl_bus *bus;
+
+	list_for_each(&ctx->busses, bus, list) {
+		size_t len = strlen(bus->bus_path);
+
+		if (strncmp(path, bus->bus_path, len) == 0
+				&& path[len] == '/')
+			return bus;
+	}
+	return NULL;
+}
+
+static int uevent_dimm(struct ndctl_ctx *ctx, int id, const char *path,
+		enum uevent_op op)
+{
+	struct ndctl_bus *bus = uevent_to_bus(ctx, path);
+	struct ndctl_dimm *dimm;
+
+	if (!bus || !bus->dimms_init)
+		return 0;
+
+	ndctl_dimm_foreach(bus, dimm)
+		if (dimm->id == id)
+			break;
+
+	if (dimm) {
+		if (op == UEVENT_ADD)
+			return 0;
+		list_del_from(&bus->dimms, &dimm->list);
+		list_add_tail(&bus->stale_dimms, &dimm->list);
+		return 1;
+	}
+
+	if (op == UEVENT_REMOVE)
+		return 0;
+	return add_dimm(bus, id, path) ? 1 : -ENOMEM;
+}
+
+static struct ndctl_region *uevent_to_region(struct ndctl_ctx *ctx, int id)
+{
+	struct ndctl_region *region;
+	struct ndctl_bus *bus;
+
+	list_for_each(&ctx->busses, bus, list) {
+		if (!bus->regions_init)
+			continue;
+		list_for_each(&bus->regions, region, list)
+			if (region->id == id)
+				return region;
+	}
+	return NULL;
+}
+
+static int uevent_region(struct ndctl_ctx *ctx, int id, const char *path,
+		enum uevent_op op)
+{
+	struct ndctl_bus *bus = uevent_to_bus(ctx, path);
+	struct ndctl_region *region;
+
+	if (!bus || !bus->regions_init)
+		return 0;
+
+	region = uevent_to_region(ctx, id);
+	if (region) {
+		if (op == UEVENT_ADD)
+			return 0;
+		bus = region->bus;
+		list_del_from(&bus->regions, &region->list);
+		list_add_tail(&bus->stale_regions, &region->list);
+		return 1;
+	}
+
+	if (op == UEVENT_REMOVE)
+		return 0;
+	return add_region(bus, id, path) ? 1 : -ENOMEM;
+}
+
+static int refresh_lbasize(struct ndctl_ctx *ctx, const char *devname,
+		const char *buf, struct ndctl_lbasize *lba)
+{
+	struct ndctl_lbasize tmp;
+
+	if (parse_lbasize_supported(ctx, devname, buf, &tmp) < 0)
+		return -ENXIO;
+	free(lba->supported);
+	*lba = tmp;
+	return 0;
+}
+
+/* re-read the attributes add_namespace() caches */
+static int namespace_refresh(struct ndctl_namespace *ndns)
+{
+	struct ndctl_ctx *ctx = ndctl_namespace_get_ctx(ndns);
+	const char *devname = ndctl_namespace_get_devname(ndns);
+	char *path = ndns->ndns_buf;
+	char buf[SYSFS_ATTR_SIZE];
+	char *alt_name;
+	uuid_t uuid;
+
+	sprintf(path, "%s/size", ndns->ndns_path);
+	if (sysfs_read_attr(ctx, path, buf) < 0)
+		return -ENXIO;
+	ndns->size = strtoull(buf, NULL, 0);
+
+	sprintf(path, "%s/resource", ndns->ndns_path);
+	if (sysfs_read_attr(ctx, path, buf) < 0)
+		ndns->resource = ULLONG_MAX;
+	else
+		ndns->resource = strtoull(buf, NULL, 0);
+
+	sprintf(path, "%s/force_raw", ndns->ndns_path);
+	if (sysfs_read_attr(ctx, path, buf) < 0)
+		return -ENXIO;
+	ndns->raw_mode = strtoul(buf, NULL, 0);
+
+	sprintf(path, "%s/holder_class", ndns->ndns_path);
+	if (sysfs_read_attr(ctx, path, buf) == 0)
+		ndns->enforce_mode = enforce_name_to_id(buf);
+
+	free(ndns->bdev);
+	ndns->bdev = NULL;
+
+	switch (ndns->type) {
+	case ND_DEVICE_NAMESPACE_BLK:
+	case ND_DEVICE_NAMESPACE_PMEM:
+		sprintf(path, "%s/sector_size", ndns->ndns_path);
+		if (sysfs_read_attr(ctx, path, buf) < 0) {
+			if (ndns->type == ND_DEVICE_NAMESPACE_BLK)
+				return -ENXIO;
+			buf[0] = '\0';
+		}
+		if (refresh_lbasize(ctx, devname, buf, &ndns->lbasize) < 0)
+			return -ENXIO;
+
+		sprintf(path, "%s/alt_name", ndns->ndns_path);
+		if (sysfs_read_attr(ctx, path, buf) < 0)
+			return -ENXIO;
+		alt_name = strdup(buf);
+		if (!alt_name)
+			return -ENOMEM;
+		free(ndns->alt_name);
+		ndns->alt_name = alt_name;
+
+		sprintf(path, "%s/uuid", ndns->ndns_path);
+		if (sysfs_read_attr(ctx, path, buf) < 0)
+			return -ENXIO;
+		memset(uuid, 0, sizeof(uuid));
+		if (strlen(buf) && uuid_parse(buf, uuid) < 0)
+			return -ENXIO;
+		memcpy(ndns->uuid, uuid, sizeof(uuid_t));
+		break;
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+/* re-read the attributes add_btt() caches, and forget the host namespace */
+static int btt_refresh(struct ndctl_btt *btt)
+{
+	struct ndctl_ctx *ctx = ndctl_btt_get_ctx(btt);
+	const char *devname = ndctl_btt_get_devname(btt);
+	char *path = btt->btt_buf;
+	char buf[SYSFS_ATTR_SIZE];
+	uuid_t uuid;
+
+	btt->ndns = NULL;
+	free(btt->bdev);
+	btt->bdev = NULL;
+
+	sprintf(path, "%s/uuid", btt->btt_path);
+	if (sysfs_read_attr(ctx, path, buf) < 0)
+		return -ENXIO;
+	memset(uuid, 0, sizeof(uuid));
+	if (strlen(buf) && uuid_parse(buf, uuid) < 0)
+		return -ENXIO;
+	memcpy(btt->uuid, uuid, sizeof(uuid_t));
+
+	sprintf(path, "%s/sector_size", btt->btt_path);
+	if (sysfs_read_attr(ctx, path, buf) < 0)
+		return -ENXIO;
+	if (refresh_lbasize(ctx, devname, buf, &btt->lbasize) < 0)
+		return -ENXIO;
+
+	sprintf(path, "%s/size", btt->btt_path);
+	if (sysfs_read_attr(ctx, path, buf) < 0)
+		btt->size = ULLONG_MAX;
+	else
+		btt->size = strtoull(buf, NULL, 0);
+
+	return 0;
+}
+
+/* re-read the attributes __add_pfn() caches, and forget the host namespace */
+static int pfn_refresh(struct ndctl_pfn *pfn)
+{
+	struct ndctl_ctx *ctx = ndctl_region_get_ctx(pfn->region);
+	char *path = pfn->pfn_buf;
+	char buf[SYSFS_ATTR_SIZE];
+	uuid_t uuid;
+
+	pfn->ndns = NULL;
+	free(pfn->bdev);
+	pfn->bdev = NULL;
+
+	sprintf(path, "%s/uuid", pfn->pfn_path);
+	if (sysfs_read_attr(ctx, path, buf) < 0)
+		return -ENXIO;
+	memset(uuid, 0, sizeof(uuid));
+	if (strlen(buf) && uuid_parse(buf, uuid) < 0)
+		return -ENXIO;
+	memcpy(pfn->uuid, uuid, sizeof(uuid_t));
+
+	sprintf(path, "%s/mode", pfn->pfn_path);
+	if (sysfs_read_attr(ctx, path, buf) < 0)
+		return -ENXIO;
+	if (strcmp(buf, "none") == 0)
+		pfn->loc = NDCTL_PFN_LOC_NONE;
+	else if (strcmp(buf, "ram") == 0)
+		pfn->loc = NDCTL_PFN_LOC_RAM;
+	else if (strcmp(buf, "pmem") == 0)
+		pfn->loc = NDCTL_PFN_LOC_PMEM;
+	else
+		return -ENXIO;
+
+	sprintf(path, "%s/align", pfn->pfn_path);
+	if (sysfs_read_attr(ctx, path, buf) < 0)
+		pfn->align = 0;
+	else
+		pfn->align = strtoul(buf, NULL, 0);
+
+	sprintf(path, "%s/resource", pfn->pfn_path);
+	if (sysfs_read_attr(ctx, path, buf) < 0)
+		pfn->resource = ULLONG_MAX;
+	else
+		pfn->resource = strtoull(buf, NULL, 0);
+
+	sprintf(path, "%s/size", pfn->pfn_path);
+	if (sysfs_read_attr(ctx, path, buf) < 0)
+		pfn->size = ULLONG_MAX;
+	else
+		pfn->size = strtoull(buf, NULL, 0);
+
+	return 0;
+}
+
+static int uevent_namespace(struct ndctl_region *region, int id,
+		const char *path, enum uevent_op op)
+{
+	struct ndctl_namespace *ndns;
+
+	if (!region->namespaces_init)
+		return 0;
+
+	ndctl_namespace_foreach(region, ndns)
+		if (ndns->id == id)
+			break;
+
+	if (!ndns) {
+		if (op == UEVENT_REMOVE)
+			return 0;
+		return add_namespace(region, id, path) ? 1 : -ENOMEM;
+	}
+
+	if (op == UEVENT_ADD)
+		return 0;
+	if (op == UEVENT_REFRESH)
+		return namespace_refresh(ndns) < 0 ? -ENXIO : 1;
+	ndns->generation = region->generation - 1;
+	list_del_from(&region->namespaces, &ndns->list);
+	list_add_tail(&region->stale_namespaces, &ndns->list);
+	return 1;
+}
+
+static int uevent_btt(struct ndctl_region *region, int id, const char *path,
+		enum uevent_op op)
+{
+	struct ndctl_btt *btt;
+
+	if (!region->btts_init)
+		return 0;
+
+	ndctl_btt_foreach(region, btt)
+		if (btt->id == id)
+			break;
+
+	if (!btt) {
+		if (op == UEVENT_REMOVE)
+			return 0;
+		return add_btt(region, id, path) ? 1 : -ENOMEM;
+	}
+
+	if (op == UEVENT_ADD)
+		return 0;
+	if (op == UEVENT_REFRESH)
+		return btt_refresh(btt) < 0 ? -ENXIO : 1;
+	btt->generation = region->generation - 1;
+	list_del_from(&region->btts, &btt->list);
+	list_add_tail(&region->stale_btts, &btt->list);
+	return 1;
+}
+
+static int uevent_pfn(struct ndctl_region *region, int id, const char *path,
+		enum uevent_op op)
+{
+	struct ndctl_pfn *pfn;
+
+	if (!region->pfns_init)
+		return 0;
+
+	ndctl_pfn_foreach(region, pfn)
+		if (pfn->id == id)
+			break;
+
+	if (!pfn) {
+		if (op == UEVENT_REMOVE)
+			return 0;
+		return add_pfn(region, id, path) ? 1 : -ENOMEM;
+	}
+
+	if (op == UEVENT_ADD)
+		return 0;
+	if (op == UEVENT_REFRESH)
+		return pfn_refresh(pfn) < 0 ? -ENXIO : 1;
+	pfn->generation = region->generation - 1;
+	list_del_from(&region->pfns, &pfn->list);
+	list_add_tail(&region->stale_pfns, &pfn->list);
+	return 1;
+}
+
+static int uevent_dax(struct ndctl_region *region, int id, const char *path,
+		enum uevent_op op)
+{
+	struct ndctl_dax *dax;
+
+	if (!region->daxs_init)
+		return 0;
+
+	ndctl_dax_foreach(region, dax)
+		if (dax->pfn.id == id)
+			break;
+
+	if (!dax) {
+		if (op == UEVENT_REMOVE)
+			return 0;
+		return add_dax(region, id, path) ? 1 : -ENOMEM;
+	}
+
+	if (op == UEVENT_ADD)
+		return 0;
+	if (op == UEVENT_REFRESH)
+		return pfn_refresh(&dax->pfn) < 0 ? -ENXIO : 1;
+	dax->pfn.generation = region->generation - 1;
+	list_del_from(&region->daxs, &dax->pfn.list);
+	list_add_tail(&region->stale_daxs, &dax->pfn.list);
+	return 1;
+}
+
+static int ctx_apply_uevent(struct ndctl_ctx *ctx, struct udev_device *dev)
+{
+	const char *action = udev_device_get_action(dev);
+	const char *name = udev_device_get_sysname(dev);
+	const char *path = udev_device_get_syspath(dev);
+	struct ndctl_region *region;
+	int id, region_id, rc = 0;
+	enum uevent_op op;
+
+	if (!action || !name || !path)
+		return 0;
+
+	/*
+	 * Enabled state is read from sysfs on demand, but a (re)bind of a
+	 * namespace personality device may follow a reconfiguration of the
+	 * attributes cached at add time, so those are re-read in place.
+	 */
+	if (strcmp(action, "add") == 0)
+		op = UEVENT_ADD;
+	else if (strcmp(action, "remove") == 0)
+		op = UEVENT_REMOVE;
+	else if (strcmp(action, "bind") == 0 || strcmp(action, "change") == 0)
+		op = UEVENT_REFRESH;
+	else
+		return 0;
+
+	if (sscanf(name, "ndctl%d", &id) == 1) {
+		if (op != UEVENT_REFRESH)
+			rc = uevent_bus(ctx, id, path, op);
+	} else if (sscanf(name, "nmem%d", &id) == 1) {
+		if (op != UEVENT_REFRESH)
+			rc = uevent_dimm(ctx, id, path, op);
+	} else if (sscanf(name, "region%d", &id) == 1) {
+		if (op != UEVENT_REFRESH)
+			rc = uevent_region(ctx, id, path, op);
+	} else if (sscanf(name, "namespace%d.%d", &region_id, &id) == 2) {
+		region = uevent_to_region(ctx, region_id);
+		if (region)
+			rc = uevent_namespace(region, id, path, op);
+	} else if (sscanf(name, "btt%d.%d", &region_id, &id) == 2) {
+		region = uevent_to_region(ctx, region_id);
+		if (region)
+			rc = uevent_btt(region, id, path, op);
+	} else if (sscanf(name, "pfn%d.%d", &region_id, &id) == 2) {
+		region = uevent_to_region(ctx, region_id);
+		if (region)
+			rc = uevent_pfn(region, id, path, op);
+	} else if (sscanf(name, "dax%d.%d", &region_id, &id) == 2) {
+		region = uevent_to_region(ctx, region_id);
+		if (region)
+			rc = uevent_dax(region, id, path, op);
+	}
+
+	dbg(ctx, "%s: %s %s\n", name, action, rc > 0 ? "applied" : "ignored");
+	return rc;
+}
+
+/**
+ * ndctl_enable_udev_monitor - keep the ctx object graph current
+ * @ctx: ndctl library context
+ *
+ * Subscribe to udev events for the "nd" subsystem. Once enabled, each
+ * ndctl_process_udev_events() call applies device additions and removals
+ * to the already enumerated busses, dimms, regions, and region children
+ * rather than requiring a new ctx, or ndctl_invalidate(), to see them.
+ * Objects removed from the graph remain allocated until
+ * ndctl_region_cleanup() (for namespace, btt, pfn, and dax objects) or
+ * until the ctx is released. Poll the descriptor returned by
+ * ndctl_get_udev_monitor_fd() to learn when events are pending.
+ */
+NDCTL_EXPORT int ndctl_enable_udev_monitor(struct ndctl_ctx *ctx)
+{
+	struct udev_monitor *mon;
+	int rc;
+
+	if (ctx->udev_monitor)
+		return 0;
+	if (!ctx->udev)
+		return -ENXIO;
+
+	mon = udev_monitor_new_from_netlink(ctx->udev, "udev");
+	if (!mon)
+		return -ENOMEM;
+
+	rc = udev_monitor_filter_add_match_subsystem_devtype(mon, "nd", NULL);
+	if (rc == 0)
+		rc = udev_monitor_enable_receiving(mon);
+	if (rc < 0) {
+		err(ctx, "failed to enable udev monitor: %s\n", strerror(-rc));
+		udev_monitor_unref(mon);
+		return rc;
+	}
+
+	ctx->udev_monitor = mon;
+	return 0;
+}
+
+/**
+ * ndctl_get_udev_monitor_fd - descriptor that polls readable on events
+ * @ctx: ndctl library context
+ *
+ * Returns -ENXIO if ndctl_enable_udev_monitor() has not been called.
+ */
+NDCTL_EXPORT int ndctl_get_udev_monitor_fd(struct ndctl_ctx *ctx)
+{
+	if (!ctx->udev_monitor)
+		return -ENXIO;
+	return udev_monitor_get_fd(ctx->udev_monitor);
+}
+
+/**
+ * ndctl_process_udev_events - apply pending udev events to the ctx
+ * @ctx: ndctl library context
+ *
+ * Does not block. Returns the number of events received, which may
+ * include events (e.g. driver bind / unbind) that changed device state
+ * without changing the object graph, or -ENXIO if the monitor is not
+ * enabled. A device that fails to parse is logged and skipped, as it
+ * would be by the initial enumeration.
+ */
+NDCTL_EXPORT int ndctl_process_udev_events(struct ndctl_ctx *ctx)
+{
+	struct udev_device *dev;
+	struct ndctl_bus *bus;
+	int count = 0;
+
+	if (!ctx->udev_monitor)
+		return -ENXIO;
+
+	pthread_rwlock_wrlock(&ctx->topology_lock);
+	pthread_mutex_lock(&ctx->lock);
+	while ((dev = udev_monitor_receive_device(ctx->udev_monitor))) {
+		if (ctx_apply_uevent(ctx, dev) < 0)
+			err(ctx, "%s: failed to apply %s event\n",
+					udev_device_get_sysname(dev),
+					udev_device_get_action(dev));
+		udev_device_unref(dev);
+		count++;
+	}
+	/* devices may be probing on behalf of another process */
+	if (count && ctx->busses_init)
+		list_for_each(&ctx->busses, bus, list)
+			bus_probe_changed(bus);
+	pthread_mutex_unlock(&ctx->lock);
+	pthread_rwlock_unlock(&ctx->topology_lock);
+
+	return count;
+}
+
 NDCTL_EXPORT bool ndctl_namespace_is_active(struct ndctl_namespace *ndns)
 {
 	struct ndctl_btt *btt = ndctl_namespace_get_btt(ndns);
@@ -3844,7 +4998,8 @@ NDCTL_EXPORT int ndctl_namespace_enable(struct ndctl_namespace *ndns)
 	if (ndctl_namespace_is_enabled(ndns))
 		return 0;
 
-	rc = ndctl_bind(ctx, ndns->module, devname);
+	rc = ndctl_bind(ndctl_namespace_get_bus(ndns), ndns->module,
+			devname);
 
 	/*
 	 * Rescan now as successfully enabling a namespace device leads
@@ -3892,7 +5047,7 @@ NDCTL_EXPORT int ndctl_namespace_disable(struct ndctl_namespace *ndns)
 	if (!ndctl_namespace_is_enabled(ndns))
 		return 0;
 
-	ndctl_unbind(ctx, ndns->ndns_path);
+	ndctl_unbind(ndctl_namespace_get_bus(ndns), ndns->ndns_path);
 
 	if (ndctl_namespace_is_enabled(ndns)) {
 		err(ctx, "%s: failed to disable\n", devname);
@@ -4610,7 +5765,7 @@ NDCTL_EXPORT const char *ndctl_btt_get_block_device(struct ndctl_btt *btt)
 		return "";
 	}
 
-	ndctl_bus_wait_probe(bus);
+	bus_wait_probe(bus);
 	btt->bdev = get_block_device(ctx, path);
 	return btt->bdev ? btt->bdev : "";
 }
@@ -4653,7 +5808,7 @@ NDCTL_EXPORT int ndctl_btt_enable(struct ndctl_btt *btt)
 	if (ndctl_btt_is_enabled(btt))
 		return 0;
 
-	ndctl_bind(ctx, btt->module, devname);
+	ndctl_bind(ndctl_btt_get_bus(btt), btt->module, devname);
 
 	if (!ndctl_btt_is_enabled(btt)) {
 		err(ctx, "%s: failed to enable\n", devname);
@@ -4690,7 +5845,7 @@ NDCTL_EXPORT int ndctl_btt_delete(struct ndctl_btt *btt)
 		return 0;
 	}
 
-	ndctl_unbind(ctx, btt->btt_path);
+	ndctl_unbind(ndctl_btt_get_bus(btt), btt->btt_path);
 
 	rc = ndctl_btt_set_namespace(btt, NULL);
 	if (rc) {
@@ -5068,7 +6223,7 @@ NDCTL_EXPORT const char *ndctl_pfn_get_block_device(struct ndctl_pfn *pfn)
 		return "";
 	}
 
-	ndctl_bus_wait_probe(bus);
+	bus_wait_probe(bus);
 	pfn->bdev = get_block_device(ctx, path);
 	return pfn->bdev ? pfn->bdev : "";
 }
@@ -5111,7 +6266,7 @@ NDCTL_EXPORT int ndctl_pfn_enable(struct ndctl_pfn *pfn)
 	if (ndctl_pfn_is_enabled(pfn))
 		return 0;
 
-	ndctl_bind(ctx, pfn->module, devname);
+	ndctl_bind(ndctl_pfn_get_bus(pfn), pfn->module, devname);
 
 	if (!ndctl_pfn_is_enabled(pfn)) {
 		err(ctx, "%s: failed to enable\n", devname);
@@ -5148,7 +6303,7 @@ NDCTL_EXPORT int ndctl_pfn_delete(struct ndctl_pfn *pfn)
 		return 0;
 	}
 
-	ndctl_unbind(ctx, pfn->pfn_path);
+	ndctl_unbind(ndctl_pfn_get_bus(pfn), pfn->pfn_path);
 
 	rc = ndctl_pfn_set_namespace(pfn, NULL);
 	if (rc) {
@@ -5293,7 +6448,7 @@ NDCTL_EXPORT int ndctl_dax_enable(struct ndctl_dax *dax)
 	if (ndctl_dax_is_enabled(dax))
 		return 0;
 
-	ndctl_bind(ctx, pfn->module, devname);
+	ndctl_bind(ndctl_pfn_get_bus(pfn), pfn->module, devname);
 
 	if (!ndctl_dax_is_enabled(dax)) {
 		err(ctx, "%s: failed to enable\n", devname);
@@ -5324,7 +6479,7 @@ NDCTL_EXPORT int ndctl_dax_delete(struct ndctl_dax *dax)
 		return 0;
 	}
 
-	ndctl_unbind(ctx, pfn->pfn_path);
+	ndctl_unbind(ndctl_pfn_get_bus(pfn), pfn->pfn_path);
 
 	rc = ndctl_dax_set_namespace(dax, NULL);
 	if (rc) {
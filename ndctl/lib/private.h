@@ -17,6 +17,7 @@
 #include <stdbool.h>
 #include <syslog.h>
 #include <string.h>
+#include <pthread.h>
 #include <libudev.h>
 #include <libkmod.h>
 #include <util/log.h>
@@ -118,6 +119,34 @@ static inline enum dsm_support test_dimm_dsm(struct ndctl_dimm *dimm, int fn)
 }
 
 void region_flag_refresh(struct ndctl_region *region);
+void bus_probe_changed(struct ndctl_bus *bus);
+int bus_wait_probe(struct ndctl_bus *bus);
+
+/**
+ * struct bind_hint - how the last device of a given type was bound
+ * @devtype: device name prefix, e.g. "namespace" for namespace0.0
+ * @modname: name of the device's module, NULL if it has none
+ * @driver: the driver that accepted the device, NULL until one does
+ * @loaded: @modname was inserted, or found to be loaded, already
+ */
+struct bind_hint {
+	char *devtype;
+	char *modname;
+	char *driver;
+	bool loaded;
+	struct list_node list;
+};
+
+/**
+ * struct module_alias - memoized modalias lookup, see to_module()
+ * @alias: device modalias, e.g. "nd:t4"
+ * @module: referenced result, NULL if the lookup found no module
+ */
+struct module_alias {
+	char *alias;
+	struct kmod_module *module;
+	struct list_node list;
+};
 
 /**
  * struct ndctl_ctx - library user context to find "nd" instances
@@ -134,13 +163,24 @@ struct ndctl_ctx {
 	int regions_init;
 	void *userdata;
 	struct list_head busses;
+	struct list_head stale_busses;
 	int busses_init;
 	struct udev *udev;
 	struct udev_queue *udev_queue;
+	struct udev_monitor *udev_monitor;
 	struct kmod_ctx *kmod_ctx;
 	struct daxctl_ctx *daxctl_ctx;
 	unsigned long timeout;
 	void *private_data;
+	struct list_head bind_hints;
+	struct list_head module_aliases;
+	/*
+	 * lazy list population, bind hints, module aliases, and the kmod
+	 * and udev handles
+	 */
+	pthread_mutex_t lock;
+	/* held for write while udev events or invalidation edit the lists */
+	pthread_rwlock_t topology_lock;
 };
 
 /**
@@ -161,6 +201,8 @@ struct ndctl_bus {
 	char *provider;
 	struct list_head dimms;
 	struct list_head regions;
+	struct list_head stale_dimms;
+	struct list_head stale_regions;
 	struct list_node list;
 	int dimms_init;
 	int regions_init;
@@ -170,6 +212,9 @@ struct ndctl_bus {
 	size_t buf_len;
 	char *wait_probe_path;
 	char *scrub_path;
+	/* bumped by binds / unbinds, see bus_wait_probe() */
+	unsigned long probe_gen;
+	unsigned long probe_flushed;
 	unsigned long cmd_mask;
 	unsigned long nfit_dsm_mask;
 };
@@ -94,6 +94,51 @@ void *ndctl_get_private_data(struct ndctl_ctx *ctx);
 struct daxctl_ctx;
 struct daxctl_ctx *ndctl_get_daxctl_ctx(struct ndctl_ctx *ctx);
 void ndctl_invalidate(struct ndctl_ctx *ctx);
+int ndctl_enable_udev_monitor(struct ndctl_ctx *ctx);
+int ndctl_get_udev_monitor_fd(struct ndctl_ctx *ctx);
+int ndctl_process_udev_events(struct ndctl_ctx *ctx);
+void ndctl_topology_read_lock(struct ndctl_ctx *ctx);
+void ndctl_topology_read_unlock(struct ndctl_ctx *ctx);
+
+/*
+ * struct ndctl_event_record - a dimm event as published by 'ndctl monitor'
+ * @seq: 1-based publish sequence number
+ * @timestamp: CLOCK_REALTIME nanoseconds
+ * @event_flags: ND_EVENT_* that triggered the record, 0 for a sample
+ * @smart_flags: ND_SMART_*_VALID flags for the health snapshot fields,
+ *		 which are encoded as returned by ndctl_cmd_smart_get_*()
+ */
+struct ndctl_event_record {
+	uint64_t seq;
+	uint64_t timestamp;
+	uint32_t bus_id;
+	uint32_t dimm_id;
+	uint32_t handle;
+	uint32_t event_flags;
+	uint32_t smart_flags;
+	uint32_t health;
+	uint32_t temperature;
+	uint32_t ctrl_temperature;
+	uint32_t spares;
+	uint32_t alarm_flags;
+	uint32_t life_used;
+	uint32_t shutdown_state;
+	uint32_t shutdown_count;
+	uint32_t reserved;
+};
+
+struct ndctl_event_ring;
+struct ndctl_event_ring *ndctl_event_ring_new(struct ndctl_ctx *ctx,
+		const char *path, unsigned int nr_records);
+struct ndctl_event_ring *ndctl_event_ring_open(struct ndctl_ctx *ctx,
+		const char *path);
+void ndctl_event_ring_close(struct ndctl_event_ring *ring);
+int ndctl_event_ring_post(struct ndctl_event_ring *ring,
+		struct ndctl_event_record *rec);
+int ndctl_event_ring_read(struct ndctl_event_ring *ring,
+		struct ndctl_event_record *rec);
+int ndctl_event_ring_wait(struct ndctl_event_ring *ring, int timeout_ms);
+unsigned long long ndctl_event_ring_get_lost(struct ndctl_event_ring *ring);
 void ndctl_set_log_fn(struct ndctl_ctx *ctx,
                   void (*log_fn)(struct ndctl_ctx *ctx,
                                  int priority, const char *file, int line, const char *fn,
@@ -133,6 +178,9 @@ enum ndctl_persistence_domain ndctl_bus_get_persistence_domain(
 		struct ndctl_bus *bus);
 int ndctl_bus_wait_probe(struct ndctl_bus *bus);
 int ndctl_bus_wait_for_scrub_completion(struct ndctl_bus *bus);
+int ndctl_bus_wait_for_scrubs(struct ndctl_bus **buses, int count,
+		void (*done)(struct ndctl_bus *bus, int rc, void *data),
+		void *data);
 unsigned int ndctl_bus_get_scrub_count(struct ndctl_bus *bus);
 int ndctl_bus_get_scrub_state(struct ndctl_bus *bus);
 int ndctl_bus_start_scrub(struct ndctl_bus *bus);
@@ -222,6 +270,11 @@ unsigned long long ndctl_cmd_clear_error_get_cleared(
 		struct ndctl_cmd *clear_err);
 unsigned int ndctl_cmd_ars_cap_get_clear_unit(struct ndctl_cmd *ars_cap);
 int ndctl_cmd_ars_stat_get_flag_overflow(struct ndctl_cmd *ars_stat);
+int ndctl_bus_scrub_ranges(struct ndctl_bus *bus,
+		const struct ndctl_range *ranges, int count,
+		void (*record)(struct ndctl_bus *bus, unsigned long long address,
+			unsigned long long length, void *data),
+		void *data);
 
 /*
  * Note: ndctl_cmd_smart_get_temperature is an alias for
@@ -355,6 +408,12 @@ unsigned long long ndctl_region_get_size(struct ndctl_region *region);
 unsigned long long ndctl_region_get_available_size(struct ndctl_region *region);
 unsigned long long ndctl_region_get_max_available_extent(
 		struct ndctl_region *region);
+int ndctl_region_plan_namespaces(struct ndctl_region *region,
+		unsigned int count, unsigned long long align,
+		unsigned long long *size);
+int ndctl_region_get_num_free_extents(struct ndctl_region *region);
+int ndctl_region_get_free_extent(struct ndctl_region *region, int i,
+		unsigned long long *start, unsigned long long *size);
 unsigned int ndctl_region_get_range_index(struct ndctl_region *region);
 unsigned int ndctl_region_get_type(struct ndctl_region *region);
 struct ndctl_namespace *ndctl_region_get_namespace_seed(
@@ -15,15 +15,21 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <limits.h>
+#include <string.h>
+#include <time.h>
+#include <sys/epoll.h>
 
 #include <util/json.h>
 #include <util/filter.h>
+#include <util/record.h>
 #include <json-c/json.h>
 #include <ndctl/libndctl.h>
 #include <util/parse-options.h>
+#include <ccan/list/list.h>
 #include <ccan/array_size/array_size.h>
 
 #include <ndctl.h>
+#include <builtin.h>
 
 static struct {
 	bool buses;
@@ -36,7 +42,9 @@ static struct {
 	bool media_errors;
 	bool human;
 	bool firmware;
+	bool watch;
 	int verbose;
+	const char *format;
 } list;
 
 static unsigned long listopts_to_flags(void)
@@ -60,6 +68,17 @@ struct util_filter_params param;
 
 static int did_fail;
 
+/* set once list runs more than once per process, see builtin_list_reset() */
+static bool list_reused;
+
+void builtin_list_reset(void)
+{
+	memset(&list, 0, sizeof(list));
+	memset(&param, 0, sizeof(param));
+	did_fail = 0;
+	list_reused = true;
+}
+
 #define fail(fmt, ...) \
 do { \
 	did_fail = 1; \
@@ -212,42 +231,101 @@ static struct json_object *region_to_json(struct ndctl_region *region,
 	return NULL;
 }
 
+/*
+ * Output state for the util_filter_walk() performed by cmd_list(). Objects
+ * are streamed as they are visited, the flags track which containers of
+ * the bus -> {dimms, regions -> region -> namespaces} hierarchy are open.
+ */
+struct list_stream {
+	struct util_json_stream js;
+	struct util_record rec;
+	bool platform;
+	bool jbuses;
+	bool jbus;
+	bool jdimms;
+	bool jregions;
+	bool jregion;
+	bool jnamespaces;
+	int num_dimms;
+	int num_regions;
+	int num_namespaces;
+	unsigned long flags;
+};
+
+enum list_level {
+	LIST_NAMESPACES,
+	LIST_REGION,
+	LIST_REGIONS,
+	LIST_DIMMS,
+	LIST_BUS,
+};
+
+/* close open containers from the innermost up to @level */
+static void list_close(struct list_stream *ls, enum list_level level)
+{
+	if (ls->jnamespaces && level >= LIST_NAMESPACES) {
+		util_json_stream_end(&ls->js);
+		ls->jnamespaces = false;
+	}
+	if (ls->jregion && level >= LIST_REGION) {
+		util_json_stream_end(&ls->js);
+		ls->jregion = false;
+	}
+	if (ls->jregions && level >= LIST_REGIONS) {
+		util_json_stream_end(&ls->js);
+		ls->jregions = false;
+	}
+	if (ls->jdimms && level >= LIST_DIMMS) {
+		util_json_stream_end(&ls->js);
+		ls->jdimms = false;
+	}
+	if (ls->jbus && level >= LIST_BUS) {
+		util_json_stream_end(&ls->js);
+		ls->jbus = false;
+	}
+}
+
+/*
+ * Without a parent bus, region, or platform object the array is the
+ * top-level list.
+ */
+static void list_section_begin(struct list_stream *ls, const char *key)
+{
+	if (ls->jbus || ls->jregion || ls->platform)
+		util_json_stream_array_begin(&ls->js, key);
+	else
+		util_json_stream_list_begin(&ls->js);
+}
+
 static void filter_namespace(struct ndctl_namespace *ndns,
 		struct util_filter_ctx *ctx)
 {
+	struct list_stream *ls = ctx->arg;
 	struct json_object *jndns;
-	struct list_filter_arg *lfa = ctx->list;
-	struct json_object *container = lfa->jregion ? lfa->jregion : lfa->jbus;
 
 	if (!list.idle && !ndctl_namespace_is_active(ndns))
 		return;
 
-	if (!lfa->jnamespaces) {
-		lfa->jnamespaces = json_object_new_array();
-		if (!lfa->jnamespaces) {
-			fail("\n");
-			return;
-		}
-
-		if (container)
-			json_object_object_add(container, "namespaces",
-					lfa->jnamespaces);
-	}
-
-	jndns = util_namespace_to_json(ndns, lfa->flags);
+	jndns = util_namespace_to_json(ndns, ls->flags);
 	if (!jndns) {
 		fail("\n");
 		return;
 	}
 
-	json_object_array_add(lfa->jnamespaces, jndns);
+	if (!ls->jnamespaces) {
+		if (!ls->jregion)
+			list_close(ls, LIST_DIMMS);
+		list_section_begin(ls, "namespaces");
+		ls->jnamespaces = true;
+	}
+
+	util_json_stream_add(&ls->js, NULL, jndns);
 }
 
 static bool filter_region(struct ndctl_region *region,
 		struct util_filter_ctx *ctx)
 {
-	struct list_filter_arg *lfa = ctx->list;
-	struct json_object *jbus = lfa->jbus;
+	struct list_stream *ls = ctx->arg;
 	struct json_object *jregion;
 
 	if (!list.regions)
@@ -256,64 +334,35 @@ static bool filter_region(struct ndctl_region *region,
 	if (!list.idle && !ndctl_region_is_enabled(region))
 		return true;
 
-	if (!lfa->jregions) {
-		lfa->jregions = json_object_new_array();
-		if (!lfa->jregions) {
-			fail("\n");
-			return false;
-		}
-
-		if (jbus)
-			json_object_object_add(jbus, "regions",
-					lfa->jregions);
-	}
-
-	jregion = region_to_json(region, lfa->flags);
+	jregion = region_to_json(region, ls->flags);
 	if (!jregion) {
 		fail("\n");
 		return false;
 	}
-	lfa->jregion = jregion;
 
 	/*
-	 * We've started a new region, any previous jnamespaces will
-	 * have been parented to the last region. Clear out jnamespaces
-	 * so we start a new array per region.
+	 * We've started a new region, close out the previous region and
+	 * its namespaces so we start a new namespace array per region.
 	 */
-	lfa->jnamespaces = NULL;
+	list_close(ls, LIST_REGION);
+	if (!ls->jregions) {
+		list_close(ls, LIST_DIMMS);
+		list_section_begin(ls, "regions");
+		ls->jregions = true;
+	}
 
-	/*
-	 * Without a bus we are collecting regions anonymously across
-	 * the platform.
-	 */
-	json_object_array_add(lfa->jregions, jregion);
+	util_json_stream_object_begin(&ls->js, NULL, jregion);
+	ls->jregion = true;
 	return true;
 }
 
-static void filter_dimm(struct ndctl_dimm *dimm, struct util_filter_ctx *ctx)
+static struct json_object *dimm_to_json(struct ndctl_dimm *dimm,
+		unsigned long flags)
 {
-	struct list_filter_arg *lfa = ctx->list;
-	struct json_object *jdimm;
-
-	if (!list.idle && !ndctl_dimm_is_enabled(dimm))
-		return;
-
-	if (!lfa->jdimms) {
-		lfa->jdimms = json_object_new_array();
-		if (!lfa->jdimms) {
-			fail("\n");
-			return;
-		}
-
-		if (lfa->jbus)
-			json_object_object_add(lfa->jbus, "dimms", lfa->jdimms);
-	}
+	struct json_object *jdimm = util_dimm_to_json(dimm, flags);
 
-	jdimm = util_dimm_to_json(dimm, lfa->flags);
-	if (!jdimm) {
-		fail("\n");
-		return;
-	}
+	if (!jdimm)
+		return NULL;
 
 	if (list.health) {
 		struct json_object *jhealth;
@@ -327,98 +376,712 @@ static void filter_dimm(struct ndctl_dimm *dimm, struct util_filter_ctx *ctx)
 			 * that otherwise supports smart data retrieval
 			 * commands.
 			 */
-			fail("\n");
-			return;
+			json_object_put(jdimm);
+			return NULL;
 		}
 	}
 
 	if (list.firmware) {
 		struct json_object *jfirmware;
 
-		jfirmware = util_dimm_firmware_to_json(dimm, lfa->flags);
+		jfirmware = util_dimm_firmware_to_json(dimm, flags);
 		if (jfirmware)
 			json_object_object_add(jdimm, "firmware", jfirmware);
 	}
 
+	return jdimm;
+}
+
+static void filter_dimm(struct ndctl_dimm *dimm, struct util_filter_ctx *ctx)
+{
+	struct list_stream *ls = ctx->arg;
+	struct json_object *jdimm;
+
+	if (!list.idle && !ndctl_dimm_is_enabled(dimm))
+		return;
+
+	jdimm = dimm_to_json(dimm, ls->flags);
+	if (!jdimm) {
+		fail("\n");
+		return;
+	}
+
 	/*
 	 * Without a bus we are collecting dimms anonymously across the
 	 * platform.
 	 */
-	json_object_array_add(lfa->jdimms, jdimm);
+	if (!ls->jdimms) {
+		list_section_begin(ls, "dimms");
+		ls->jdimms = true;
+	}
+
+	util_json_stream_add(&ls->js, NULL, jdimm);
 }
 
 static bool filter_bus(struct ndctl_bus *bus, struct util_filter_ctx *ctx)
 {
-	struct list_filter_arg *lfa = ctx->list;
+	struct list_stream *ls = ctx->arg;
+	struct json_object *jbus;
+
+	if (!list.buses)
+		return true;
+
+	jbus = util_bus_to_json(bus);
+	if (!jbus) {
+		fail("\n");
+		return false;
+	}
 
 	/*
 	 * These sub-objects are local to a bus and, if present, have
-	 * been added as a child of a parent object on the last
-	 * iteration.
+	 * been emitted as children of the previous bus.
 	 */
-	if (lfa->jbuses) {
-		lfa->jdimms = NULL;
-		lfa->jregion = NULL;
-		lfa->jregions = NULL;
-		lfa->jnamespaces = NULL;
+	list_close(ls, LIST_BUS);
+	if (!ls->jbuses) {
+		util_json_stream_list_begin(&ls->js);
+		ls->jbuses = true;
 	}
 
+	util_json_stream_object_begin(&ls->js, NULL, jbus);
+	ls->jbus = true;
+	return true;
+}
+
+/*
+ * Flat record output, see util/record.h. Each object is written as a
+ * record as it is visited, no json_object is built.
+ */
+static void region_to_record(struct ndctl_region *region,
+		struct util_record *rec, unsigned long flags)
+{
+	struct ndctl_bus *bus = ndctl_region_get_bus(region);
+	struct ndctl_interleave_set *iset;
+	unsigned long long extent;
+	unsigned int bb_count = 0;
+	const char *pd;
+	int numa;
+
+	util_record_str(rec, UTIL_FIELD_DEV, ndctl_region_get_devname(region));
+	util_record_str(rec, UTIL_FIELD_BUS, ndctl_bus_get_devname(bus));
+	util_record_u64(rec, UTIL_FIELD_SIZE, ndctl_region_get_size(region));
+	util_record_u64(rec, UTIL_FIELD_AVAILABLE_SIZE,
+			ndctl_region_get_available_size(region));
+
+	extent = ndctl_region_get_max_available_extent(region);
+	if (extent != ULLONG_MAX)
+		util_record_u64(rec, UTIL_FIELD_MAX_AVAILABLE_EXTENT, extent);
+
+	switch (ndctl_region_get_type(region)) {
+	case ND_DEVICE_REGION_PMEM:
+		util_record_str(rec, UTIL_FIELD_TYPE, "pmem");
+		break;
+	case ND_DEVICE_REGION_BLK:
+		util_record_str(rec, UTIL_FIELD_TYPE, "blk");
+		break;
+	}
+
+	numa = ndctl_region_get_numa_node(region);
+	if (numa >= 0 && flags & UTIL_JSON_VERBOSE)
+		util_record_s64(rec, UTIL_FIELD_NUMA_NODE, numa);
+
+	iset = ndctl_region_get_interleave_set(region);
+	if (iset)
+		util_record_u64(rec, UTIL_FIELD_ISET_ID,
+				ndctl_interleave_set_get_cookie(iset));
+
+	if (!ndctl_region_is_enabled(region))
+		util_record_str(rec, UTIL_FIELD_STATE, "disabled");
+
+	util_region_badblocks_to_json(region, &bb_count, 0);
+	if (bb_count)
+		util_record_u64(rec, UTIL_FIELD_BADBLOCK_COUNT, bb_count);
+
+	switch (ndctl_region_get_persistence_domain(region)) {
+	case PERSISTENCE_CPU_CACHE:
+		pd = "cpu_cache";
+		break;
+	case PERSISTENCE_MEM_CTRL:
+		pd = "memory_controller";
+		break;
+	case PERSISTENCE_NONE:
+		pd = "none";
+		break;
+	default:
+		pd = "unknown";
+		break;
+	}
+	util_record_str(rec, UTIL_FIELD_PERSISTENCE_DOMAIN, pd);
+}
+
+static void record_end(struct util_record *rec)
+{
+	if (util_record_end(rec))
+		fail("\n");
+}
+
+static void record_namespace(struct ndctl_namespace *ndns,
+		struct util_filter_ctx *ctx)
+{
+	struct list_stream *ls = ctx->arg;
+
+	if (!list.idle && !ndctl_namespace_is_active(ndns))
+		return;
+
+	util_record_begin(&ls->rec, UTIL_RECORD_NAMESPACE);
+	if (util_namespace_to_record(ndns, &ls->rec, ls->flags) < 0) {
+		fail("\n");
+		return;
+	}
+	record_end(&ls->rec);
+}
+
+static bool record_region(struct ndctl_region *region,
+		struct util_filter_ctx *ctx)
+{
+	struct list_stream *ls = ctx->arg;
+	struct ndctl_mapping *mapping;
+
+	if (!list.regions)
+		return true;
+
+	if (!list.idle && !ndctl_region_is_enabled(region))
+		return true;
+
+	util_record_begin(&ls->rec, UTIL_RECORD_REGION);
+	region_to_record(region, &ls->rec, ls->flags);
+	record_end(&ls->rec);
+
+	ndctl_mapping_foreach(region, mapping) {
+		struct ndctl_dimm *dimm = ndctl_mapping_get_dimm(mapping);
+
+		if (!list.dimms)
+			break;
+
+		if (!util_dimm_filter(dimm, param.dimm))
+			continue;
+
+		if (!list.idle && !ndctl_dimm_is_enabled(dimm))
+			continue;
+
+		util_record_begin(&ls->rec, UTIL_RECORD_MAPPING);
+		util_mapping_to_record(mapping, &ls->rec);
+		record_end(&ls->rec);
+	}
+	return true;
+}
+
+static void record_dimm(struct ndctl_dimm *dimm, struct util_filter_ctx *ctx)
+{
+	struct list_stream *ls = ctx->arg;
+
+	if (!list.idle && !ndctl_dimm_is_enabled(dimm))
+		return;
+
+	util_record_begin(&ls->rec, UTIL_RECORD_DIMM);
+	util_dimm_to_record(dimm, &ls->rec);
+	if (list.health && util_dimm_health_to_record(dimm, &ls->rec) < 0
+			&& ndctl_dimm_is_cmd_supported(dimm, ND_CMD_SMART)) {
+		fail("\n");
+		return;
+	}
+	record_end(&ls->rec);
+}
+
+static bool record_bus(struct ndctl_bus *bus, struct util_filter_ctx *ctx)
+{
+	struct list_stream *ls = ctx->arg;
+
 	if (!list.buses)
 		return true;
 
-	if (!lfa->jbuses) {
-		lfa->jbuses = json_object_new_array();
-		if (!lfa->jbuses) {
-			fail("\n");
-			return false;
+	util_record_begin(&ls->rec, UTIL_RECORD_BUS);
+	util_bus_to_record(bus, &ls->rec);
+	record_end(&ls->rec);
+	return true;
+}
+
+static bool count_bus(struct ndctl_bus *bus, struct util_filter_ctx *ctx)
+{
+	return true;
+}
+
+static void count_dimm(struct ndctl_dimm *dimm, struct util_filter_ctx *ctx)
+{
+	struct list_stream *ls = ctx->arg;
+
+	if (list.idle || ndctl_dimm_is_enabled(dimm))
+		ls->num_dimms++;
+}
+
+static bool count_region(struct ndctl_region *region,
+		struct util_filter_ctx *ctx)
+{
+	struct list_stream *ls = ctx->arg;
+
+	if (!list.regions)
+		return true;
+
+	if (list.idle || ndctl_region_is_enabled(region)) {
+		ls->num_regions++;
+		/*
+		 * Namespaces listed underneath regions only count towards
+		 * the platform object when the last region has namespaces.
+		 */
+		ls->num_namespaces = 0;
+	}
+	return true;
+}
+
+static void count_namespace(struct ndctl_namespace *ndns,
+		struct util_filter_ctx *ctx)
+{
+	struct list_stream *ls = ctx->arg;
+
+	if (list.idle || ndctl_namespace_is_active(ndns))
+		ls->num_namespaces++;
+}
+
+static bool skip_region(struct ndctl_region *region,
+		struct util_filter_ctx *ctx)
+{
+	return true;
+}
+
+/*
+ * Without a bus, more than one populated object type is displayed as a
+ * platform object with a "dimms" array followed by a "regions" (or
+ * "namespaces") array. The walk visits a bus's dimms before its regions,
+ * so each array is emitted by its own walk, and a counting walk up front
+ * determines whether the platform object is needed.
+ */
+static int list_platform(struct ndctl_ctx *ctx, struct util_filter_ctx *fctx,
+		struct list_stream *ls)
+{
+	struct util_filter_ctx count = {
+		.filter_bus = count_bus,
+		.filter_dimm = fctx->filter_dimm ? count_dimm : NULL,
+		.filter_region = count_region,
+		.filter_namespace = fctx->filter_namespace
+			? count_namespace : NULL,
+		.arg = ls,
+	};
+	struct util_filter_ctx dimms = *fctx;
+	int rc;
+
+	rc = util_filter_walk(ctx, &count, &param);
+	if (rc)
+		return rc;
+
+	if ((!!ls->num_dimms + !!ls->num_regions + !!ls->num_namespaces) < 2)
+		return util_filter_walk(ctx, fctx, &param);
+
+	ls->platform = true;
+	util_json_stream_object_begin(&ls->js, NULL, NULL);
+
+	dimms.filter_region = skip_region;
+	dimms.filter_namespace = NULL;
+	rc = util_filter_walk(ctx, &dimms, &param);
+	if (rc)
+		return rc;
+	list_close(ls, LIST_DIMMS);
+
+	fctx->filter_dimm = NULL;
+	rc = util_filter_walk(ctx, fctx, &param);
+	if (rc)
+		return rc;
+	list_close(ls, LIST_BUS);
+
+	util_json_stream_end(&ls->js);
+	return 0;
+}
+
+/*
+ * --watch: after an initial snapshot, keep the ctx open and re-serialize
+ * objects when the kernel signals a change. Dimm health notifications
+ * only re-read the affected dimm, udev events are applied to the ctx by
+ * ndctl_process_udev_events() and then the topology is re-walked. Each
+ * object is compared field by field against the last json emitted for
+ * it, and only the differences are printed, one compact json object per
+ * line.
+ */
+struct watch_obj {
+	const char *type;
+	char *dev;
+	struct ndctl_dimm *dimm;
+	int health_eventfd;
+	struct json_object *jobj;
+	unsigned int generation;
+	struct list_node list;
+};
+
+struct list_watch {
+	struct list_head objs;
+	unsigned int generation;
+	int epollfd;
+	unsigned long flags;
+};
+
+static void watch_emit(const char *op, struct watch_obj *obj,
+		struct json_object *jfields, struct json_object *jremoved)
+{
+	struct json_object *jmsg, *jobj;
+	struct timespec ts;
+	char timestamp[32];
+
+	jmsg = json_object_new_object();
+	if (!jmsg) {
+		fail("\n");
+		return;
+	}
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	sprintf(timestamp, "%10ld.%09ld", ts.tv_sec, ts.tv_nsec);
+	jobj = json_object_new_string(timestamp);
+	if (jobj)
+		json_object_object_add(jmsg, "timestamp", jobj);
+	jobj = json_object_new_string(op);
+	if (jobj)
+		json_object_object_add(jmsg, "op", jobj);
+	jobj = json_object_new_string(obj->type);
+	if (jobj)
+		json_object_object_add(jmsg, "type", jobj);
+	jobj = json_object_new_string(obj->dev);
+	if (jobj)
+		json_object_object_add(jmsg, "dev", jobj);
+
+	if (jfields) {
+		json_object_object_foreach(jfields, key, val) {
+			if (strcmp(key, "dev") == 0)
+				continue;
+			json_object_object_add(jmsg, key, json_object_get(val));
 		}
 	}
+	if (jremoved)
+		json_object_object_add(jmsg, "removed", json_object_get(jremoved));
+
+	printf("%s\n", json_object_to_json_string_ext(jmsg,
+				JSON_C_TO_STRING_PLAIN));
+	fflush(stdout);
+	json_object_put(jmsg);
+}
+
+static bool json_field_equal(struct json_object *a, struct json_object *b)
+{
+	return strcmp(json_object_to_json_string_ext(a, JSON_C_TO_STRING_PLAIN),
+			json_object_to_json_string_ext(b,
+				JSON_C_TO_STRING_PLAIN)) == 0;
+}
+
+/* emit the fields of @jnew that differ from @obj, and take over @jnew */
+static void watch_diff(struct watch_obj *obj, struct json_object *jnew)
+{
+	struct json_object *jold = obj->jobj, *jfields, *jremoved = NULL;
+	struct json_object_iter iter;
+	struct json_object *jval;
+	int changed = 0;
 
-	lfa->jbus = util_bus_to_json(bus);
-	if (!lfa->jbus) {
+	jfields = json_object_new_object();
+	if (!jfields) {
 		fail("\n");
-		return false;
+		json_object_put(jnew);
+		return;
 	}
-	json_object_array_add(lfa->jbuses, lfa->jbus);
-	return true;
+
+	{
+		json_object_object_foreach(jnew, key, val) {
+			if (json_object_object_get_ex(jold, key, &jval)
+					&& json_field_equal(val, jval))
+				continue;
+			json_object_object_add(jfields, key,
+					json_object_get(val));
+			changed++;
+		}
+	}
+
+	json_object_object_foreachC(jold, iter) {
+		if (json_object_object_get_ex(jnew, iter.key, &jval))
+			continue;
+		if (!jremoved) {
+			jremoved = json_object_new_array();
+			if (!jremoved) {
+				fail("\n");
+				break;
+			}
+		}
+		json_object_array_add(jremoved,
+				json_object_new_string(iter.key));
+		changed++;
+	}
+
+	if (changed)
+		watch_emit("change", obj, jfields, jremoved);
+	json_object_put(jremoved);
+	json_object_put(jfields);
+	json_object_put(jold);
+	obj->jobj = jnew;
 }
 
-static int list_display(struct list_filter_arg *lfa)
+static void watch_arm_dimm(struct list_watch *lw, struct watch_obj *obj)
 {
-	struct json_object *jnamespaces = lfa->jnamespaces;
-	struct json_object *jregions = lfa->jregions;
-	struct json_object *jdimms = lfa->jdimms;
-	struct json_object *jbuses = lfa->jbuses;
+	struct epoll_event ev;
+	char buf;
+	int fd;
 
-	if (jbuses)
-		util_display_json_array(stdout, jbuses, lfa->flags);
-	else if ((!!jdimms + !!jregions + !!jnamespaces) > 1) {
-		struct json_object *jplatform = json_object_new_object();
+	fd = ndctl_dimm_get_health_eventfd(obj->dimm);
+	if (fd < 0)
+		return;
 
-		if (!jplatform) {
-			fail("\n");
-			return -ENOMEM;
+	/* consume the current state so the next notification is new */
+	if (pread(fd, &buf, sizeof(buf), 0) < 0) {
+		fail("%s: pread: %s\n", obj->dev, strerror(errno));
+		return;
+	}
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLPRI;
+	ev.data.ptr = obj;
+	if (epoll_ctl(lw->epollfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+		fail("%s: epoll_ctl: %s\n", obj->dev, strerror(errno));
+		return;
+	}
+	obj->health_eventfd = fd;
+}
+
+static struct watch_obj *watch_find(struct list_watch *lw, const char *type,
+		const char *dev)
+{
+	struct watch_obj *obj;
+
+	list_for_each(&lw->objs, obj, list)
+		if (strcmp(obj->dev, dev) == 0 && strcmp(obj->type, type) == 0)
+			return obj;
+	return NULL;
+}
+
+static void watch_update(struct list_watch *lw, const char *type,
+		const char *dev, struct ndctl_dimm *dimm,
+		struct json_object *jobj)
+{
+	struct watch_obj *obj;
+
+	if (!jobj) {
+		fail("\n");
+		return;
+	}
+
+	obj = watch_find(lw, type, dev);
+	if (obj) {
+		obj->generation = lw->generation;
+		/* a new object for the same dimm, follow its health events */
+		if (obj->dimm != dimm) {
+			if (obj->health_eventfd >= 0)
+				epoll_ctl(lw->epollfd, EPOLL_CTL_DEL,
+						obj->health_eventfd, NULL);
+			obj->health_eventfd = -1;
+			obj->dimm = dimm;
+			if (dimm)
+				watch_arm_dimm(lw, obj);
 		}
+		watch_diff(obj, jobj);
+		return;
+	}
 
-		if (jdimms)
-			json_object_object_add(jplatform, "dimms", jdimms);
-		if (jregions)
-			json_object_object_add(jplatform, "regions", jregions);
-		if (jnamespaces && !jregions)
-			json_object_object_add(jplatform, "namespaces",
-					jnamespaces);
-		printf("%s\n", json_object_to_json_string_ext(jplatform,
-					JSON_C_TO_STRING_PRETTY));
-		json_object_put(jplatform);
-	} else if (jdimms)
-		util_display_json_array(stdout, jdimms, lfa->flags);
-	else if (jregions)
-		util_display_json_array(stdout, jregions, lfa->flags);
-	else if (jnamespaces)
-		util_display_json_array(stdout, jnamespaces, lfa->flags);
+	obj = calloc(1, sizeof(*obj));
+	if (obj)
+		obj->dev = strdup(dev);
+	if (!obj || !obj->dev) {
+		free(obj);
+		fail("\n");
+		json_object_put(jobj);
+		return;
+	}
+	obj->type = type;
+	obj->dimm = dimm;
+	obj->health_eventfd = -1;
+	obj->jobj = jobj;
+	obj->generation = lw->generation;
+	list_add_tail(&lw->objs, &obj->list);
+
+	watch_emit("add", obj, jobj, NULL);
+	if (dimm)
+		watch_arm_dimm(lw, obj);
+}
+
+static void watch_free(struct list_watch *lw, struct watch_obj *obj)
+{
+	if (obj->health_eventfd >= 0)
+		epoll_ctl(lw->epollfd, EPOLL_CTL_DEL, obj->health_eventfd, NULL);
+	list_del(&obj->list);
+	json_object_put(obj->jobj);
+	free(obj->dev);
+	free(obj);
+}
+
+static void watch_namespace(struct ndctl_namespace *ndns,
+		struct util_filter_ctx *ctx)
+{
+	struct list_watch *lw = ctx->arg;
+
+	if (!list.idle && !ndctl_namespace_is_active(ndns))
+		return;
+
+	watch_update(lw, "namespace", ndctl_namespace_get_devname(ndns), NULL,
+			util_namespace_to_json(ndns, lw->flags));
+}
+
+static bool watch_region(struct ndctl_region *region,
+		struct util_filter_ctx *ctx)
+{
+	struct list_watch *lw = ctx->arg;
+
+	if (!list.regions)
+		return true;
+
+	if (!list.idle && !ndctl_region_is_enabled(region))
+		return true;
+
+	watch_update(lw, "region", ndctl_region_get_devname(region), NULL,
+			region_to_json(region, lw->flags));
+	return true;
+}
+
+static void watch_dimm(struct ndctl_dimm *dimm, struct util_filter_ctx *ctx)
+{
+	struct list_watch *lw = ctx->arg;
+
+	if (!list.idle && !ndctl_dimm_is_enabled(dimm))
+		return;
+
+	watch_update(lw, "dimm", ndctl_dimm_get_devname(dimm), dimm,
+			dimm_to_json(dimm, lw->flags));
+}
+
+static bool watch_bus(struct ndctl_bus *bus, struct util_filter_ctx *ctx)
+{
+	struct list_watch *lw = ctx->arg;
+
+	if (!list.buses)
+		return true;
+
+	watch_update(lw, "bus", ndctl_bus_get_devname(bus), NULL,
+			util_bus_to_json(bus));
+	return true;
+}
+
+static int watch_walk(struct ndctl_ctx *ctx, struct util_filter_ctx *fctx,
+		struct list_watch *lw)
+{
+	struct watch_obj *obj, *next;
+	int rc;
+
+	lw->generation++;
+	rc = util_filter_walk(ctx, fctx, &param);
+	if (rc)
+		return rc;
+
+	list_for_each_safe(&lw->objs, obj, next, list) {
+		if (obj->generation == lw->generation)
+			continue;
+		watch_emit("remove", obj, NULL, NULL);
+		watch_free(lw, obj);
+	}
 	return 0;
 }
 
+static int list_watch(struct ndctl_ctx *ctx, struct util_filter_ctx *fctx)
+{
+	struct list_watch lw = { 0 };
+	struct epoll_event ev, events[16];
+	struct watch_obj *obj, *next;
+	int i, nfds, rc;
+	char buf;
+
+	list_head_init(&lw.objs);
+	lw.flags = listopts_to_flags();
+	fctx->filter_bus = watch_bus;
+	fctx->filter_dimm = list.dimms ? watch_dimm : NULL;
+	fctx->filter_region = watch_region;
+	fctx->filter_namespace = list.namespaces ? watch_namespace : NULL;
+	fctx->arg = &lw;
+
+	lw.epollfd = epoll_create1(EPOLL_CLOEXEC);
+	if (lw.epollfd < 0) {
+		error("epoll_create1: %s\n", strerror(errno));
+		return -errno;
+	}
+
+	rc = ndctl_enable_udev_monitor(ctx);
+	if (rc < 0) {
+		error("failed to enable the udev monitor: %s\n", strerror(-rc));
+		goto out;
+	}
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = NULL;
+	if (epoll_ctl(lw.epollfd, EPOLL_CTL_ADD, ndctl_get_udev_monitor_fd(ctx),
+				&ev) != 0) {
+		error("epoll_ctl: %s\n", strerror(errno));
+		rc = -errno;
+		goto out;
+	}
+
+	/* subscribe before the snapshot so no change goes unnoticed */
+	rc = watch_walk(ctx, fctx, &lw);
+	if (rc)
+		goto out;
+
+	while (1) {
+		bool rescan = false;
+
+		nfds = epoll_wait(lw.epollfd, events, ARRAY_SIZE(events), -1);
+		if (nfds < 0) {
+			if (errno == EINTR)
+				continue;
+			error("epoll_wait: %s\n", strerror(errno));
+			rc = -errno;
+			goto out;
+		}
+
+		for (i = 0; i < nfds; i++) {
+			obj = events[i].data.ptr;
+			if (obj) {
+				watch_update(&lw, obj->type, obj->dev, obj->dimm,
+						dimm_to_json(obj->dimm, lw.flags));
+				if (pread(obj->health_eventfd, &buf,
+							sizeof(buf), 0) < 0) {
+					error("%s: pread: %s\n", obj->dev,
+							strerror(errno));
+					rc = -errno;
+					goto out;
+				}
+				continue;
+			}
+
+			/* coalesce a burst of udev events into one walk */
+			rc = ndctl_process_udev_events(ctx);
+			if (rc < 0) {
+				error("failed to process udev events: %s\n",
+						strerror(-rc));
+				goto out;
+			}
+			if (rc > 0)
+				rescan = true;
+		}
+
+		if (rescan) {
+			rc = watch_walk(ctx, fctx, &lw);
+			if (rc)
+				goto out;
+		}
+	}
+ out:
+	list_for_each_safe(&lw.objs, obj, next, list)
+		watch_free(&lw, obj);
+	close(lw.epollfd);
+	return rc;
+}
+
 static int num_list_flags(void)
 {
 	return list.buses + list.dimms + list.regions + list.namespaces;
@@ -457,6 +1120,10 @@ int cmd_list(int argc, const char **argv, void *ctx)
 				"use human friendly number formats "),
 		OPT_INCR('v', "verbose", &list.verbose,
 				"increase output detail"),
+		OPT_STRING(0, "format", &list.format, "format",
+				"output format: json (default), csv, ndjson, or binary"),
+		OPT_BOOLEAN(0, "watch", &list.watch,
+				"keep running and emit changes as ndjson"),
 		OPT_END(),
 	};
 	const char * const u[] = {
@@ -464,7 +1131,8 @@ int cmd_list(int argc, const char **argv, void *ctx)
 		NULL
 	};
 	struct util_filter_ctx fctx = { 0 };
-	struct list_filter_arg lfa = { 0 };
+	enum util_record_format format;
+	struct list_stream ls = { 0 };
 	int i, rc;
 
         argc = parse_options(argc, argv, options, u, 0);
@@ -473,6 +1141,11 @@ int cmd_list(int argc, const char **argv, void *ctx)
 	if (argc)
 		usage_with_options(u, options);
 
+	if (util_record_parse_format(list.format, &format) < 0) {
+		error("unknown format \"%s\"\n", list.format);
+		usage_with_options(u, options);
+	}
+
 	if (num_list_flags() == 0) {
 		list.buses = !!param.bus;
 		list.regions = !!param.region;
@@ -502,18 +1175,55 @@ int cmd_list(int argc, const char **argv, void *ctx)
 	if (num_list_flags() == 0)
 		list.namespaces = true;
 
+	if (list.watch) {
+		/* the commands after it in a batch would never run */
+		if (list_reused) {
+			error("--watch is not supported in batch mode\n");
+			return -EOPNOTSUPP;
+		}
+		if (format != UTIL_RECORD_FMT_JSON
+				&& format != UTIL_RECORD_FMT_NDJSON) {
+			error("--watch only supports json output\n");
+			usage_with_options(u, options);
+		}
+		return list_watch(ctx, &fctx);
+	}
+
 	fctx.filter_bus = filter_bus;
 	fctx.filter_dimm = list.dimms ? filter_dimm : NULL;
 	fctx.filter_region = filter_region;
 	fctx.filter_namespace = list.namespaces ? filter_namespace : NULL;
-	fctx.list = &lfa;
-	lfa.flags = listopts_to_flags();
+	fctx.arg = &ls;
+	ls.flags = listopts_to_flags();
+
+	if (format != UTIL_RECORD_FMT_JSON) {
+		fctx.filter_bus = record_bus;
+		fctx.filter_dimm = list.dimms ? record_dimm : NULL;
+		fctx.filter_region = record_region;
+		fctx.filter_namespace = list.namespaces
+			? record_namespace : NULL;
+		util_record_init(&ls.rec, stdout, format);
+		rc = util_filter_walk(ctx, &fctx, &param);
+		util_record_release(&ls.rec);
+		if (rc)
+			return rc;
+		return did_fail ? -ENOMEM : 0;
+	}
+
+	util_json_stream_init(&ls.js, stdout, ls.flags);
+
+	if (!list.buses && (list.dimms + list.regions + list.namespaces) > 1)
+		rc = list_platform(ctx, &fctx, &ls);
+	else
+		rc = util_filter_walk(ctx, &fctx, &param);
 
-	rc = util_filter_walk(ctx, &fctx, &param);
+	list_close(&ls, LIST_BUS);
+	if (ls.jbuses)
+		util_json_stream_end(&ls.js);
 	if (rc)
 		return rc;
 
-	if (list_display(&lfa) || did_fail)
+	if (did_fail)
 		return -ENOMEM;
 	return 0;
 }
@@ -14,28 +14,196 @@
 #include <ndctl/lib/private.h>
 #include <ndctl/libndctl.h>
 #include <sys/epoll.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include <sys/eventfd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
 #define BUF_SIZE 2048
 
+/*
+ * Notifications written to a --log=<file> are staged in a buffer that is
+ * written with a single O_APPEND write() once it reaches the watermark,
+ * when the flush timer expires, or immediately for errors.
+ */
+#define LOG_BUF_SIZE 16384
+#define LOG_WATERMARK (LOG_BUF_SIZE / 2)
+#define LOG_FLUSH_MSEC 200
+
+/*
+ * --dimm-event selectors for the region and bus notifications, kept clear
+ * of the ND_EVENT_* dimm flags that share monitor.event_flags
+ */
+#define MONITOR_EVENT_REGION_BADBLOCKS	(1 << 16)
+#define MONITOR_EVENT_BUS_SCRUB		(1 << 17)
+
+/*
+ * Smart values sampled by --poll. A notification is sent when a value
+ * has moved by at least its delta from the value last notified.
+ */
+enum monitor_sample {
+	SAMPLE_TEMPERATURE,
+	SAMPLE_CTRL_TEMPERATURE,
+	SAMPLE_SPARES,
+	SAMPLE_LIFE_USED,
+	SAMPLE_MAX,
+};
+
+static const struct {
+	const char *name;
+	const char *key;
+	unsigned int valid;
+	double delta;
+} sample_info[] = {
+	[SAMPLE_TEMPERATURE] = { "media-temperature", "temperature_celsius",
+		ND_SMART_TEMP_VALID, 5 },
+	[SAMPLE_CTRL_TEMPERATURE] = { "controller-temperature",
+		"controller_temperature_celsius", ND_SMART_CTEMP_VALID, 5 },
+	[SAMPLE_SPARES] = { "spares", "spares_percentage",
+		ND_SMART_SPARES_VALID, 1 },
+	[SAMPLE_LIFE_USED] = { "life-used", "life_used_percentage",
+		ND_SMART_USED_VALID, 1 },
+};
+
 static struct monitor {
 	const char *log;
 	const char *config_file;
 	const char *dimm_event;
+	const char *coalesce;
+	const char *rate_limit;
+	const char *poll;
+	const char *poll_delta;
+	const char *event_ring;
 	bool daemon;
 	bool human;
 	bool verbose;
 	unsigned int event_flags;
+	unsigned long coalesce_msec;
+	unsigned int rate_count;
+	unsigned int rate_sec;
+	unsigned long poll_msec;
+	double delta[SAMPLE_MAX];
+	struct ndctl_event_ring *ring;
 } monitor;
 
+/*
+ * Each object with a descriptor in the epoll set starts with its
+ * source type, the epoll data pointer refers to the object.
+ */
+enum monitor_source {
+	MONITOR_DIMM,
+	MONITOR_REGION,
+	MONITOR_BUS,
+};
+
+/* the notification work handed to a bus worker for a dimm */
+enum monitor_work_type {
+	WORK_EVENT = 1 << 0,
+	WORK_SAMPLE = 1 << 1,
+};
+
+struct monitor_work {
+	unsigned int type;
+	unsigned int pending;
+	struct timespec first, last;
+};
+
+/*
+ * Smart commands are serviced by dimm firmware and a slow or hung DSM
+ * blocks its caller. The epoll loop only collects wakeups and decides
+ * when a dimm is due, the smart commands and notifications are run by a
+ * worker thread per bus, so a stalled dimm delays only the dimms on its
+ * own bus. A dimm is only ever handled by its bus's worker, so the dimm
+ * itself needs no locking, @lock protects the queue and the work of the
+ * queued dimms.
+ */
+struct monitor_worker {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct ndctl_bus *bus;
+	struct list_head queue;
+	bool stop;
+	int rc;
+	struct list_node list;
+};
+
+/*
+ * Health eventfd wakeups are not acted on directly. Each wakeup is counted
+ * against the dimm, and the smart data is fetched and a notification sent
+ * once the coalescing window that opened with the first wakeup closes.
+ * With a rate limit each fetch also consumes a token from a per-dimm
+ * bucket of @rate_count tokens refilled over @rate_sec, when the bucket
+ * is empty the wakeups keep accumulating until a token is available.
+ */
 struct monitor_dimm {
+	enum monitor_source source;
 	struct ndctl_dimm *dimm;
 	int health_eventfd;
 	unsigned int health;
 	unsigned int event_flags;
+	unsigned int pending;
+	struct timespec first, last;
+	unsigned long long deadline;
+	unsigned long long refill;
+	double tokens;
+	bool sampled;
+	unsigned int sample_valid;
+	double sample[SAMPLE_MAX];
+	struct json_object *jdimm;
+	bool enabled;
+	struct monitor_worker *worker;
+	struct monitor_work work;
+	bool queued;
+	struct list_node work_list;
+	struct list_node list;
+};
+
+static struct log_sink {
+	int fd;
+	int timerfd;
+	int sigfd;
+	bool timer_armed;
+	bool failed;
+	dev_t dev;
+	ino_t ino;
+	size_t len;
+	char buf[LOG_BUF_SIZE];
+} log_sink = {
+	.fd = -1,
+	.timerfd = -1,
+	.sigfd = -1,
+};
+
+/* the region's badblocks list as of the last notification, by offset */
+struct monitor_region {
+	enum monitor_source source;
+	struct ndctl_region *region;
+	int badblocks_fd;
+	int num_bb;
+	struct badblock *bb;
+	struct list_node list;
+};
+
+struct monitor_bus {
+	enum monitor_source source;
+	struct ndctl_bus *bus;
+	int scrub_fd;
+	int scrub_active;
 	struct list_node list;
 };
 
 struct util_filter_params param;
 
+/* log_file() and the ring are shared by the bus workers */
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t ring_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* written by a worker that failed, to stop the monitor */
+static int worker_failfd = -1;
+
 static int did_fail;
 
 #define fail(fmt, ...) \
@@ -79,40 +247,204 @@ static void log_standard(struct ndctl_ctx *ctx, int priority, const char *file,
 	return;
 }
 
+/* (re)open the log file, e.g. after it has been rotated */
+static int log_sink_open(void)
+{
+	struct stat st;
+	int fd;
+
+	fd = open(monitor.log, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+	if (fd < 0)
+		return -errno;
+	if (fstat(fd, &st) < 0) {
+		close(fd);
+		return -errno;
+	}
+
+	if (log_sink.fd >= 0)
+		close(log_sink.fd);
+	log_sink.fd = fd;
+	log_sink.dev = st.st_dev;
+	log_sink.ino = st.st_ino;
+	return 0;
+}
+
+static int log_sink_init(void)
+{
+	sigset_t mask;
+	int rc;
+
+	rc = log_sink_open();
+	if (rc)
+		return rc;
+
+	log_sink.timerfd = timerfd_create(CLOCK_MONOTONIC,
+			TFD_NONBLOCK | TFD_CLOEXEC);
+	if (log_sink.timerfd < 0)
+		return -errno;
+
+	/*
+	 * SIGHUP requests a reopen, SIGTERM and SIGINT a clean exit that
+	 * writes out what is buffered, all consumed in monitor_event()
+	 */
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGHUP);
+	sigaddset(&mask, SIGTERM);
+	sigaddset(&mask, SIGINT);
+	if (sigprocmask(SIG_BLOCK, &mask, NULL) < 0)
+		return -errno;
+	log_sink.sigfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+	if (log_sink.sigfd < 0)
+		return -errno;
+	return 0;
+}
+
+static void log_sink_arm_timer(void)
+{
+	struct itimerspec its = {
+		.it_value = {
+			.tv_sec = LOG_FLUSH_MSEC / 1000,
+			.tv_nsec = (LOG_FLUSH_MSEC % 1000) * 1000000,
+		},
+	};
+
+	if (log_sink.timer_armed)
+		return;
+	if (timerfd_settime(log_sink.timerfd, 0, &its, NULL) == 0)
+		log_sink.timer_armed = true;
+}
+
+/*
+ * Called with log_lock held from the flush timer, so a rotation is noticed
+ * within a timer period without a stat() for every write. Until a new
+ * file can be created, writes go on to the old one.
+ */
+static void log_sink_follow(void)
+{
+	struct stat st;
+
+	/* the file was moved or removed by log rotation */
+	if (stat(monitor.log, &st) < 0 || st.st_dev != log_sink.dev
+			|| st.st_ino != log_sink.ino)
+		log_sink_open();
+}
+
+static int log_sink_write(const char *buf, size_t len)
+{
+	ssize_t rc;
+
+	while (len) {
+		rc = write(log_sink.fd, buf, len);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		buf += rc;
+		len -= rc;
+	}
+	return 0;
+}
+
+/*
+ * Called with log_lock held, possibly from a worker. The messages go to
+ * syslog from now on, and the timer wakes monitor_event() to switch the
+ * log function, see log_sink_check().
+ */
+static void log_sink_fail(const char *buf, size_t len)
+{
+	if (!log_sink.failed)
+		syslog(LOG_ERR, "write logfile %s failed, forward messages to syslog\n",
+				monitor.log);
+	log_sink.failed = true;
+	syslog(LOG_NOTICE, "%.*s", (int) len, buf);
+	log_sink_arm_timer();
+}
+
+static void log_sink_flush(struct ndctl_ctx *ctx)
+{
+	log_sink.timer_armed = false;
+	if (!log_sink.len)
+		return;
+
+	if (log_sink.failed || log_sink_write(log_sink.buf, log_sink.len))
+		log_sink_fail(log_sink.buf, log_sink.len);
+	log_sink.len = 0;
+}
+
+/* from the epoll thread, switch to syslog once a write has failed */
+static void log_sink_check(struct ndctl_ctx *ctx)
+{
+	bool failed;
+
+	pthread_mutex_lock(&log_lock);
+	failed = log_sink.failed;
+	pthread_mutex_unlock(&log_lock);
+	if (!failed)
+		return;
+
+	ndctl_set_log_fn(ctx, log_syslog);
+	did_fail = 1;
+}
+
+static void log_sink_close(struct ndctl_ctx *ctx)
+{
+	if (log_sink.fd < 0)
+		return;
+	log_sink_flush(ctx);
+	close(log_sink.fd);
+	log_sink.fd = -1;
+}
+
 static void log_file(struct ndctl_ctx *ctx, int priority, const char *file,
 		int line, const char *fn, const char *format, va_list args)
 {
-	FILE *f;
-	char *buf;
+	char *buf, *msg;
 	struct timespec ts;
-	char timestamp[32];
+	int len;
 
 	if (vasprintf(&buf, format, args) < 0) {
 		fail("vasprintf error\n");
 		return;
 	}
 
-	f = fopen(monitor.log, "a+");
-	if (!f) {
-		ndctl_set_log_fn(ctx, log_syslog);
-		err(ctx, "open logfile %s failed, forward messages to syslog\n",
-				monitor.log);
-		did_fail = 1;
-		notice(ctx, "%s\n", buf);
+	if (priority != LOG_NOTICE) {
+		clock_gettime(CLOCK_REALTIME, &ts);
+		len = asprintf(&msg, "[%10ld.%09ld] [%d] %s", ts.tv_sec,
+				ts.tv_nsec, getpid(), buf);
+		free(buf);
+		if (len < 0) {
+			fail("asprintf error\n");
+			return;
+		}
+	} else {
+		msg = buf;
+		len = strlen(msg);
+	}
+
+	pthread_mutex_lock(&log_lock);
+	if (log_sink.failed) {
+		log_sink_fail(msg, len);
+		goto end;
+	}
+	if (log_sink.len + len > LOG_BUF_SIZE)
+		log_sink_flush(ctx);
+	if ((size_t) len > LOG_BUF_SIZE) {
+		if (log_sink_write(msg, len) < 0)
+			log_sink_fail(msg, len);
 		goto end;
 	}
 
-	if (priority != LOG_NOTICE) {
-		clock_gettime(CLOCK_REALTIME, &ts);
-		sprintf(timestamp, "%10ld.%09ld", ts.tv_sec, ts.tv_nsec);
-		fprintf(f, "[%s] [%d] %s", timestamp, getpid(), buf);
-	} else
-		fprintf(f, "%s", buf);
+	memcpy(log_sink.buf + log_sink.len, msg, len);
+	log_sink.len += len;
 
-	fflush(f);
-	fclose(f);
+	if (log_sink.len >= LOG_WATERMARK || priority <= LOG_ERR)
+		log_sink_flush(ctx);
+	else
+		log_sink_arm_timer();
 end:
-	free(buf);
+	pthread_mutex_unlock(&log_lock);
+	free(msg);
 	return;
 }
 
@@ -177,7 +509,94 @@ static struct json_object *dimm_event_to_json(struct monitor_dimm *mdimm)
 	return jevent;
 }
 
-static int notify_dimm_event(struct monitor_dimm *mdimm)
+static unsigned long long monotonic_nsec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static struct json_object *timespec_to_json(struct timespec *ts)
+{
+	char timestamp[32];
+
+	sprintf(timestamp, "%10ld.%09ld", ts->tv_sec, ts->tv_nsec);
+	return json_object_new_string(timestamp);
+}
+
+/* the wakeups merged into this notification */
+static struct json_object *dimm_pending_to_json(struct monitor_work *work)
+{
+	struct json_object *jevents, *jobj;
+
+	jevents = json_object_new_object();
+	if (!jevents)
+		return NULL;
+
+	jobj = json_object_new_int(work->pending);
+	if (jobj)
+		json_object_object_add(jevents, "count", jobj);
+	jobj = timespec_to_json(&work->first);
+	if (jobj)
+		json_object_object_add(jevents, "first", jobj);
+	jobj = timespec_to_json(&work->last);
+	if (jobj)
+		json_object_object_add(jevents, "last", jobj);
+
+	return jevents;
+}
+
+/*
+ * The dimm attributes in a notification do not change while the monitor
+ * runs, apart from the enabled state, so the object is built once and a
+ * reference taken for each notification. Only "health" and "state" are
+ * replaced per notification.
+ */
+static struct json_object *dimm_to_json(struct monitor_dimm *mdimm)
+{
+	struct ndctl_dimm *dimm = mdimm->dimm;
+	bool enabled = ndctl_dimm_is_enabled(dimm);
+	struct json_object *jobj;
+
+	if (!mdimm->jdimm) {
+		mdimm->jdimm = util_dimm_to_json(dimm, 0);
+		if (!mdimm->jdimm)
+			return NULL;
+		mdimm->enabled = enabled;
+	}
+
+	if (enabled != mdimm->enabled) {
+		json_object_object_del(mdimm->jdimm, "state");
+		if (!enabled) {
+			jobj = json_object_new_string("disabled");
+			if (jobj)
+				json_object_object_add(mdimm->jdimm, "state",
+						jobj);
+		}
+		mdimm->enabled = enabled;
+	}
+
+	return json_object_get(mdimm->jdimm);
+}
+
+/* one smart command per notification, shared by the ring and the json */
+static struct ndctl_cmd *dimm_smart(struct ndctl_dimm *dimm)
+{
+	struct ndctl_cmd *cmd;
+
+	cmd = ndctl_dimm_cmd_new_smart(dimm);
+	if (!cmd)
+		return NULL;
+	if (ndctl_cmd_submit(cmd) || ndctl_cmd_get_firmware_status(cmd)) {
+		ndctl_cmd_unref(cmd);
+		return NULL;
+	}
+	return cmd;
+}
+
+static int notify_dimm(struct monitor_dimm *mdimm, struct json_object *jevent,
+		struct json_object *jevents, struct ndctl_cmd *smart)
 {
 	struct json_object *jmsg, *jdimm, *jobj;
 	struct timespec ts;
@@ -187,6 +606,8 @@ static int notify_dimm_event(struct monitor_dimm *mdimm)
 	jmsg = json_object_new_object();
 	if (!jmsg) {
 		fail("\n");
+		json_object_put(jevent);
+		json_object_put(jevents);
 		return -ENOMEM;
 	}
 
@@ -200,17 +621,24 @@ static int notify_dimm_event(struct monitor_dimm *mdimm)
 	if (jobj)
 		json_object_object_add(jmsg, "pid", jobj);
 
-	jobj = dimm_event_to_json(mdimm);
-	if (jobj)
-		json_object_object_add(jmsg, "event", jobj);
+	if (jevent)
+		json_object_object_add(jmsg, "event", jevent);
+
+	if (jevents)
+		json_object_object_add(jmsg, "events", jevents);
 
-	jdimm = util_dimm_to_json(mdimm->dimm, 0);
-	if (jdimm)
+	jdimm = dimm_to_json(mdimm);
+	if (jdimm) {
 		json_object_object_add(jmsg, "dimm", jdimm);
 
-	jobj = util_dimm_health_to_json(mdimm->dimm);
-	if (jobj)
-		json_object_object_add(jdimm, "health", jobj);
+		jobj = NULL;
+		if (ndctl_dimm_is_cmd_supported(mdimm->dimm, ND_CMD_SMART))
+			jobj = util_dimm_smart_to_json(mdimm->dimm, smart);
+		if (jobj)
+			json_object_object_add(jdimm, "health", jobj);
+		else
+			json_object_object_del(jdimm, "health");
+	}
 
 	if (monitor.human)
 		notice(ctx, "%s\n", json_object_to_json_string_ext(jmsg,
@@ -219,12 +647,68 @@ static int notify_dimm_event(struct monitor_dimm *mdimm)
 		notice(ctx, "%s\n", json_object_to_json_string_ext(jmsg,
 						JSON_C_TO_STRING_PLAIN));
 
-	free(jobj);
-	free(jdimm);
-	free(jmsg);
+	json_object_put(jmsg);
 	return 0;
 }
 
+/*
+ * Publish the event with the health snapshot in @cmd to the --event-ring,
+ * ahead of the json notification, for consumers that want neither the
+ * latency of the log nor the cost of parsing it.
+ */
+static void ring_post_dimm(struct monitor_dimm *mdimm,
+		unsigned int event_flags, struct ndctl_cmd *cmd)
+{
+	struct ndctl_dimm *dimm = mdimm->dimm;
+	struct ndctl_event_record rec = { 0 };
+	struct timespec ts;
+
+	if (!monitor.ring)
+		return;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	rec.timestamp = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	rec.bus_id = ndctl_bus_get_id(ndctl_dimm_get_bus(dimm));
+	rec.dimm_id = ndctl_dimm_get_id(dimm);
+	rec.handle = ndctl_dimm_get_handle(dimm);
+	rec.event_flags = event_flags;
+
+	if (cmd) {
+		rec.smart_flags = ndctl_cmd_smart_get_flags(cmd);
+		rec.health = ndctl_cmd_smart_get_health(cmd);
+		rec.temperature = ndctl_cmd_smart_get_temperature(cmd);
+		rec.ctrl_temperature = ndctl_cmd_smart_get_ctrl_temperature(cmd);
+		rec.spares = ndctl_cmd_smart_get_spares(cmd);
+		rec.alarm_flags = ndctl_cmd_smart_get_alarm_flags(cmd);
+		rec.life_used = ndctl_cmd_smart_get_life_used(cmd);
+		rec.shutdown_state = ndctl_cmd_smart_get_shutdown_state(cmd);
+		rec.shutdown_count = ndctl_cmd_smart_get_shutdown_count(cmd);
+	}
+
+	pthread_mutex_lock(&ring_lock);
+	ndctl_event_ring_post(monitor.ring, &rec);
+	pthread_mutex_unlock(&ring_lock);
+}
+
+static int notify_dimm_event(struct monitor_dimm *mdimm,
+		struct monitor_work *work)
+{
+	struct json_object *jevents = NULL;
+	struct ndctl_cmd *smart;
+	int rc;
+
+	smart = dimm_smart(mdimm->dimm);
+	ring_post_dimm(mdimm, mdimm->event_flags & monitor.event_flags,
+			smart);
+
+	if (work->pending && (monitor.coalesce_msec || monitor.rate_count))
+		jevents = dimm_pending_to_json(work);
+
+	rc = notify_dimm(mdimm, dimm_event_to_json(mdimm), jevents, smart);
+	ndctl_cmd_unref(smart);
+	return rc;
+}
+
 static struct monitor_dimm *util_dimm_event_filter(struct monitor_dimm *mdimm,
 		unsigned int event_flags)
 {
@@ -290,9 +774,87 @@ out:
 	return rc;
 }
 
+static int region_read_badblocks(struct ndctl_region *region,
+		struct badblock **bb_out)
+{
+	struct badblock *bb, *bbs = NULL, *tmp;
+	int num = 0, alloc = 0;
+
+	ndctl_region_badblock_foreach(region, bb) {
+		if (num == alloc) {
+			alloc = alloc ? alloc * 2 : 16;
+			tmp = realloc(bbs, alloc * sizeof(*bbs));
+			if (!tmp) {
+				free(bbs);
+				return -ENOMEM;
+			}
+			bbs = tmp;
+		}
+		bbs[num++] = *bb;
+	}
+
+	*bb_out = bbs;
+	return num;
+}
+
+/* open a sysfs attribute that the kernel signals with sysfs_notify() */
+static int open_notify_attr(const char *devname, const char *attr)
+{
+	char path[PATH_MAX];
+	char buf;
+	int fd;
+
+	snprintf(path, sizeof(path), "/sys/bus/nd/devices/%s/%s", devname,
+			attr);
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+	if (pread(fd, &buf, sizeof(buf), 0) < 0) {
+		close(fd);
+		return -errno;
+	}
+	return fd;
+}
+
 static bool filter_region(struct ndctl_region *region,
 		struct util_filter_ctx *fctx)
 {
+	struct monitor_filter_arg *mfa = fctx->monitor;
+	struct ndctl_ctx *ctx = ndctl_region_get_ctx(region);
+	const char *name = ndctl_region_get_devname(region);
+	struct monitor_region *mregion;
+	int fd, num;
+
+	if (!(monitor.event_flags & MONITOR_EVENT_REGION_BADBLOCKS))
+		return true;
+
+	fd = open_notify_attr(name, "badblocks");
+	if (fd < 0) {
+		dbg(ctx, "%s: no badblocks notification support\n", name);
+		return true;
+	}
+
+	mregion = calloc(1, sizeof(struct monitor_region));
+	if (!mregion) {
+		err(ctx, "%s: calloc for monitor region failed\n", name);
+		close(fd);
+		return true;
+	}
+
+	num = region_read_badblocks(region, &mregion->bb);
+	if (num < 0) {
+		err(ctx, "%s: read badblocks failed\n", name);
+		close(fd);
+		free(mregion);
+		return true;
+	}
+
+	mregion->source = MONITOR_REGION;
+	mregion->region = region;
+	mregion->badblocks_fd = fd;
+	mregion->num_bb = num;
+	list_add_tail(&mfa->regions, &mregion->list);
+	mfa->num_region++;
 	return true;
 }
 
@@ -328,15 +890,21 @@ static void filter_dimm(struct ndctl_dimm *dimm, struct util_filter_ctx *fctx)
 		return;
 	}
 
+	mdimm->source = MONITOR_DIMM;
 	mdimm->dimm = dimm;
 	mdimm->health_eventfd = ndctl_dimm_get_health_eventfd(dimm);
 	mdimm->health = ndctl_dimm_get_health(dimm);
 	mdimm->event_flags = ndctl_dimm_get_event_flags(dimm);
+	mdimm->tokens = monitor.rate_count;
+	mdimm->refill = monotonic_nsec();
+	mdimm->jdimm = util_dimm_to_json(dimm, 0);
+	mdimm->enabled = ndctl_dimm_is_enabled(dimm);
 
 	if (mdimm->event_flags
 			&& util_dimm_event_filter(mdimm, monitor.event_flags)) {
-		if (notify_dimm_event(mdimm)) {
+		if (notify_dimm_event(mdimm, &mdimm->work)) {
 			err(ctx, "%s: notify dimm event failed\n", name);
+			json_object_put(mdimm->jdimm);
 			free(mdimm);
 			return;
 		}
@@ -351,28 +919,566 @@ static void filter_dimm(struct ndctl_dimm *dimm, struct util_filter_ctx *fctx)
 
 static bool filter_bus(struct ndctl_bus *bus, struct util_filter_ctx *fctx)
 {
+	struct monitor_filter_arg *mfa = fctx->monitor;
+	struct ndctl_ctx *ctx = ndctl_bus_get_ctx(bus);
+	const char *name = ndctl_bus_get_devname(bus);
+	struct monitor_bus *mbus;
+	int fd;
+
+	if (!(monitor.event_flags & MONITOR_EVENT_BUS_SCRUB))
+		return true;
+
+	fd = open_notify_attr(name, "nfit/scrub");
+	if (fd < 0) {
+		dbg(ctx, "%s: no scrub notification support\n", name);
+		return true;
+	}
+
+	mbus = calloc(1, sizeof(struct monitor_bus));
+	if (!mbus) {
+		err(ctx, "%s: calloc for monitor bus failed\n", name);
+		close(fd);
+		return true;
+	}
+
+	mbus->source = MONITOR_BUS;
+	mbus->bus = bus;
+	mbus->scrub_fd = fd;
+	mbus->scrub_active = ndctl_bus_get_scrub_state(bus);
+	list_add_tail(&mfa->busses, &mbus->list);
+	mfa->num_bus++;
 	return true;
 }
 
+static struct json_object *badblocks_to_json(struct badblock *bb, int num)
+{
+	struct json_object *jbbs, *jbb, *jobj;
+	int i;
+
+	jbbs = json_object_new_array();
+	if (!jbbs)
+		return NULL;
+
+	for (i = 0; i < num; i++) {
+		jbb = json_object_new_object();
+		if (!jbb)
+			break;
+		jobj = json_object_new_int64(bb[i].offset);
+		if (jobj)
+			json_object_object_add(jbb, "offset", jobj);
+		jobj = json_object_new_int(bb[i].len);
+		if (jobj)
+			json_object_object_add(jbb, "length", jobj);
+		json_object_array_add(jbbs, jbb);
+	}
+
+	return jbbs;
+}
+
+static int notify_event(struct ndctl_ctx *ctx, struct json_object *jevent,
+		const char *key, struct json_object *jdev)
+{
+	struct json_object *jmsg, *jobj;
+	struct timespec ts;
+
+	jmsg = json_object_new_object();
+	if (!jmsg) {
+		fail("\n");
+		json_object_put(jevent);
+		json_object_put(jdev);
+		return -ENOMEM;
+	}
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	jobj = timespec_to_json(&ts);
+	if (jobj)
+		json_object_object_add(jmsg, "timestamp", jobj);
+	jobj = json_object_new_int(getpid());
+	if (jobj)
+		json_object_object_add(jmsg, "pid", jobj);
+	if (jevent)
+		json_object_object_add(jmsg, "event", jevent);
+	if (jdev)
+		json_object_object_add(jmsg, key, jdev);
+
+	notice(ctx, "%s\n", json_object_to_json_string_ext(jmsg,
+				monitor.human ? JSON_C_TO_STRING_PRETTY
+				: JSON_C_TO_STRING_PLAIN));
+	json_object_put(jmsg);
+	return 0;
+}
+
+static bool badblock_before(struct badblock *a, struct badblock *b)
+{
+	return a->offset < b->offset
+		|| (a->offset == b->offset && a->len < b->len);
+}
+
+/* report the badblocks added and cleared since the last notification */
+static int monitor_region_event(struct monitor_region *mregion)
+{
+	struct ndctl_region *region = mregion->region;
+	struct ndctl_ctx *ctx = ndctl_region_get_ctx(region);
+	struct badblock *bb, *added, *cleared;
+	struct json_object *jevent, *jregion, *jobj;
+	int num, i = 0, j = 0, num_added = 0, num_cleared = 0;
+
+	num = region_read_badblocks(region, &bb);
+	if (num < 0)
+		return num;
+
+	added = calloc(num + 1, sizeof(*added));
+	cleared = calloc(mregion->num_bb + 1, sizeof(*cleared));
+	if (!added || !cleared) {
+		free(added);
+		free(cleared);
+		free(bb);
+		return -ENOMEM;
+	}
+
+	while (i < num || j < mregion->num_bb) {
+		if (j >= mregion->num_bb
+				|| (i < num && badblock_before(&bb[i],
+						&mregion->bb[j])))
+			added[num_added++] = bb[i++];
+		else if (i >= num || badblock_before(&mregion->bb[j], &bb[i]))
+			cleared[num_cleared++] = mregion->bb[j++];
+		else {
+			i++;
+			j++;
+		}
+	}
+
+	free(mregion->bb);
+	mregion->bb = bb;
+	mregion->num_bb = num;
+
+	if (!num_added && !num_cleared) {
+		free(added);
+		free(cleared);
+		return 0;
+	}
+
+	jevent = json_object_new_object();
+	if (jevent) {
+		jobj = json_object_new_object();
+		if (jobj) {
+			json_object_object_add(jobj, "added",
+					badblocks_to_json(added, num_added));
+			json_object_object_add(jobj, "cleared",
+					badblocks_to_json(cleared, num_cleared));
+			json_object_object_add(jevent, "region-badblocks",
+					jobj);
+		}
+	}
+	free(added);
+	free(cleared);
+
+	jregion = json_object_new_object();
+	if (jregion) {
+		jobj = json_object_new_string(ndctl_region_get_devname(region));
+		if (jobj)
+			json_object_object_add(jregion, "dev", jobj);
+		jobj = json_object_new_int(num);
+		if (jobj)
+			json_object_object_add(jregion, "badblock_count", jobj);
+	}
+
+	return notify_event(ctx, jevent, "region", jregion);
+}
+
+static int monitor_bus_event(struct monitor_bus *mbus)
+{
+	struct ndctl_bus *bus = mbus->bus;
+	struct ndctl_ctx *ctx = ndctl_bus_get_ctx(bus);
+	struct json_object *jevent, *jobj;
+	int active;
+
+	active = ndctl_bus_get_scrub_state(bus);
+	if (active < 0 || active == mbus->scrub_active)
+		return 0;
+	mbus->scrub_active = active;
+
+	jevent = json_object_new_object();
+	if (jevent) {
+		jobj = json_object_new_string(active ? "started" : "completed");
+		if (jobj)
+			json_object_object_add(jevent, "bus-scrub", jobj);
+	}
+
+	return notify_event(ctx, jevent, "bus", util_bus_to_json(bus));
+}
+
+static void dimm_event_pending(struct monitor_dimm *mdimm)
+{
+	clock_gettime(CLOCK_REALTIME, &mdimm->last);
+	if (mdimm->pending++)
+		return;
+	mdimm->first = mdimm->last;
+	mdimm->deadline = monotonic_nsec() + monitor.coalesce_msec * 1000000ULL;
+}
+
+/* milliseconds until the next coalescing window closes, -1 if none */
+static int monitor_timeout(struct monitor_filter_arg *mfa)
+{
+	unsigned long long now = monotonic_nsec(), next = ULLONG_MAX;
+	struct monitor_dimm *mdimm;
+
+	list_for_each(&mfa->dimms, mdimm, list)
+		if (mdimm->pending && mdimm->deadline < next)
+			next = mdimm->deadline;
+
+	if (next == ULLONG_MAX)
+		return -1;
+	if (next <= now)
+		return 0;
+	return (next - now + 999999) / 1000000;
+}
+
+/* refill the bucket, returns false if the dimm must wait for a token */
+static bool dimm_take_token(struct monitor_dimm *mdimm,
+		unsigned long long now)
+{
+	double rate;
+
+	if (!monitor.rate_count)
+		return true;
+
+	rate = (double) monitor.rate_count / (monitor.rate_sec * 1e9);
+	mdimm->tokens += (now - mdimm->refill) * rate;
+	if (mdimm->tokens > monitor.rate_count)
+		mdimm->tokens = monitor.rate_count;
+	mdimm->refill = now;
+
+	if (mdimm->tokens < 1) {
+		mdimm->deadline = now + (1 - mdimm->tokens) / rate;
+		return false;
+	}
+	mdimm->tokens -= 1;
+	return true;
+}
+
+static void monitor_queue(struct monitor_dimm *mdimm, unsigned int type)
+{
+	struct monitor_worker *worker = mdimm->worker;
+
+	pthread_mutex_lock(&worker->lock);
+	if (type == WORK_EVENT) {
+		/* merge with an event still waiting for the worker */
+		if (!(mdimm->work.type & WORK_EVENT)) {
+			mdimm->work.pending = 0;
+			mdimm->work.first = mdimm->first;
+		}
+		mdimm->work.pending += mdimm->pending;
+		mdimm->work.last = mdimm->last;
+	}
+	mdimm->work.type |= type;
+	if (!mdimm->queued) {
+		list_add_tail(&worker->queue, &mdimm->work_list);
+		mdimm->queued = true;
+		pthread_cond_signal(&worker->cond);
+	}
+	pthread_mutex_unlock(&worker->lock);
+}
+
+static void monitor_dispatch(struct monitor_filter_arg *mfa)
+{
+	unsigned long long now = monotonic_nsec();
+	struct monitor_dimm *mdimm;
+
+	list_for_each(&mfa->dimms, mdimm, list) {
+		if (!mdimm->pending || mdimm->deadline > now)
+			continue;
+		if (!dimm_take_token(mdimm, now))
+			continue;
+
+		monitor_queue(mdimm, WORK_EVENT);
+		mdimm->pending = 0;
+	}
+}
+
+static void dimm_sample(struct ndctl_cmd *cmd, unsigned int *valid,
+		double *sample)
+{
+	unsigned int flags;
+	int i;
+
+	flags = ndctl_cmd_smart_get_flags(cmd);
+	*valid = 0;
+	for (i = 0; i < SAMPLE_MAX; i++)
+		if (flags & sample_info[i].valid)
+			*valid |= 1 << i;
+
+	sample[SAMPLE_TEMPERATURE] = ndctl_decode_smart_temperature(
+			ndctl_cmd_smart_get_temperature(cmd));
+	sample[SAMPLE_CTRL_TEMPERATURE] = ndctl_decode_smart_temperature(
+			ndctl_cmd_smart_get_ctrl_temperature(cmd));
+	sample[SAMPLE_SPARES] = ndctl_cmd_smart_get_spares(cmd);
+	sample[SAMPLE_LIFE_USED] = ndctl_cmd_smart_get_life_used(cmd);
+}
+
+/* sample one dimm and notify the values that crossed their delta */
+static int monitor_sample(struct monitor_dimm *mdimm)
+{
+	struct ndctl_ctx *ctx = ndctl_dimm_get_ctx(mdimm->dimm);
+	struct json_object *jevent, *jchanged = NULL, *jobj;
+	double sample[SAMPLE_MAX];
+	struct ndctl_cmd *smart;
+	unsigned int valid;
+	int i, rc = 0;
+
+	smart = dimm_smart(mdimm->dimm);
+	if (!smart) {
+		dbg(ctx, "%s: smart sample failed\n",
+				ndctl_dimm_get_devname(mdimm->dimm));
+		return 0;
+	}
+	dimm_sample(smart, &valid, sample);
+
+	if (!mdimm->sampled) {
+		mdimm->sampled = true;
+		mdimm->sample_valid = valid;
+		memcpy(mdimm->sample, sample, sizeof(sample));
+		goto out;
+	}
+
+	for (i = 0; i < SAMPLE_MAX; i++) {
+		if (!monitor.delta[i] || !(valid & (1 << i)))
+			continue;
+		if (mdimm->sample_valid & (1 << i)) {
+			double delta = sample[i] - mdimm->sample[i];
+
+			if (delta < 0)
+				delta = -delta;
+			if (delta < monitor.delta[i])
+				continue;
+		}
+
+		if (!jchanged) {
+			jchanged = json_object_new_object();
+			if (!jchanged) {
+				rc = -ENOMEM;
+				goto out;
+			}
+		}
+		jobj = json_object_new_double(sample[i]);
+		if (jobj)
+			json_object_object_add(jchanged, sample_info[i].key,
+					jobj);
+		mdimm->sample[i] = sample[i];
+		mdimm->sample_valid |= 1 << i;
+	}
+
+	if (!jchanged)
+		goto out;
+
+	jevent = json_object_new_object();
+	if (!jevent) {
+		json_object_put(jchanged);
+		rc = -ENOMEM;
+		goto out;
+	}
+	json_object_object_add(jevent, "dimm-health-delta", jchanged);
+	ring_post_dimm(mdimm, 0, smart);
+	rc = notify_dimm(mdimm, jevent, NULL, smart);
+ out:
+	ndctl_cmd_unref(smart);
+	return rc;
+}
+
+static int monitor_run_work(struct monitor_dimm *mdimm,
+		struct monitor_work *work)
+{
+	struct ndctl_ctx *ctx = ndctl_dimm_get_ctx(mdimm->dimm);
+	int rc;
+
+	if (work->type & WORK_EVENT
+			&& util_dimm_event_filter(mdimm, monitor.event_flags)) {
+		rc = notify_dimm_event(mdimm, work);
+		if (rc) {
+			err(ctx, "%s: notify dimm event failed\n",
+					ndctl_dimm_get_devname(mdimm->dimm));
+			return rc;
+		}
+	}
+
+	if (work->type & WORK_SAMPLE) {
+		rc = monitor_sample(mdimm);
+		if (rc) {
+			err(ctx, "%s: notify dimm sample failed\n",
+					ndctl_dimm_get_devname(mdimm->dimm));
+			return rc;
+		}
+	}
+	return 0;
+}
+
+static void *monitor_worker_fn(void *arg)
+{
+	struct monitor_worker *worker = arg;
+	struct monitor_dimm *mdimm;
+	struct monitor_work work;
+	uint64_t one = 1;
+	int rc;
+
+	pthread_mutex_lock(&worker->lock);
+	while (!worker->stop) {
+		mdimm = list_pop(&worker->queue, struct monitor_dimm,
+				work_list);
+		if (!mdimm) {
+			pthread_cond_wait(&worker->cond, &worker->lock);
+			continue;
+		}
+		mdimm->queued = false;
+		work = mdimm->work;
+		memset(&mdimm->work, 0, sizeof(mdimm->work));
+		pthread_mutex_unlock(&worker->lock);
+
+		rc = monitor_run_work(mdimm, &work);
+
+		pthread_mutex_lock(&worker->lock);
+		if (rc) {
+			worker->rc = rc;
+			if (write(worker_failfd, &one, sizeof(one)) < 0)
+				break;
+		}
+	}
+	pthread_mutex_unlock(&worker->lock);
+	return NULL;
+}
+
+static int monitor_workers_start(struct ndctl_ctx *ctx,
+		struct monitor_filter_arg *mfa, struct list_head *workers)
+{
+	struct monitor_worker *worker;
+	struct monitor_dimm *mdimm;
+	struct ndctl_bus *bus;
+
+	list_for_each(&mfa->dimms, mdimm, list) {
+		bus = ndctl_dimm_get_bus(mdimm->dimm);
+		mdimm->worker = NULL;
+		list_for_each(workers, worker, list)
+			if (worker->bus == bus) {
+				mdimm->worker = worker;
+				break;
+			}
+		if (mdimm->worker)
+			continue;
+
+		worker = calloc(1, sizeof(*worker));
+		if (!worker)
+			return -ENOMEM;
+		worker->bus = bus;
+		list_head_init(&worker->queue);
+		pthread_mutex_init(&worker->lock, NULL);
+		pthread_cond_init(&worker->cond, NULL);
+		if (pthread_create(&worker->thread, NULL, monitor_worker_fn,
+					worker) != 0) {
+			err(ctx, "%s: failed to start worker\n",
+					ndctl_bus_get_provider(bus));
+			free(worker);
+			return -ENOMEM;
+		}
+		list_add_tail(workers, &worker->list);
+		mdimm->worker = worker;
+	}
+	return 0;
+}
+
+/* returns the first failure reported by a worker */
+static int monitor_workers_stop(struct list_head *workers)
+{
+	struct monitor_worker *worker, *next;
+	int rc = 0;
+
+	list_for_each_safe(workers, worker, next, list) {
+		pthread_mutex_lock(&worker->lock);
+		worker->stop = true;
+		pthread_cond_signal(&worker->cond);
+		pthread_mutex_unlock(&worker->lock);
+		pthread_join(worker->thread, NULL);
+		if (!rc)
+			rc = worker->rc;
+		list_del(&worker->list);
+		pthread_mutex_destroy(&worker->lock);
+		pthread_cond_destroy(&worker->cond);
+		free(worker);
+	}
+	return rc;
+}
+
+/*
+ * One timer tick per dimm per interval, each tick samples the next dimm,
+ * so the smart commands are spread evenly over the interval.
+ */
+static int monitor_poll_init(struct monitor_filter_arg *mfa)
+{
+	unsigned long long tick;
+	struct itimerspec its;
+	int fd;
+
+	fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+
+	tick = monitor.poll_msec * 1000000ULL / mfa->num_dimm;
+	if (!tick)
+		tick = 1;
+	its.it_interval.tv_sec = tick / 1000000000ULL;
+	its.it_interval.tv_nsec = tick % 1000000000ULL;
+	its.it_value = its.it_interval;
+	if (timerfd_settime(fd, 0, &its, NULL) < 0) {
+		close(fd);
+		return -errno;
+	}
+	return fd;
+}
+
 static int monitor_event(struct ndctl_ctx *ctx,
 		struct monitor_filter_arg *mfa)
 {
 	struct epoll_event ev, *events;
 	int nfds, epollfd, i, rc = 0;
-	struct monitor_dimm *mdimm;
+	struct monitor_dimm *mdimm, *sample_dimm = NULL;
+	struct monitor_region *mregion;
+	struct monitor_bus *mbus;
+	int max_events = mfa->num_dimm + mfa->num_region + mfa->num_bus + 4;
+	int pollfd = -1, fd, worker_rc;
+	struct list_head workers;
 	char buf;
 
-	events = calloc(mfa->num_dimm, sizeof(struct epoll_event));
+	events = calloc(max_events, sizeof(struct epoll_event));
 	if (!events) {
 		err(ctx, "malloc for events error\n");
 		return -ENOMEM;
 	}
+	list_head_init(&workers);
 	epollfd = epoll_create1(0);
 	if (epollfd == -1) {
 		err(ctx, "epoll_create1 error\n");
 		rc = -errno;
 		goto out;
 	}
+
+	worker_failfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (worker_failfd < 0) {
+		err(ctx, "eventfd error\n");
+		rc = -errno;
+		goto out;
+	}
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = &worker_failfd;
+	if (epoll_ctl(epollfd, EPOLL_CTL_ADD, worker_failfd, &ev) != 0) {
+		err(ctx, "epoll_ctl error\n");
+		rc = -errno;
+		goto out;
+	}
+
+	rc = monitor_workers_start(ctx, mfa, &workers);
+	if (rc)
+		goto out;
+
 	list_for_each(&mfa->dimms, mdimm, list) {
 		memset(&ev, 0, sizeof(ev));
 		rc = pread(mdimm->health_eventfd, &buf, sizeof(buf), 0);
@@ -390,36 +1496,177 @@ static int monitor_event(struct ndctl_ctx *ctx,
 		}
 	}
 
+	list_for_each(&mfa->regions, mregion, list) {
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLPRI;
+		ev.data.ptr = mregion;
+		if (epoll_ctl(epollfd, EPOLL_CTL_ADD,
+				mregion->badblocks_fd, &ev) != 0) {
+			err(ctx, "epoll_ctl error\n");
+			rc = -errno;
+			goto out;
+		}
+	}
+	list_for_each(&mfa->busses, mbus, list) {
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLPRI;
+		ev.data.ptr = mbus;
+		if (epoll_ctl(epollfd, EPOLL_CTL_ADD, mbus->scrub_fd, &ev) != 0) {
+			err(ctx, "epoll_ctl error\n");
+			rc = -errno;
+			goto out;
+		}
+	}
+
+	if (log_sink.fd >= 0) {
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.ptr = &log_sink.timerfd;
+		if (epoll_ctl(epollfd, EPOLL_CTL_ADD, log_sink.timerfd, &ev)) {
+			err(ctx, "epoll_ctl error\n");
+			rc = -errno;
+			goto out;
+		}
+		ev.data.ptr = &log_sink.sigfd;
+		if (epoll_ctl(epollfd, EPOLL_CTL_ADD, log_sink.sigfd, &ev)) {
+			err(ctx, "epoll_ctl error\n");
+			rc = -errno;
+			goto out;
+		}
+	}
+
+	/* with only region and bus sources there is no dimm to sample */
+	if (monitor.poll_msec && mfa->num_dimm) {
+		pollfd = monitor_poll_init(mfa);
+		if (pollfd < 0) {
+			err(ctx, "timerfd error\n");
+			rc = pollfd;
+			goto out;
+		}
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.ptr = &pollfd;
+		if (epoll_ctl(epollfd, EPOLL_CTL_ADD, pollfd, &ev)) {
+			err(ctx, "epoll_ctl error\n");
+			rc = -errno;
+			goto out;
+		}
+	}
+
 	while (1) {
 		did_fail = 0;
-		nfds = epoll_wait(epollfd, events, mfa->num_dimm, -1);
-		if (nfds <= 0) {
+		nfds = epoll_wait(epollfd, events, max_events,
+				monitor_timeout(mfa));
+		if (nfds < 0) {
 			err(ctx, "epoll_wait error\n");
 			rc = -errno;
 			goto out;
 		}
 		for (i = 0; i < nfds; i++) {
-			mdimm = events[i].data.ptr;
-			if (util_dimm_event_filter(mdimm, monitor.event_flags)) {
-				rc = notify_dimm_event(mdimm);
-				if (rc) {
-					err(ctx, "%s: notify dimm event failed\n",
-						ndctl_dimm_get_devname(mdimm->dimm));
-					did_fail = 1;
+			if (events[i].data.ptr == &worker_failfd) {
+				did_fail = 1;
+				rc = 0;
+				goto out;
+			}
+			if (events[i].data.ptr == &log_sink.timerfd) {
+				uint64_t expirations;
+
+				if (read(log_sink.timerfd, &expirations,
+						sizeof(expirations)) > 0) {
+					pthread_mutex_lock(&log_lock);
+					log_sink_follow();
+					log_sink_flush(ctx);
+					pthread_mutex_unlock(&log_lock);
+				}
+				continue;
+			}
+			if (events[i].data.ptr == &pollfd) {
+				uint64_t ticks;
+
+				if (read(pollfd, &ticks, sizeof(ticks)) <= 0)
+					continue;
+				if (sample_dimm)
+					sample_dimm = list_next(&mfa->dimms,
+							sample_dimm, list);
+				if (!sample_dimm)
+					sample_dimm = list_top(&mfa->dimms,
+							struct monitor_dimm, list);
+				monitor_queue(sample_dimm, WORK_SAMPLE);
+				continue;
+			}
+			if (events[i].data.ptr == &log_sink.sigfd) {
+				struct signalfd_siginfo si;
+				bool stop = false;
+
+				while (read(log_sink.sigfd, &si, sizeof(si)) > 0)
+					if (si.ssi_signo == SIGTERM
+							|| si.ssi_signo == SIGINT)
+						stop = true;
+				if (stop) {
+					dbg(ctx, "exiting on signal\n");
+					rc = 0;
 					goto out;
 				}
+				/* a failed reopen is handled as a failed write */
+				pthread_mutex_lock(&log_lock);
+				log_sink_flush(ctx);
+				if (!log_sink.failed && log_sink_open() < 0) {
+					syslog(LOG_ERR, "reopen logfile %s failed, forward messages to syslog\n",
+							monitor.log);
+					log_sink.failed = true;
+				}
+				pthread_mutex_unlock(&log_lock);
+				continue;
+			}
+			switch (*(enum monitor_source *) events[i].data.ptr) {
+			case MONITOR_REGION:
+				mregion = events[i].data.ptr;
+				fd = mregion->badblocks_fd;
+				rc = monitor_region_event(mregion);
+				break;
+			case MONITOR_BUS:
+				mbus = events[i].data.ptr;
+				fd = mbus->scrub_fd;
+				rc = monitor_bus_event(mbus);
+				break;
+			case MONITOR_DIMM:
+			default:
+				mdimm = events[i].data.ptr;
+				fd = mdimm->health_eventfd;
+				dimm_event_pending(mdimm);
+				rc = 0;
+				break;
+			}
+			if (rc) {
+				err(ctx, "notify event failed\n");
+				did_fail = 1;
+				goto out;
 			}
-			rc = pread(mdimm->health_eventfd, &buf, sizeof(buf), 0);
+			rc = pread(fd, &buf, sizeof(buf), 0);
 			if (rc < 0) {
 				err(ctx, "pread error\n");
 				rc = -errno;
 				goto out;
 			}
 		}
-		if (did_fail)
-			return 1;
+		monitor_dispatch(mfa);
+		log_sink_check(ctx);
+		if (did_fail) {
+			rc = 1;
+			goto out;
+		}
 	}
  out:
+	/* a worker failure is reported as the monitor's failure */
+	worker_rc = monitor_workers_stop(&workers);
+	if (!rc)
+		rc = worker_rc;
+	if (worker_failfd >= 0) {
+		close(worker_failfd);
+		worker_failfd = -1;
+	}
+	if (pollfd >= 0)
+		close(pollfd);
 	free(events);
 	return rc;
 }
@@ -430,7 +1677,9 @@ static void monitor_enable_all_events(struct monitor *_monitor)
 			| ND_EVENT_MEDIA_TEMPERATURE
 			| ND_EVENT_CTRL_TEMPERATURE
 			| ND_EVENT_HEALTH_STATE
-			| ND_EVENT_UNCLEAN_SHUTDOWN;
+			| ND_EVENT_UNCLEAN_SHUTDOWN
+			| MONITOR_EVENT_REGION_BADBLOCKS
+			| MONITOR_EVENT_BUS_SCRUB;
 }
 
 static int parse_monitor_event(struct monitor *_monitor, struct ndctl_ctx *ctx)
@@ -464,6 +1713,10 @@ static int parse_monitor_event(struct monitor *_monitor, struct ndctl_ctx *ctx)
 			_monitor->event_flags |= ND_EVENT_HEALTH_STATE;
 		else if (strcmp(event, "dimm-unclean-shutdown") == 0)
 			_monitor->event_flags |= ND_EVENT_UNCLEAN_SHUTDOWN;
+		else if (strcmp(event, "region-badblocks") == 0)
+			_monitor->event_flags |= MONITOR_EVENT_REGION_BADBLOCKS;
+		else if (strcmp(event, "bus-scrub") == 0)
+			_monitor->event_flags |= MONITOR_EVENT_BUS_SCRUB;
 		else {
 			err(ctx, "no dimm-event named %s\n", event);
 			rc = -EINVAL;
@@ -476,6 +1729,86 @@ out:
 	return rc;
 }
 
+static int parse_monitor_limits(struct monitor *_monitor,
+		struct ndctl_ctx *ctx)
+{
+	char *end;
+
+	if (_monitor->coalesce) {
+		_monitor->coalesce_msec = strtoul(_monitor->coalesce, &end, 0);
+		if (end == _monitor->coalesce || *end) {
+			err(ctx, "invalid coalesce: %s\n", _monitor->coalesce);
+			return -EINVAL;
+		}
+	}
+
+	if (_monitor->rate_limit) {
+		char c;
+
+		if (sscanf(_monitor->rate_limit, "%u/%u%c",
+					&_monitor->rate_count,
+					&_monitor->rate_sec, &c) != 2
+				|| !_monitor->rate_count || !_monitor->rate_sec) {
+			err(ctx, "invalid rate-limit: %s\n",
+					_monitor->rate_limit);
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+static int parse_monitor_poll(struct monitor *_monitor, struct ndctl_ctx *ctx)
+{
+	char *poll_delta, *save, *end;
+	const char *delta;
+	int i, rc = 0;
+
+	if (!_monitor->poll)
+		return 0;
+
+	_monitor->poll_msec = strtoul(_monitor->poll, &end, 0) * 1000;
+	if (end == _monitor->poll || *end || !_monitor->poll_msec) {
+		err(ctx, "invalid poll interval: %s\n", _monitor->poll);
+		return -EINVAL;
+	}
+
+	if (!_monitor->poll_delta) {
+		for (i = 0; i < SAMPLE_MAX; i++)
+			_monitor->delta[i] = sample_info[i].delta;
+		return 0;
+	}
+
+	poll_delta = strdup(_monitor->poll_delta);
+	if (!poll_delta)
+		return -ENOMEM;
+
+	for (delta = strtok_r(poll_delta, " ,", &save); delta;
+			delta = strtok_r(NULL, " ,", &save)) {
+		const char *sep = strchr(delta, ':');
+		double val;
+
+		for (i = 0; i < SAMPLE_MAX; i++)
+			if (sep && strncmp(delta, sample_info[i].name,
+						sep - delta) == 0
+					&& !sample_info[i].name[sep - delta])
+				break;
+		if (i < SAMPLE_MAX) {
+			val = strtod(sep + 1, &end);
+			if (end != sep + 1 && !*end && val > 0) {
+				_monitor->delta[i] = val;
+				continue;
+			}
+		}
+		err(ctx, "invalid poll-delta: %s\n", delta);
+		rc = -EINVAL;
+		break;
+	}
+
+	free(poll_delta);
+	return rc;
+}
+
 static void parse_config(const char **arg, char *key, char *val, char *ident)
 {
 	struct strbuf value = STRBUF_INIT;
@@ -569,9 +1902,21 @@ static int read_config_file(struct ndctl_ctx *ctx, struct monitor *_monitor,
 		parse_config(&_param->region, "region", value, seek);
 		parse_config(&_param->namespace, "namespace", value, seek);
 		parse_config(&_monitor->dimm_event, "dimm-event", value, seek);
+		parse_config(&_monitor->poll_delta, "poll-delta", value, seek);
 
 		if (!_monitor->log)
 			parse_config(&_monitor->log, "log", value, seek);
+		if (!_monitor->coalesce)
+			parse_config(&_monitor->coalesce, "coalesce", value,
+					seek);
+		if (!_monitor->rate_limit)
+			parse_config(&_monitor->rate_limit, "rate-limit",
+					value, seek);
+		if (!_monitor->poll)
+			parse_config(&_monitor->poll, "poll", value, seek);
+		if (!_monitor->event_ring)
+			parse_config(&_monitor->event_ring, "event-ring", value,
+					seek);
 	}
 	fclose(f);
 out:
@@ -595,6 +1940,18 @@ int cmd_monitor(int argc, const char **argv, void *ctx)
 		OPT_FILENAME('l', "log", &monitor.log,
 				"<file> | syslog | standard",
 				"where to output the monitor's notification"),
+		OPT_STRING(0, "coalesce", &monitor.coalesce, "msec",
+				"merge a dimm's events within a time window"),
+		OPT_STRING(0, "rate-limit", &monitor.rate_limit,
+				"count/seconds",
+				"limit notifications per dimm"),
+		OPT_STRING(0, "poll", &monitor.poll, "seconds",
+				"sample dimm smart data at an interval"),
+		OPT_STRING(0, "poll-delta", &monitor.poll_delta,
+				"name:delta",
+				"smart value changes to notify when polling"),
+		OPT_FILENAME(0, "event-ring", &monitor.event_ring, "file",
+				"publish binary dimm event records to <file>"),
 		OPT_FILENAME('c', "config-file", &monitor.config_file,
 				"config-file", "override the default config"),
 		OPT_BOOLEAN('\0', "daemon", &monitor.daemon,
@@ -613,7 +1970,6 @@ int cmd_monitor(int argc, const char **argv, void *ctx)
 	struct util_filter_ctx fctx = { 0 };
 	struct monitor_filter_arg mfa = { 0 };
 	int i, rc;
-	FILE *f;
 
 	argc = parse_options_prefix(argc, argv, prefix, options, u, 0);
 	for (i = 0; i < argc; i++) {
@@ -642,17 +1998,26 @@ int cmd_monitor(int argc, const char **argv, void *ctx)
 		else if (strncmp(monitor.log, "./standard", 10) == 0)
 			; /*default, already set */
 		else {
-			f = fopen(monitor.log, "a+");
-			if (!f) {
-				error("open %s failed\n", monitor.log);
-				rc = -errno;
+			rc = log_sink_init();
+			if (rc) {
+				error("open %s failed: %s\n", monitor.log,
+						strerror(-rc));
 				goto out;
 			}
-			fclose(f);
 			ndctl_set_log_fn((struct ndctl_ctx *)ctx, log_file);
 		}
 	}
 
+	if (monitor.event_ring) {
+		monitor.ring = ndctl_event_ring_new((struct ndctl_ctx *)ctx,
+				monitor.event_ring, 0);
+		if (!monitor.ring) {
+			error("create %s failed\n", monitor.event_ring);
+			rc = -ENXIO;
+			goto out;
+		}
+	}
+
 	if (monitor.daemon) {
 		if (!monitor.log || strncmp(monitor.log, "./", 2) == 0)
 			ndctl_set_log_fn((struct ndctl_ctx *)ctx, log_syslog);
@@ -666,13 +2031,25 @@ int cmd_monitor(int argc, const char **argv, void *ctx)
 	if (parse_monitor_event(&monitor, (struct ndctl_ctx *)ctx))
 		goto out;
 
+	rc = parse_monitor_limits(&monitor, (struct ndctl_ctx *)ctx);
+	if (rc)
+		goto out;
+
+	rc = parse_monitor_poll(&monitor, (struct ndctl_ctx *)ctx);
+	if (rc)
+		goto out;
+
 	fctx.filter_bus = filter_bus;
 	fctx.filter_dimm = filter_dimm;
 	fctx.filter_region = filter_region;
 	fctx.filter_namespace = NULL;
 	fctx.arg = &mfa;
 	list_head_init(&mfa.dimms);
+	list_head_init(&mfa.regions);
+	list_head_init(&mfa.busses);
 	mfa.num_dimm = 0;
+	mfa.num_region = 0;
+	mfa.num_bus = 0;
 	mfa.maxfd_dimm = -1;
 	mfa.flags = 0;
 
@@ -680,8 +2057,8 @@ int cmd_monitor(int argc, const char **argv, void *ctx)
 	if (rc)
 		goto out;
 
-	if (!mfa.num_dimm) {
-		dbg((struct ndctl_ctx *)ctx, "no dimms to monitor\n");
+	if (!mfa.num_dimm && !mfa.num_region && !mfa.num_bus) {
+		dbg((struct ndctl_ctx *)ctx, "nothing to monitor\n");
 		if (!monitor.daemon)
 			rc = -ENXIO;
 		goto out;
@@ -689,5 +2066,7 @@ int cmd_monitor(int argc, const char **argv, void *ctx)
 
 	rc = monitor_event(ctx, &mfa);
 out:
+	ndctl_event_ring_close(monitor.ring);
+	log_sink_close((struct ndctl_ctx *)ctx);
 	return rc;
 }
@@ -18,9 +18,11 @@
 #include <unistd.h>
 #include <limits.h>
 #include <syslog.h>
+#include <pthread.h>
 
 #include <ndctl.h>
 #include "action.h"
+#include <builtin.h>
 #include <sys/stat.h>
 #include <uuid/uuid.h>
 #include <sys/types.h>
@@ -36,6 +38,8 @@ static bool verbose;
 static bool force;
 static bool repair;
 static bool logfix;
+/* namespaces set up by this command, displayed once it completes */
+static struct json_object *jnamespaces;
 static struct parameters {
 	bool do_scan;
 	bool mode_default;
@@ -52,6 +56,9 @@ static struct parameters {
 	const char *reconfig;
 	const char *sector_size;
 	const char *align;
+	const char *numa_node;
+	unsigned int count;
+	bool plan;
 } param = {
 	.autolabel = true,
 };
@@ -65,7 +72,10 @@ void builtin_xaction_namespace_reset(void)
 	 */
 	verbose = false;
 	force = false;
+	repair = false;
+	logfix = false;
 	memset(&param, 0, sizeof(param));
+	param.autolabel = true;
 }
 
 #define NSLABEL_NAME_LEN 64
@@ -114,7 +124,13 @@ OPT_STRING('t', "type", &param.type, "type", \
 OPT_STRING('a', "align", &param.align, "align", \
 	"specify the namespace alignment in bytes (default: 2M)"), \
 OPT_BOOLEAN('f', "force", &force, "reconfigure namespace even if currently active"), \
-OPT_BOOLEAN('L', "autolabel", &param.autolabel, "automatically initialize labels")
+OPT_BOOLEAN('L', "autolabel", &param.autolabel, "automatically initialize labels"), \
+OPT_UINTEGER('c', "count", &param.count, \
+	"create <count> namespaces of equal size in one region"), \
+OPT_BOOLEAN('P', "plan", &param.plan, \
+	"report the planned namespace layout without creating it"), \
+OPT_STRING('U', "numa-node", &param.numa_node, "numa node", \
+	"create in a region local to <numa node>, or 'all' for one per node")
 
 #define CHECK_OPTIONS() \
 OPT_BOOLEAN('R', "repair", &repair, "perform metadata repairs"), \
@@ -240,6 +256,34 @@ static int set_defaults(enum device_action mode)
 		}
 	}
 
+	/* param.mode is resolved by now, a pmem create defaults to fsdax */
+	if (param.plan && param.reconfig) {
+		error("--plan is not valid with --reconfig\n");
+		rc = -EINVAL;
+	} else if (param.plan && (!param.mode
+				|| (strcmp(param.mode, "memory") != 0
+					&& strcmp(param.mode, "dax") != 0))) {
+		error("--plan only valid for an fsdax or devdax mode pmem namespace\n");
+		rc = -EINVAL;
+	}
+
+	if (param.numa_node && param.reconfig) {
+		error("--numa-node is not valid with --reconfig\n");
+		rc = -EINVAL;
+	} else if (param.numa_node && param.uuid
+			&& strcmp(param.numa_node, "all") == 0) {
+		error("--numa-node=all is not valid with --uuid\n");
+		rc = -EINVAL;
+	}
+
+	if (param.count > 1 && param.reconfig) {
+		error("--count is not valid with --reconfig\n");
+		rc = -EINVAL;
+	} else if (param.count > 1 && param.uuid) {
+		error("--count is not valid with --uuid\n");
+		rc = -EINVAL;
+	}
+
 	if (param.sector_size) {
 		if (parse_size64(param.sector_size) == ULLONG_MAX) {
 			error("invalid sector size: %s\n", param.sector_size);
@@ -430,13 +474,39 @@ static int setup_namespace(struct ndctl_region *region,
 		if (isatty(1))
 			flags |= UTIL_JSON_HUMAN;
 		jndns = util_namespace_to_json(ndns, flags);
-		if (jndns)
-			printf("%s\n", json_object_to_json_string_ext(jndns,
-						JSON_C_TO_STRING_PRETTY));
+		if (!jnamespaces)
+			jnamespaces = json_object_new_array();
+		if (jndns && jnamespaces)
+			json_object_array_add(jnamespaces, jndns);
+		else if (jndns)
+			json_object_put(jndns);
 	}
 	return rc;
 }
 
+/*
+ * A single namespace is displayed as an object, as it always has been,
+ * several (--count or --numa-node=all) as one array like 'ndctl list'.
+ */
+static void display_namespaces(void)
+{
+	struct json_object *jndns;
+
+	if (!jnamespaces)
+		return;
+
+	if (json_object_array_length(jnamespaces) == 1) {
+		jndns = json_object_array_get_idx(jnamespaces, 0);
+		printf("%s\n", json_object_to_json_string_ext(jndns,
+					JSON_C_TO_STRING_PRETTY));
+		json_object_put(jnamespaces);
+	} else if (json_object_array_length(jnamespaces) > 1)
+		util_display_json_array(stdout, jnamespaces, 0);
+	else
+		json_object_put(jnamespaces);
+	jnamespaces = NULL;
+}
+
 static int is_namespace_active(struct ndctl_namespace *ndns)
 {
 	return ndns && (ndctl_namespace_is_enabled(ndns)
@@ -747,11 +817,254 @@ static struct ndctl_namespace *region_get_namespace(struct ndctl_region *region)
 	return ndctl_region_get_namespace_seed(region);
 }
 
-static int namespace_create(struct ndctl_region *region)
+#define PFN_INFO_SIZE SZ_8K
+#define PFN_PAGE_META 64
+
+struct namespace_plan {
+	unsigned long long start, size, offset, usable;
+	unsigned long map_align;
+};
+
+/*
+ * Mirror the kernel's pfn / dax device layout: an info block, with
+ * --map=dev followed by a struct page per 4K page of the namespace, and
+ * data from the next @align boundary up to the last one. The data can
+ * be mapped with pages as large as its start is aligned for, up to the
+ * device alignment for devdax.
+ */
+static void plan_layout(struct namespace_plan *plan,
+		struct parsed_parameters *p)
+{
+	unsigned long long meta = PFN_INFO_SIZE, end, data;
+
+	if (plan->size <= meta) {
+		plan->offset = plan->size;
+		plan->usable = 0;
+		plan->map_align = SZ_4K;
+		return;
+	}
+	if (p->loc == NDCTL_PFN_LOC_PMEM)
+		meta += PFN_PAGE_META * ((plan->size - PFN_INFO_SIZE) / SZ_4K);
+	plan->offset = ALIGN(plan->start + meta, p->align) - plan->start;
+	data = plan->start + plan->offset;
+	end = ALIGN_DOWN(plan->start + plan->size, p->align);
+	plan->usable = end > data ? end - data : 0;
+
+	if (p->mode == NDCTL_NS_MODE_DAX)
+		plan->map_align = p->align;
+	else if (data % SZ_1G == 0)
+		plan->map_align = SZ_1G;
+	else if (data % SZ_2M == 0)
+		plan->map_align = SZ_2M;
+	else
+		plan->map_align = SZ_4K;
+}
+
+/*
+ * Place @count namespaces of @size in the free ranges of @region the way
+ * the kernel allocates them, each at the start of the first free range
+ * large enough, and lay them out. Returns the number placed.
+ */
+static int plan_place(struct ndctl_region *region,
+		struct parsed_parameters *p, unsigned long long size,
+		unsigned int count, struct namespace_plan *plans)
+{
+	int i, nr = ndctl_region_get_num_free_extents(region);
+	unsigned long long *start, *len;
+	unsigned int placed = 0;
+
+	if (nr <= 0)
+		return 0;
+	start = calloc(nr, sizeof(*start));
+	len = calloc(nr, sizeof(*len));
+	if (!start || !len)
+		goto out;
+
+	for (i = 0; i < nr; i++)
+		if (ndctl_region_get_free_extent(region, i, &start[i],
+					&len[i]) < 0)
+			goto out;
+
+	for (i = 0; i < nr && placed < count; i++)
+		while (len[i] >= size && placed < count) {
+			plans[placed].start = start[i];
+			plans[placed].size = size;
+			plan_layout(&plans[placed++], p);
+			start[i] += size;
+			len[i] -= size;
+		}
+ out:
+	free(start);
+	free(len);
+	return placed;
+}
+
+static struct json_object *plan_to_json(struct ndctl_region *region,
+		struct namespace_plan *plan, unsigned long flags)
+{
+	struct json_object *jplan = json_object_new_object();
+	struct json_object *jobj;
+
+	if (!jplan)
+		return NULL;
+
+	jobj = json_object_new_string(ndctl_region_get_devname(region));
+	if (jobj)
+		json_object_object_add(jplan, "region", jobj);
+	jobj = util_json_object_hex(plan->start, flags);
+	if (jobj)
+		json_object_object_add(jplan, "start", jobj);
+	jobj = util_json_object_size(plan->size, flags);
+	if (jobj)
+		json_object_object_add(jplan, "size", jobj);
+	jobj = util_json_object_size(plan->offset, flags);
+	if (jobj)
+		json_object_object_add(jplan, "data_offset", jobj);
+	jobj = util_json_object_size(plan->usable, flags);
+	if (jobj)
+		json_object_object_add(jplan, "usable", jobj);
+	jobj = util_json_object_size(plan->map_align, flags);
+	if (jobj)
+		json_object_object_add(jplan, "map_align", jobj);
+	return jplan;
+}
+
+/*
+ * plan_namespaces - lay out fsdax / devdax namespaces before creating them
+ *
+ * When the size is left to ndctl and one namespace is requested, each
+ * free range of the region suggests a size that ends on an alignment
+ * boundary. The size that leaves the most capacity mappable with 1G
+ * pages wins, then the one with the most usable capacity, then the
+ * smaller one, which leaves more of the region free. The chosen layout is
+ * reported with --plan (in place of creating the namespaces) or
+ * --verbose. Regions whose free ranges are unknown are left to the
+ * kernel.
+ */
+static int plan_namespaces(struct ndctl_region *region,
+		struct parsed_parameters *p, unsigned int count)
+{
+	int i, nr = ndctl_region_get_num_free_extents(region);
+	unsigned long long granule, best_huge = 0, best_usable = 0;
+	unsigned long long best_size = 0;
+	unsigned long flags = isatty(1) ? UTIL_JSON_HUMAN : 0;
+	struct namespace_plan *plans;
+	struct json_object *jplans;
+	int rc = 0;
+
+	if (p->mode != NDCTL_NS_MODE_MEMORY && p->mode != NDCTL_NS_MODE_DAX) {
+		/* a defaulted fsdax mode falls back to raw without pfn */
+		if (param.plan)
+			debug("%s: only fsdax and devdax namespaces are planned\n",
+					ndctl_region_get_devname(region));
+		return param.plan ? -EAGAIN : 0;
+	}
+	if (nr <= 0) {
+		debug("%s: free ranges unknown\n",
+				ndctl_region_get_devname(region));
+		return param.plan ? -EAGAIN : 0;
+	}
+
+	plans = calloc(count, sizeof(*plans));
+	if (!plans)
+		return -ENOMEM;
+
+	granule = p->align * ndctl_region_get_interleave_ways(region);
+	for (i = 0; !param.size && count == 1 && i < nr; i++) {
+		unsigned long long start, len, size, huge;
+
+		if (ndctl_region_get_free_extent(region, i, &start, &len) < 0)
+			goto out;
+		size = ALIGN_DOWN(start + len, p->align) - start;
+		size -= size % granule;
+		if (!size || !plan_place(region, p, size, 1, plans))
+			continue;
+		huge = 0;
+		if (plans[0].map_align >= SZ_1G)
+			huge = ALIGN_DOWN(plans[0].usable, SZ_1G);
+		if (!best_size || huge > best_huge || (huge == best_huge
+					&& (plans[0].usable > best_usable
+					|| (plans[0].usable == best_usable
+						&& size < best_size)))) {
+			best_huge = huge;
+			best_usable = plans[0].usable;
+			best_size = size;
+		}
+	}
+	if (best_size)
+		p->size = best_size;
+
+	if (plan_place(region, p, p->size, count, plans) < (int) count) {
+		debug("%s: can not place %u namespaces of size: %llx\n",
+				ndctl_region_get_devname(region), count,
+				p->size);
+		if (param.plan)
+			rc = -EAGAIN;
+		goto out;
+	}
+
+	for (i = 0; i < (int) count; i++)
+		debug("%s: start: %llx size: %llx data: %llx usable: %llx map: %lx\n",
+				ndctl_region_get_devname(region),
+				plans[i].start, plans[i].size,
+				plans[i].offset, plans[i].usable,
+				plans[i].map_align);
+	if (!param.plan)
+		goto out;
+
+	jplans = json_object_new_array();
+	if (!jplans) {
+		rc = -ENOMEM;
+		goto out;
+	}
+	for (i = 0; i < (int) count; i++) {
+		struct json_object *jplan;
+
+		jplan = plan_to_json(region, &plans[i], flags);
+		if (jplan)
+			json_object_array_add(jplans, jplan);
+	}
+	util_display_json_array(stdout, jplans, flags);
+ out:
+	free(plans);
+	return rc;
+}
+
+static int namespace_destroy(struct ndctl_region *region,
+		struct ndctl_namespace *ndns);
+
+/* destroy the @nr namespaces of @ndns that a failed --count just enabled */
+static void namespace_rollback(struct ndctl_region *region,
+		struct ndctl_namespace **ndns, unsigned int nr)
+{
+	bool save_force = force;
+	int rc;
+
+	force = true;
+	while (nr--) {
+		rc = namespace_destroy(region, ndns[nr]);
+		if (rc < 0)
+			error("%s: failed to roll back: %s\n",
+					ndctl_namespace_get_devname(ndns[nr]),
+					strerror(-rc));
+	}
+	force = save_force;
+}
+
+/*
+ * With --count, all the namespaces are sized up front so that a region
+ * that can not hold all of them is skipped rather than left partially
+ * provisioned. They are then set up in turn, each consuming the seed
+ * devices that enabling the previous one creates. If one of them fails,
+ * the ones already created are destroyed again.
+ */
+static int namespace_create(struct ndctl_region *region, int *created)
 {
 	const char *devname = ndctl_region_get_devname(region);
-	unsigned long long available;
-	struct ndctl_namespace *ndns;
+	unsigned int i, count = max(param.count, 1U);
+	unsigned long long available, size_align;
+	struct json_object *jsaved = jnamespaces;
+	struct ndctl_namespace *ndns, **ndns_created;
 	struct parsed_parameters p;
 	int rc;
 
@@ -765,26 +1078,86 @@ static int namespace_create(struct ndctl_region *region)
 		return -EAGAIN;
 	}
 
-	available = ndctl_region_get_max_available_extent(region);
-	if (available == ULLONG_MAX)
-		available = ndctl_region_get_available_size(region);
-	if (!available || p.size > available) {
-		debug("%s: insufficient capacity size: %llx avail: %llx\n",
-			devname, p.size, available);
-		return -EAGAIN;
+	if (count > 1) {
+		if (p.mode == NDCTL_NS_MODE_MEMORY
+				|| p.mode == NDCTL_NS_MODE_DAX)
+			size_align = p.align;
+		else
+			size_align = SZ_4K;
+		rc = ndctl_region_plan_namespaces(region, count, size_align,
+				&p.size);
+		if (rc) {
+			debug("%s: can not fit %u namespaces: %s\n", devname,
+					count, strerror(-rc));
+			return -EAGAIN;
+		}
+		debug("%s: creating %u namespaces of size: %llx\n", devname,
+				count, p.size);
+	} else {
+		available = ndctl_region_get_max_available_extent(region);
+		if (available == ULLONG_MAX)
+			available = ndctl_region_get_available_size(region);
+		if (!available || p.size > available) {
+			debug("%s: insufficient capacity size: %llx avail: %llx\n",
+				devname, p.size, available);
+			return -EAGAIN;
+		}
+
+		if (p.size == 0)
+			p.size = available;
 	}
 
-	if (p.size == 0)
-		p.size = available;
+	if (ndctl_region_get_type(region) == ND_DEVICE_REGION_PMEM) {
+		rc = plan_namespaces(region, &p, count);
+		if (rc || param.plan)
+			return rc;
+	}
 
-	ndns = region_get_namespace(region);
-	if (!ndns || is_namespace_active(ndns)) {
-		debug("%s: no %s namespace seed\n", devname,
-				ndns ? "idle" : "available");
-		return -ENODEV;
+	ndns_created = calloc(count, sizeof(*ndns_created));
+	if (!ndns_created)
+		return -ENOMEM;
+
+	/* only list the namespaces of this region once all are created */
+	jnamespaces = NULL;
+	for (i = 0; i < count; i++) {
+		ndns = region_get_namespace(region);
+		if (!ndns || is_namespace_active(ndns)) {
+			debug("%s: no %s namespace seed\n", devname,
+					ndns ? "idle" : "available");
+			rc = -ENODEV;
+			break;
+		}
+
+		if (i)
+			uuid_generate(p.uuid);
+		rc = setup_namespace(region, ndns, &p);
+		if (rc)
+			break;
+		ndns_created[i] = ndns;
 	}
 
-	return setup_namespace(region, ndns, &p);
+	if (rc) {
+		if (i) {
+			error("%s: failed to create namespace %u of %u, removing the others\n",
+					devname, i + 1, count);
+			namespace_rollback(region, ndns_created, i);
+		}
+		json_object_put(jnamespaces);
+		jnamespaces = jsaved;
+	} else {
+		*created += count;
+		if (jsaved) {
+			for (i = 0; i < json_object_array_length(jnamespaces);
+					i++)
+				json_object_array_add(jsaved, json_object_get(
+						json_object_array_get_idx(
+							jnamespaces, i)));
+			json_object_put(jnamespaces);
+			jnamespaces = jsaved;
+		}
+	}
+	free(ndns_created);
+	return rc;
 }
 
 /*
@@ -793,51 +1166,45 @@ static int namespace_create(struct ndctl_region *region)
  * rc == 0 : Successfully cleared the info block, report as destroyed
  * rc > 0 : skipped, do not count
  */
-static int zero_info_block(struct ndctl_namespace *ndns)
+#define INFO_BLOCK_SIZE 8192
+
+/*
+ * Zero the info block at the start of the raw block device at @path.
+ * Returns 0 if it was zeroed, 1 if there was nothing to zero.
+ */
+static int info_block_zero_io(const char *devname, const char *path)
 {
-	const char *devname = ndctl_namespace_get_devname(ndns);
-	int fd, rc = -ENXIO, info_size = 8192;
 	void *buf = NULL, *read_buf = NULL;
-	char path[50];
-
-	ndctl_namespace_set_raw_mode(ndns, 1);
-	rc = ndctl_namespace_enable(ndns);
-	if (rc < 0) {
-		debug("%s failed to enable for zeroing, continuing\n", devname);
-		rc = 1;
-		goto out;
-	}
+	int fd, rc;
 
-	if (posix_memalign(&buf, 4096, info_size) != 0) {
-		rc = -ENOMEM;
-		goto out;
-	}
-	if (posix_memalign(&read_buf, 4096, info_size) != 0) {
+	if (posix_memalign(&buf, 4096, INFO_BLOCK_SIZE) != 0)
+		return -ENOMEM;
+	if (posix_memalign(&read_buf, 4096, INFO_BLOCK_SIZE) != 0) {
 		rc = -ENOMEM;
 		goto out;
 	}
 
-	sprintf(path, "/dev/%s", ndctl_namespace_get_block_device(ndns));
 	fd = open(path, O_RDWR|O_DIRECT|O_EXCL);
 	if (fd < 0) {
 		debug("%s: failed to open %s to zero info block\n",
 				devname, path);
+		rc = 1;
 		goto out;
 	}
 
-	memset(buf, 0, info_size);
-	rc = pread(fd, read_buf, info_size, 0);
-	if (rc < info_size) {
+	memset(buf, 0, INFO_BLOCK_SIZE);
+	rc = pread(fd, read_buf, INFO_BLOCK_SIZE, 0);
+	if (rc < INFO_BLOCK_SIZE) {
 		debug("%s: failed to read info block, continuing\n",
 			devname);
 	}
-	if (memcmp(buf, read_buf, info_size) == 0) {
+	if (memcmp(buf, read_buf, INFO_BLOCK_SIZE) == 0) {
 		rc = 1;
 		goto out_close;
 	}
 
-	rc = pwrite(fd, buf, info_size, 0);
-	if (rc < info_size) {
+	rc = pwrite(fd, buf, INFO_BLOCK_SIZE, 0);
+	if (rc < INFO_BLOCK_SIZE) {
 		debug("%s: failed to zero info block %s\n",
 				devname, path);
 		rc = -ENXIO;
@@ -846,21 +1213,44 @@ static int zero_info_block(struct ndctl_namespace *ndns)
  out_close:
 	close(fd);
  out:
-	ndctl_namespace_set_raw_mode(ndns, 0);
-	ndctl_namespace_disable_invalidate(ndns);
 	free(read_buf);
 	free(buf);
 	return rc;
 }
 
-static int namespace_destroy(struct ndctl_region *region,
+static int zero_info_block(struct ndctl_namespace *ndns)
+{
+	const char *devname = ndctl_namespace_get_devname(ndns);
+	char path[50];
+	int rc;
+
+	ndctl_namespace_set_raw_mode(ndns, 1);
+	rc = ndctl_namespace_enable(ndns);
+	if (rc < 0) {
+		debug("%s failed to enable for zeroing, continuing\n", devname);
+		rc = 1;
+		goto out;
+	}
+
+	sprintf(path, "/dev/%s", ndctl_namespace_get_block_device(ndns));
+	rc = info_block_zero_io(devname, path);
+ out:
+	ndctl_namespace_set_raw_mode(ndns, 0);
+	ndctl_namespace_disable_invalidate(ndns);
+	return rc;
+}
+
+/*
+ * Quiesce @ndns for destruction, returns 1 if it has an info block
+ * (btt, pfn, or dax) to zero before its capacity is released.
+ */
+static int namespace_destroy_prepare(struct ndctl_region *region,
 		struct ndctl_namespace *ndns)
 {
 	const char *devname = ndctl_namespace_get_devname(ndns);
 	struct ndctl_pfn *pfn = ndctl_namespace_get_pfn(ndns);
 	struct ndctl_dax *dax = ndctl_namespace_get_dax(ndns);
 	struct ndctl_btt *btt = ndctl_namespace_get_btt(ndns);
-	bool did_zero = false;
 	int rc;
 
 	if (ndctl_region_get_ro(region)) {
@@ -881,13 +1271,14 @@ static int namespace_destroy(struct ndctl_region *region,
 
 	ndctl_namespace_set_enforce_mode(ndns, NDCTL_NS_MODE_RAW);
 
-	if (pfn || btt || dax) {
-		rc = zero_info_block(ndns);
-		if (rc < 0)
-			return rc;
-		if (rc == 0)
-			did_zero = true;
-	}
+	return pfn || btt || dax;
+}
+
+static int namespace_destroy_finish(struct ndctl_namespace *ndns,
+		bool did_zero)
+{
+	const char *devname = ndctl_namespace_get_devname(ndns);
+	int rc;
 
 	switch (ndctl_namespace_get_type(ndns)) {
         case ND_DEVICE_NAMESPACE_PMEM:
@@ -900,17 +1291,191 @@ static int namespace_destroy(struct ndctl_region *region,
 		 * but otherwise we are skipping in the count
 		 */
 		if (did_zero)
-			rc = 0;
-		else
-			rc = 1;
-		goto out;
+			return 0;
+		return 1;
 	}
 
 	rc = ndctl_namespace_delete(ndns);
 	if (rc)
 		debug("%s: failed to reclaim\n", devname);
+	return rc;
+}
 
-out:
+static int namespace_destroy(struct ndctl_region *region,
+		struct ndctl_namespace *ndns)
+{
+	bool did_zero = false;
+	int rc;
+
+	rc = namespace_destroy_prepare(region, ndns);
+	if (rc < 0)
+		return rc;
+
+	if (rc) {
+		rc = zero_info_block(ndns);
+		if (rc < 0)
+			return rc;
+		if (rc == 0)
+			did_zero = true;
+	}
+
+	return namespace_destroy_finish(ndns, did_zero);
+}
+
+/* concurrent info block writers for a batched destroy */
+#define INFO_WIPE_THREADS 16
+
+/**
+ * struct destroy_target - one namespace of a batched destroy
+ * @region: region of @ndns, for finding the targets of a region_job
+ * @ndns: namespace to destroy
+ * @path: raw block device of @ndns while its info block is zeroed
+ * @rc: result of destroying @ndns so far
+ * @zero_rc: result of zeroing the info block, 1 when not zeroed
+ * @raw: @ndns was put in raw mode to zero its info block
+ * @wipe: @ndns is enabled in raw mode with @path to zero
+ */
+struct destroy_target {
+	struct ndctl_region *region;
+	struct ndctl_namespace *ndns;
+	char path[50];
+	int rc, zero_rc;
+	bool raw, wipe;
+};
+
+struct destroy_namespaces {
+	struct destroy_target *targets;
+	int count, next;
+};
+
+static void destroy_enable_job(struct region_job *job, void *arg)
+{
+	struct destroy_namespaces *d = arg;
+	int i, rc;
+
+	for (i = 0; i < d->count; i++) {
+		struct destroy_target *t = &d->targets[i];
+
+		if (t->region != job->region || t->rc <= 0)
+			continue;
+
+		t->raw = true;
+		ndctl_namespace_set_raw_mode(t->ndns, 1);
+		rc = ndctl_namespace_enable(t->ndns);
+		if (rc < 0)
+			debug("%s failed to enable for zeroing, continuing\n",
+					ndctl_namespace_get_devname(t->ndns));
+		else
+			t->wipe = true;
+	}
+}
+
+static void *destroy_wipe_worker(void *arg)
+{
+	struct destroy_namespaces *d = arg;
+	int i;
+
+	while ((i = __atomic_fetch_add(&d->next, 1, __ATOMIC_RELAXED))
+			< d->count) {
+		struct destroy_target *t = &d->targets[i];
+
+		if (t->wipe)
+			t->zero_rc = info_block_zero_io(
+					ndctl_namespace_get_devname(t->ndns),
+					t->path);
+	}
+	return NULL;
+}
+
+static void destroy_disable_job(struct region_job *job, void *arg)
+{
+	struct destroy_namespaces *d = arg;
+	int i;
+
+	for (i = 0; i < d->count; i++) {
+		struct destroy_target *t = &d->targets[i];
+
+		if (t->region != job->region || !t->raw)
+			continue;
+
+		ndctl_namespace_set_raw_mode(t->ndns, 0);
+		ndctl_namespace_disable_invalidate(t->ndns);
+	}
+}
+
+/*
+ * destroy_namespaces - destroy @targets with one pass of each step
+ *
+ * Rather than a raw mode enable, info block zeroing, and disable for
+ * one namespace after another, all of the namespaces with an info block
+ * are enabled in raw mode in one concurrent sweep (see
+ * region_jobs_run()), their info blocks are zeroed with concurrent
+ * writes, and they are disabled in a second concurrent sweep. The steps
+ * that update labels, quiescing and deleting, still run in turn. As when
+ * destroying them in turn, the result is that of the last namespace.
+ */
+static int destroy_namespaces(struct destroy_target *targets, int count,
+		int *processed)
+{
+	struct destroy_namespaces d = {
+		.targets = targets,
+		.count = count,
+	};
+	pthread_t threads[INFO_WIPE_THREADS];
+	int i, nr_jobs = 0, nr_wipe = 0, nr_threads = 0, rc = -ENXIO;
+	struct region_job *jobs;
+
+	jobs = calloc(count, sizeof(*jobs));
+	if (!jobs)
+		return -ENOMEM;
+	for (i = 0; i < count; i++) {
+		struct destroy_target *t = &targets[i];
+
+		t->zero_rc = 1;
+		t->rc = namespace_destroy_prepare(t->region, t->ndns);
+		if (!nr_jobs || jobs[nr_jobs - 1].region != t->region)
+			jobs[nr_jobs++].region = t->region;
+	}
+
+	region_jobs_run(jobs, nr_jobs, destroy_enable_job, &d);
+
+	/* probing was flushed above, look up the block devices up front */
+	for (i = 0; i < count; i++) {
+		struct destroy_target *t = &targets[i];
+
+		if (!t->wipe)
+			continue;
+		sprintf(t->path, "/dev/%s",
+				ndctl_namespace_get_block_device(t->ndns));
+		nr_wipe++;
+	}
+
+	while (nr_threads < min(nr_wipe, INFO_WIPE_THREADS) - 1
+			&& pthread_create(&threads[nr_threads], NULL,
+				destroy_wipe_worker, &d) == 0)
+		nr_threads++;
+	destroy_wipe_worker(&d);
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(threads[i], NULL);
+
+	region_jobs_run(jobs, nr_jobs, destroy_disable_job, &d);
+
+	for (i = 0; i < count; i++) {
+		struct destroy_target *t = &targets[i];
+
+		rc = t->rc;
+		if (rc >= 0)
+			rc = t->zero_rc < 0 ? t->zero_rc
+				: namespace_destroy_finish(t->ndns,
+						t->zero_rc == 0);
+		if (rc == 0)
+			(*processed)++;
+		/* return success if skipped */
+		if (rc > 0)
+			rc = 0;
+	}
+
+	free(jobs);
 	return rc;
 }
 
@@ -1032,15 +1597,196 @@ static int namespace_reconfig(struct ndctl_region *region,
 int namespace_check(struct ndctl_namespace *ndns, bool verbose, bool force,
 		bool repair, bool logfix);
 
+struct xable_namespaces {
+	struct util_filter *filter;
+	enum device_action action;
+};
+
+static void xable_namespace_job(struct region_job *job, void *arg)
+{
+	struct xable_namespaces *xable = arg;
+	struct ndctl_namespace *ndns, *_n;
+	int rc;
+
+	ndctl_namespace_foreach_safe(job->region, ndns, _n) {
+		if (!util_filter_match_namespace(xable->filter, ndns))
+			continue;
+		if (xable->action == ACTION_ENABLE) {
+			rc = ndctl_namespace_enable(ndns);
+			if (rc >= 0) {
+				job->processed++;
+				rc = 0;
+			}
+		} else {
+			rc = ndctl_namespace_disable_safe(ndns);
+			if (rc == 0)
+				job->processed++;
+		}
+		job->rc = rc;
+		job->acted = true;
+	}
+}
+
+/*
+ * Enable / disable the namespaces of the matching regions concurrently,
+ * see region_jobs_run(). As when acting on them in turn, the result is
+ * that of the last namespace acted on.
+ */
+static int xable_namespaces(struct region_job *jobs, int count,
+		struct util_filter *filter, enum device_action action,
+		int *processed)
+{
+	struct xable_namespaces xable = {
+		.filter = filter,
+		.action = action,
+	};
+	int i, rc = -ENXIO;
+
+	region_jobs_run(jobs, count, xable_namespace_job, &xable);
+	for (i = 0; i < count; i++) {
+		*processed += jobs[i].processed;
+		if (jobs[i].acted)
+			rc = jobs[i].rc;
+	}
+	return rc;
+}
+
+static bool region_match_type(struct ndctl_region *region)
+{
+	if (!param.type)
+		return true;
+	if (strcmp(param.type, "pmem") == 0)
+		return ndctl_region_get_type(region) == ND_DEVICE_REGION_PMEM;
+	if (strcmp(param.type, "blk") == 0)
+		return ndctl_region_get_type(region) == ND_DEVICE_REGION_BLK;
+	return false;
+}
+
+/* create in the first region that matches @filter and has the capacity */
+static int namespace_create_first(struct ndctl_ctx *ctx,
+		struct util_filter *filter, int *created)
+{
+	struct ndctl_region *region;
+	struct ndctl_bus *bus;
+	int rc = -ENXIO;
+
+	ndctl_bus_foreach(ctx, bus) {
+		if (!util_filter_match_bus(filter, bus))
+			continue;
+
+		ndctl_region_foreach(bus, region) {
+			if (!util_filter_match_region(filter, region))
+				continue;
+			if (!region_match_type(region))
+				continue;
+
+			rc = namespace_create(region, created);
+			if (rc != -EAGAIN)
+				return rc;
+		}
+	}
+
+	return rc;
+}
+
+static int cmp_node(const void *a, const void *b)
+{
+	return *(const int *) a - *(const int *) b;
+}
+
+/*
+ * namespace_create_per_node - create in a region local to each numa node
+ *
+ * Every numa node that has a region matching @filter gets its own
+ * namespace(s), placed in the first local region with the capacity. A
+ * node that can not be provisioned does not stop the others.
+ */
+static int namespace_create_per_node(struct ndctl_ctx *ctx,
+		struct util_filter *filter, int *created)
+{
+	unsigned int count = max(param.count, 1U);
+	int i, rc = 0, nr = 0, *nodes = NULL, *n;
+	struct ndctl_region *region;
+	struct ndctl_bus *bus;
+
+	ndctl_bus_foreach(ctx, bus) {
+		if (!util_filter_match_bus(filter, bus))
+			continue;
+
+		ndctl_region_foreach(bus, region) {
+			int node = ndctl_region_get_numa_node(region);
+
+			if (!util_filter_match_region(filter, region))
+				continue;
+			if (!region_match_type(region))
+				continue;
+			if (node < 0) {
+				debug("%s: no numa node, skipping\n",
+						ndctl_region_get_devname(region));
+				continue;
+			}
+
+			for (i = 0; i < nr; i++)
+				if (nodes[i] == node)
+					break;
+			if (i < nr)
+				continue;
+			n = realloc(nodes, (nr + 1) * sizeof(*nodes));
+			if (!n) {
+				free(nodes);
+				return -ENOMEM;
+			}
+			nodes = n;
+			nodes[nr++] = node;
+		}
+	}
+
+	if (!nr) {
+		error("no regions with a numa node found\n");
+		return -ENXIO;
+	}
+	qsort(nodes, nr, sizeof(*nodes), cmp_node);
+
+	for (i = 0; i < nr; i++) {
+		int node_rc, node_created = 0;
+
+		filter->numa_node = nodes[i];
+		node_rc = namespace_create_first(ctx, filter, &node_created);
+		*created += node_created;
+		if (node_rc < 0 || (!param.plan
+					&& node_created < (int) count)) {
+			error("numa node %d: created %d of %u namespace%s%s%s\n",
+					nodes[i], node_created, count,
+					count == 1 ? "" : "s",
+					node_rc < 0 ? ": " : "",
+					node_rc < 0 ? strerror(-node_rc) : "");
+			if (!rc)
+				rc = node_rc < 0 ? node_rc : -ENOSPC;
+		}
+	}
+	filter->numa_node = NUMA_NO_NODE;
+
+	free(nodes);
+	return rc;
+}
+
 static int do_xaction_namespace(const char *namespace,
 		enum device_action action, struct ndctl_ctx *ctx,
 		int *processed)
 {
+	struct util_filter_params fparam = {
+		.bus = param.bus,
+		.region = param.region,
+		.namespace = namespace,
+		.numa_node = param.numa_node,
+	};
+	struct destroy_target *targets = NULL, *t;
+	struct region_job *jobs = NULL, *j;
 	struct ndctl_namespace *ndns, *_n;
+	int rc = -ENXIO, count = 0, nr = 0;
 	struct ndctl_region *region;
-	const char *ndns_name;
+	struct util_filter filter;
 	struct ndctl_bus *bus;
-	int rc = -ENXIO;
 
 	*processed = 0;
 
@@ -1050,61 +1796,59 @@ static int do_xaction_namespace(const char *namespace,
 	if (verbose)
 		ndctl_set_log_priority(ctx, LOG_DEBUG);
 
+	rc = util_filter_compile(&filter, &fparam);
+	if (rc)
+		return rc;
+	rc = -ENXIO;
+
+	if (action == ACTION_CREATE && !namespace) {
+		if (param.numa_node && strcmp(param.numa_node, "all") == 0)
+			rc = namespace_create_per_node(ctx, &filter, processed);
+		else
+			rc = namespace_create_first(ctx, &filter, processed);
+		goto out;
+	}
+
         ndctl_bus_foreach(ctx, bus) {
-		if (!util_bus_filter(bus, param.bus))
+		if (!util_filter_match_bus(&filter, bus))
 			continue;
 
 		ndctl_region_foreach(bus, region) {
-			if (!util_region_filter(region, param.region))
+			if (!util_filter_match_region(&filter, region))
 				continue;
 
-			if (param.type) {
-				if (strcmp(param.type, "pmem") == 0
-						&& ndctl_region_get_type(region)
-						== ND_DEVICE_REGION_PMEM)
-					/* pass */;
-				else if (strcmp(param.type, "blk") == 0
-						&& ndctl_region_get_type(region)
-						== ND_DEVICE_REGION_BLK)
-					/* pass */;
-				else
-					continue;
-			}
+			if (!region_match_type(region))
+				continue;
 
-			if (action == ACTION_CREATE && !namespace) {
-				rc = namespace_create(region);
-				if (rc == -EAGAIN)
-					continue;
-				if (rc == 0)
-					*processed = 1;
-				return rc;
+			if (action == ACTION_ENABLE
+					|| action == ACTION_DISABLE) {
+				j = realloc(jobs, (count + 1) * sizeof(*jobs));
+				if (!j) {
+					rc = -ENOMEM;
+					goto out;
+				}
+				jobs = j;
+				jobs[count++] = (struct region_job) {
+					.region = region,
+				};
+				continue;
 			}
 			ndctl_namespace_foreach_safe(region, ndns, _n) {
-				ndns_name = ndctl_namespace_get_devname(ndns);
-
-				if (strcmp(namespace, "all") != 0
-						&& strcmp(namespace, ndns_name) != 0)
+				if (!util_filter_match_namespace(&filter, ndns))
 					continue;
 				switch (action) {
-				case ACTION_DISABLE:
-					rc = ndctl_namespace_disable_safe(ndns);
-					if (rc == 0)
-						(*processed)++;
-					break;
-				case ACTION_ENABLE:
-					rc = ndctl_namespace_enable(ndns);
-					if (rc >= 0) {
-						(*processed)++;
-						rc = 0;
-					}
-					break;
 				case ACTION_DESTROY:
-					rc = namespace_destroy(region, ndns);
-					if (rc == 0)
-						(*processed)++;
-					/* return success if skipped */
-					if (rc > 0)
-						rc = 0;
+					t = realloc(targets,
+						(nr + 1) * sizeof(*targets));
+					if (!t) {
+						rc = -ENOMEM;
+						goto out;
+					}
+					targets = t;
+					targets[nr++] = (struct destroy_target) {
+						.region = region,
+						.ndns = ndns,
+					};
 					break;
 				case ACTION_CHECK:
 					rc = namespace_check(ndns, verbose,
@@ -1116,7 +1860,7 @@ static int do_xaction_namespace(const char *namespace,
 					rc = namespace_reconfig(region, ndns);
 					if (rc == 0)
 						*processed = 1;
-					return rc;
+					goto out;
 				default:
 					rc = -EINVAL;
 					break;
@@ -1125,6 +1869,14 @@ static int do_xaction_namespace(const char *namespace,
 		}
 	}
 
+	if (count)
+		rc = xable_namespaces(jobs, count, &filter, action, processed);
+	if (nr)
+		rc = destroy_namespaces(targets, nr, processed);
+ out:
+	util_filter_release(&filter);
+	free(targets);
+	free(jobs);
 	return rc;
 }
 
@@ -1179,13 +1931,21 @@ int cmd_create_namespace(int argc, const char **argv, void *ctx)
 		set_defaults(ACTION_CREATE);
 		rc = do_xaction_namespace(NULL, ACTION_CREATE, ctx, &created);
 	}
+	display_namespaces();
 
+	if (param.plan && rc == 0)
+		return 0;
 	if (rc < 0 || (!namespace && created < 1)) {
 		fprintf(stderr, "failed to %s namespace: %s\n", namespace
 				? "reconfigure" : "create", strerror(-rc));
 		if (!namespace)
 			rc = -ENODEV;
 	}
+	if (param.count > 1 && created < (int) param.count
+			&& !(param.numa_node
+				&& strcmp(param.numa_node, "all") == 0))
+		fprintf(stderr, "created %d of %u namespaces\n", created,
+				param.count);
 
 	return rc;
 }
@@ -66,30 +66,40 @@ static int cmd_help(int argc, const char **argv, void *ctx)
 	return help_show_man_page(argv[0], "ndctl", "NDCTL_MAN_VIEWER");
 }
 
+static int cmd_batch(int argc, const char **argv, void *ctx);
+static int cmd_daemon(int argc, const char **argv, void *ctx);
+
 static struct cmd_struct commands[] = {
 	{ "version", cmd_version },
 	{ "create-nfit", cmd_create_nfit },
-	{ "enable-namespace", cmd_enable_namespace },
-	{ "disable-namespace", cmd_disable_namespace },
-	{ "create-namespace", cmd_create_namespace },
-	{ "destroy-namespace", cmd_destroy_namespace },
-	{ "check-namespace", cmd_check_namespace },
-	{ "enable-region", cmd_enable_region },
-	{ "disable-region", cmd_disable_region },
-	{ "enable-dimm", cmd_enable_dimm },
-	{ "disable-dimm", cmd_disable_dimm },
-	{ "zero-labels", cmd_zero_labels },
-	{ "read-labels", cmd_read_labels },
-	{ "write-labels", cmd_write_labels },
-	{ "init-labels", cmd_init_labels },
-	{ "check-labels", cmd_check_labels },
+	{ "enable-namespace", cmd_enable_namespace,
+		builtin_xaction_namespace_reset },
+	{ "disable-namespace", cmd_disable_namespace,
+		builtin_xaction_namespace_reset },
+	{ "create-namespace", cmd_create_namespace,
+		builtin_xaction_namespace_reset },
+	{ "destroy-namespace", cmd_destroy_namespace,
+		builtin_xaction_namespace_reset },
+	{ "check-namespace", cmd_check_namespace,
+		builtin_xaction_namespace_reset },
+	{ "enable-region", cmd_enable_region, builtin_xaction_region_reset },
+	{ "disable-region", cmd_disable_region, builtin_xaction_region_reset },
+	{ "enable-dimm", cmd_enable_dimm, builtin_xaction_dimm_reset },
+	{ "disable-dimm", cmd_disable_dimm, builtin_xaction_dimm_reset },
+	{ "zero-labels", cmd_zero_labels, builtin_xaction_dimm_reset },
+	{ "read-labels", cmd_read_labels, builtin_xaction_dimm_reset },
+	{ "write-labels", cmd_write_labels, builtin_xaction_dimm_reset },
+	{ "init-labels", cmd_init_labels, builtin_xaction_dimm_reset },
+	{ "check-labels", cmd_check_labels, builtin_xaction_dimm_reset },
 	{ "inject-error", cmd_inject_error },
-	{ "update-firmware", cmd_update_firmware },
+	{ "update-firmware", cmd_update_firmware, builtin_xaction_dimm_reset },
 	{ "inject-smart", cmd_inject_smart },
-	{ "wait-scrub", cmd_wait_scrub },
-	{ "start-scrub", cmd_start_scrub },
-	{ "list", cmd_list },
+	{ "wait-scrub", cmd_wait_scrub, builtin_bus_reset },
+	{ "start-scrub", cmd_start_scrub, builtin_bus_reset },
+	{ "list", cmd_list, builtin_list_reset },
 	{ "monitor", cmd_monitor},
+	{ "batch", cmd_batch },
+	{ "daemon", cmd_daemon },
 	{ "help", cmd_help },
 	#ifdef ENABLE_TEST
 	{ "test", cmd_test },
@@ -99,6 +109,16 @@ static struct cmd_struct commands[] = {
 	#endif
 };
 
+static int cmd_batch(int argc, const char **argv, void *ctx)
+{
+	return batch_run(argc, argv, ctx, commands, ARRAY_SIZE(commands));
+}
+
+static int cmd_daemon(int argc, const char **argv, void *ctx)
+{
+	return daemon_serve(argc, argv, ctx, commands, ARRAY_SIZE(commands));
+}
+
 int main(int argc, const char **argv)
 {
 	struct ndctl_ctx *ctx;
@@ -0,0 +1,105 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* Copyright(c) 2018 Intel Corporation. All rights reserved. */
+#include <stdlib.h>
+#include <pthread.h>
+#include "action.h"
+#include <ndctl/libndctl.h>
+#include <ccan/minmax/minmax.h>
+
+/* concurrent driver binds / unbinds in flight per bus */
+#define REGION_JOBS_PER_BUS 8
+
+struct bus_jobs {
+	struct ndctl_bus *bus;
+	struct region_job *jobs;
+	void (*fn)(struct region_job *job, void *arg);
+	void *arg;
+	int count, next, nr_threads;
+	pthread_t threads[REGION_JOBS_PER_BUS];
+};
+
+static void *bus_jobs_worker(void *data)
+{
+	struct bus_jobs *bj = data;
+	int i;
+
+	while ((i = __atomic_fetch_add(&bj->next, 1, __ATOMIC_RELAXED))
+			< bj->count)
+		bj->fn(&bj->jobs[i], bj->arg);
+	return NULL;
+}
+
+/*
+ * Run @fn for each region in @jobs, which the caller lists bus by bus,
+ * e.g. in ndctl_bus_foreach() / ndctl_region_foreach() order. Regions
+ * on a bus are worked up to REGION_JOBS_PER_BUS at a time, and all busses
+ * at once, so that the driver probe latency of each bind / unbind is
+ * overlapped rather than paid in turn. A region and its namespaces are
+ * only touched by the one thread running its job, as libndctl requires.
+ * Probing is flushed once per bus after all of the bus's jobs finish.
+ */
+void region_jobs_run(struct region_job *jobs, int count,
+		void (*fn)(struct region_job *job, void *arg), void *arg)
+{
+	struct bus_jobs *groups;
+	int i, j, nr_groups = 0;
+
+	if (!count)
+		return;
+
+	groups = calloc(count, sizeof(*groups));
+	if (!groups) {
+		/* fall back to working the regions in turn */
+		for (i = 0; i < count; i++) {
+			fn(&jobs[i], arg);
+			ndctl_bus_wait_probe(ndctl_region_get_bus(
+						jobs[i].region));
+		}
+		return;
+	}
+
+	for (i = 0; i < count; i++) {
+		struct ndctl_bus *bus = ndctl_region_get_bus(jobs[i].region);
+		struct bus_jobs *bj;
+
+		if (!nr_groups || groups[nr_groups - 1].bus != bus) {
+			bj = &groups[nr_groups++];
+			bj->bus = bus;
+			bj->jobs = &jobs[i];
+			bj->fn = fn;
+			bj->arg = arg;
+		}
+		groups[nr_groups - 1].count++;
+	}
+
+	/*
+	 * The calling thread works the first bus, and any bus that failed
+	 * to start a thread, so that a single job runs inline and every
+	 * job runs even without threads.
+	 */
+	for (i = 0; i < nr_groups; i++) {
+		struct bus_jobs *bj = &groups[i];
+		int nr = min(bj->count, REGION_JOBS_PER_BUS);
+
+		if (i == 0)
+			nr--;
+		for (j = 0; j < nr; j++) {
+			if (pthread_create(&bj->threads[j], NULL,
+						bus_jobs_worker, bj) != 0)
+				break;
+			bj->nr_threads++;
+		}
+	}
+
+	for (i = 0; i < nr_groups; i++) {
+		struct bus_jobs *bj = &groups[i];
+
+		if (i == 0 || !bj->nr_threads)
+			bus_jobs_worker(bj);
+		for (j = 0; j < bj->nr_threads; j++)
+			pthread_join(bj->threads[j], NULL);
+		ndctl_bus_wait_probe(bj->bus);
+	}
+
+	free(groups);
+}
@@ -13,8 +13,10 @@
 #include <stdio.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include "action.h"
+#include <builtin.h>
 #include <util/filter.h>
 #include <util/parse-options.h>
 #include <ndctl/libndctl.h>
@@ -24,6 +26,11 @@ static struct {
 	const char *type;
 } param;
 
+void builtin_xaction_region_reset(void)
+{
+	memset(&param, 0, sizeof(param));
+}
+
 static const struct option region_options[] = {
 	OPT_STRING('b', "bus", &param.bus, "bus-id",
 			"<region> must be on a bus with an id/provider of <bus-id>"),
@@ -92,18 +99,35 @@ static int region_action(struct ndctl_region *region, enum device_action mode)
 	return 0;
 }
 
+static void region_job(struct region_job *job, void *arg)
+{
+	enum device_action *mode = arg;
+
+	job->rc = region_action(job->region, *mode);
+}
+
 static int do_xable_region(const char *region_arg, enum device_action mode,
 		struct ndctl_ctx *ctx)
 {
-	int rc = -ENXIO, success = 0;
+	struct util_filter_params fparam = {
+		.bus = param.bus,
+		.region = region_arg,
+	};
+	int i, rc = -ENXIO, success = 0, count = 0;
+	struct region_job *jobs = NULL, *j;
 	struct ndctl_region *region;
+	struct util_filter filter;
 	struct ndctl_bus *bus;
 
 	if (!region_arg)
 		goto out;
 
+	rc = util_filter_compile(&filter, &fparam);
+	if (rc)
+		goto out;
+
         ndctl_bus_foreach(ctx, bus) {
-		if (!util_bus_filter(bus, param.bus))
+		if (!util_filter_match_bus(&filter, bus))
 			continue;
 
 		ndctl_region_foreach(bus, region) {
@@ -111,14 +135,28 @@ static int do_xable_region(const char *region_arg, enum device_action mode,
 
 			if (param.type && strcmp(param.type, type) != 0)
 				continue;
-			if (!util_region_filter(region, region_arg))
+			if (!util_filter_match_region(&filter, region))
 				continue;
-			if (region_action(region, mode) == 0)
-				success++;
+			j = realloc(jobs, (count + 1) * sizeof(*jobs));
+			if (!j) {
+				rc = -ENOMEM;
+				goto out_filter;
+			}
+			jobs = j;
+			jobs[count++] = (struct region_job) {
+				.region = region,
+			};
 		}
 	}
 
+	region_jobs_run(jobs, count, region_job, &mode);
+	for (i = 0; i < count; i++)
+		if (jobs[i].rc == 0)
+			success++;
 	rc = success;
+ out_filter:
+	util_filter_release(&filter);
+	free(jobs);
  out:
 	param.bus = NULL;
 	return rc;
@@ -17,207 +17,123 @@
 #include <ndctl/libndctl.h>
 #include <ccan/array_size/array_size.h>
 #include <ndctl.h>
+#include "smart.h"
 
-static void smart_threshold_to_json(struct ndctl_dimm *dimm,
+static void smart_add(struct json_object *jhealth, const char *key,
+		struct json_object *jobj)
+{
+	if (jobj)
+		json_object_object_add(jhealth, key, jobj);
+}
+
+static void smart_threshold_to_json(struct smart_health *health,
 		struct json_object *jhealth)
 {
-	unsigned int alarm_control;
-	struct json_object *jobj;
-	struct ndctl_cmd *cmd;
-	int rc;
+	unsigned int alarm_control = health->alarm_control;
 
-	cmd = ndctl_dimm_cmd_new_smart_threshold(dimm);
-	if (!cmd)
+	if (!health->threshold)
 		return;
 
-	rc = ndctl_cmd_submit(cmd);
-	if (rc || ndctl_cmd_get_firmware_status(cmd))
-		goto out;
-
-	alarm_control = ndctl_cmd_smart_threshold_get_alarm_control(cmd);
-	if (alarm_control & ND_SMART_TEMP_TRIP) {
-		unsigned int temp;
-		double t;
-
-		jobj = json_object_new_boolean(true);
-		if (jobj)
-			json_object_object_add(jhealth,
-				"alarm_enabled_media_temperature", jobj);
-		temp = ndctl_cmd_smart_threshold_get_temperature(cmd);
-		t = ndctl_decode_smart_temperature(temp);
-		jobj = json_object_new_double(t);
-		if (jobj)
-			json_object_object_add(jhealth,
-				"temperature_threshold", jobj);
-	} else {
-		jobj = json_object_new_boolean(false);
-		if (jobj)
-			json_object_object_add(jhealth,
-				"alarm_enabled_media_temperature", jobj);
-	}
-
-	if (alarm_control & ND_SMART_CTEMP_TRIP) {
-		unsigned int temp;
-		double t;
-
-		jobj = json_object_new_boolean(true);
-		if (jobj)
-			json_object_object_add(jhealth,
-				"alarm_enabled_ctrl_temperature", jobj);
-		temp = ndctl_cmd_smart_threshold_get_ctrl_temperature(cmd);
-		t = ndctl_decode_smart_temperature(temp);
-		jobj = json_object_new_double(t);
-		if (jobj)
-			json_object_object_add(jhealth,
-				"controller_temperature_threshold", jobj);
-	} else {
-		jobj = json_object_new_boolean(false);
-		if (jobj)
-			json_object_object_add(jhealth,
-				"alarm_enabled_ctrl_temperature", jobj);
-	}
-
-	if (alarm_control & ND_SMART_SPARE_TRIP) {
-		unsigned int spares;
-
-		jobj = json_object_new_boolean(true);
-		if (jobj)
-			json_object_object_add(jhealth,
-				"alarm_enabled_spares", jobj);
-		spares = ndctl_cmd_smart_threshold_get_spares(cmd);
-		jobj = json_object_new_int(spares);
-		if (jobj)
-			json_object_object_add(jhealth,
-				"spares_threshold", jobj);
-	} else {
-		jobj = json_object_new_boolean(false);
-		if (jobj)
-			json_object_object_add(jhealth,
-				"alarm_enabled_spares", jobj);
-	}
-
- out:
-	ndctl_cmd_unref(cmd);
+	smart_add(jhealth, "alarm_enabled_media_temperature",
+			json_object_new_boolean(
+				!!(alarm_control & ND_SMART_TEMP_TRIP)));
+	if (alarm_control & ND_SMART_TEMP_TRIP)
+		smart_add(jhealth, "temperature_threshold",
+				json_object_new_double(
+					health->temperature_threshold));
+
+	smart_add(jhealth, "alarm_enabled_ctrl_temperature",
+			json_object_new_boolean(
+				!!(alarm_control & ND_SMART_CTEMP_TRIP)));
+	if (alarm_control & ND_SMART_CTEMP_TRIP)
+		smart_add(jhealth, "controller_temperature_threshold",
+				json_object_new_double(
+					health->ctrl_temperature_threshold));
+
+	smart_add(jhealth, "alarm_enabled_spares",
+			json_object_new_boolean(
+				!!(alarm_control & ND_SMART_SPARE_TRIP)));
+	if (alarm_control & ND_SMART_SPARE_TRIP)
+		smart_add(jhealth, "spares_threshold",
+				json_object_new_int(health->spares_threshold));
 }
 
-struct json_object *util_dimm_health_to_json(struct ndctl_dimm *dimm)
+/*
+ * util_dimm_smart_to_json - util_dimm_health_to_json() from a smart
+ * command the caller already submitted, NULL when that failed
+ */
+struct json_object *util_dimm_smart_to_json(struct ndctl_dimm *dimm,
+		struct ndctl_cmd *cmd)
 {
 	struct json_object *jhealth = json_object_new_object();
-	struct json_object *jobj;
-	struct ndctl_cmd *cmd;
+	struct smart_health health;
 	unsigned int flags;
-	int rc;
 
 	if (!jhealth)
 		return NULL;
 
-	cmd = ndctl_dimm_cmd_new_smart(dimm);
-	if (!cmd)
-		goto err;
-
-	rc = ndctl_cmd_submit(cmd);
-	if (rc || ndctl_cmd_get_firmware_status(cmd)) {
-		jobj = json_object_new_string("unknown");
-		if (jobj)
-			json_object_object_add(jhealth, "health_state", jobj);
-		goto out;
-	}
-
-	flags = ndctl_cmd_smart_get_flags(cmd);
-	if (flags & ND_SMART_HEALTH_VALID) {
-		unsigned int health = ndctl_cmd_smart_get_health(cmd);
-
-		if (health & ND_SMART_FATAL_HEALTH)
-			jobj = json_object_new_string("fatal");
-		else if (health & ND_SMART_CRITICAL_HEALTH)
-			jobj = json_object_new_string("critical");
-		else if (health & ND_SMART_NON_CRITICAL_HEALTH)
-			jobj = json_object_new_string("non-critical");
-		else
-			jobj = json_object_new_string("ok");
-		if (jobj)
-			json_object_object_add(jhealth, "health_state", jobj);
-	}
-
-	if (flags & ND_SMART_TEMP_VALID) {
-		unsigned int temp = ndctl_cmd_smart_get_temperature(cmd);
-		double t = ndctl_decode_smart_temperature(temp);
-
-		jobj = json_object_new_double(t);
-		if (jobj)
-			json_object_object_add(jhealth, "temperature_celsius", jobj);
-	}
-
-	if (flags & ND_SMART_CTEMP_VALID) {
-		unsigned int temp = ndctl_cmd_smart_get_ctrl_temperature(cmd);
-		double t = ndctl_decode_smart_temperature(temp);
-
-		jobj = json_object_new_double(t);
-		if (jobj)
-			json_object_object_add(jhealth,
-					"controller_temperature_celsius", jobj);
-	}
-
-	if (flags & ND_SMART_SPARES_VALID) {
-		unsigned int spares = ndctl_cmd_smart_get_spares(cmd);
-
-		jobj = json_object_new_int(spares);
-		if (jobj)
-			json_object_object_add(jhealth, "spares_percentage", jobj);
-	}
+	smart_health_decode(dimm, cmd, &health);
+	flags = health.flags;
+
+	if (health.health_state)
+		smart_add(jhealth, "health_state",
+				json_object_new_string(health.health_state));
+	if (flags & ND_SMART_TEMP_VALID)
+		smart_add(jhealth, "temperature_celsius",
+				json_object_new_double(health.temperature));
+	if (flags & ND_SMART_CTEMP_VALID)
+		smart_add(jhealth, "controller_temperature_celsius",
+				json_object_new_double(
+					health.ctrl_temperature));
+	if (flags & ND_SMART_SPARES_VALID)
+		smart_add(jhealth, "spares_percentage",
+				json_object_new_int(health.spares));
 
 	if (flags & ND_SMART_ALARM_VALID) {
-		unsigned int alarm_flags = ndctl_cmd_smart_get_alarm_flags(cmd);
-		bool temp_flag = !!(alarm_flags & ND_SMART_TEMP_TRIP);
-		bool ctrl_temp_flag = !!(alarm_flags & ND_SMART_CTEMP_TRIP);
-		bool spares_flag = !!(alarm_flags & ND_SMART_SPARE_TRIP);
-
-		jobj = json_object_new_boolean(temp_flag);
-		if (jobj)
-			json_object_object_add(jhealth, "alarm_temperature", jobj);
-
-		jobj = json_object_new_boolean(ctrl_temp_flag);
-		if (jobj)
-			json_object_object_add(jhealth, "alarm_controller_temperature", jobj);
-
-		jobj = json_object_new_boolean(spares_flag);
-		if (jobj)
-			json_object_object_add(jhealth, "alarm_spares", jobj);
+		unsigned int alarm_flags = health.alarm_flags;
+
+		smart_add(jhealth, "alarm_temperature",
+				json_object_new_boolean(
+					!!(alarm_flags & ND_SMART_TEMP_TRIP)));
+		smart_add(jhealth, "alarm_controller_temperature",
+				json_object_new_boolean(
+					!!(alarm_flags & ND_SMART_CTEMP_TRIP)));
+		smart_add(jhealth, "alarm_spares",
+				json_object_new_boolean(
+					!!(alarm_flags & ND_SMART_SPARE_TRIP)));
 	}
 
-	smart_threshold_to_json(dimm, jhealth);
-
-	if (flags & ND_SMART_USED_VALID) {
-		unsigned int life_used = ndctl_cmd_smart_get_life_used(cmd);
+	smart_threshold_to_json(&health, jhealth);
 
-		jobj = json_object_new_int(life_used);
-		if (jobj)
-			json_object_object_add(jhealth, "life_used_percentage", jobj);
-	}
-
-	if (flags & ND_SMART_SHUTDOWN_VALID) {
-		unsigned int shutdown = ndctl_cmd_smart_get_shutdown_state(cmd);
+	if (flags & ND_SMART_USED_VALID)
+		smart_add(jhealth, "life_used_percentage",
+				json_object_new_int(health.life_used));
+	if (flags & ND_SMART_SHUTDOWN_VALID)
+		smart_add(jhealth, "shutdown_state", json_object_new_string(
+					health.shutdown_dirty
+					? "dirty" : "clean"));
+	if (flags & ND_SMART_SHUTDOWN_COUNT_VALID)
+		smart_add(jhealth, "shutdown_count",
+				json_object_new_int(health.shutdown_count));
 
-		jobj = json_object_new_string(shutdown ? "dirty" : "clean");
-		if (jobj)
-			json_object_object_add(jhealth, "shutdown_state", jobj);
-	}
+	return jhealth;
+}
 
-	if (flags & ND_SMART_SHUTDOWN_COUNT_VALID) {
-		unsigned int shutdown = ndctl_cmd_smart_get_shutdown_count(cmd);
+struct json_object *util_dimm_health_to_json(struct ndctl_dimm *dimm)
+{
+	struct json_object *jhealth;
+	struct ndctl_cmd *cmd;
+	int rc;
 
-		jobj = json_object_new_int(shutdown);
-		if (jobj)
-			json_object_object_add(jhealth, "shutdown_count", jobj);
-	}
+	cmd = ndctl_dimm_cmd_new_smart(dimm);
+	if (!cmd)
+		return NULL;
 
+	rc = ndctl_cmd_submit(cmd);
+	if (rc || ndctl_cmd_get_firmware_status(cmd))
+		jhealth = util_dimm_smart_to_json(dimm, NULL);
+	else
+		jhealth = util_dimm_smart_to_json(dimm, cmd);
 	ndctl_cmd_unref(cmd);
 	return jhealth;
- err:
-	json_object_put(jhealth);
-	jhealth = NULL;
- out:
-	if (cmd)
-		ndctl_cmd_unref(cmd);
-	return jhealth;
 }
@@ -0,0 +1,92 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* Copyright(c) 2018 Intel Corporation. All rights reserved. */
+#include <errno.h>
+#include <limits.h>
+#include <util/record.h>
+#include <ndctl/libndctl.h>
+#include <ndctl.h>
+#include "smart.h"
+
+static void smart_threshold_to_record(struct smart_health *health,
+		struct util_record *rec)
+{
+	unsigned int alarm_control = health->alarm_control;
+
+	if (!health->threshold)
+		return;
+
+	util_record_bool(rec, UTIL_FIELD_ALARM_ENABLED_TEMPERATURE,
+			!!(alarm_control & ND_SMART_TEMP_TRIP));
+	if (alarm_control & ND_SMART_TEMP_TRIP)
+		util_record_double(rec, UTIL_FIELD_TEMPERATURE_THRESHOLD,
+				health->temperature_threshold);
+
+	util_record_bool(rec, UTIL_FIELD_ALARM_ENABLED_CTRL_TEMPERATURE,
+			!!(alarm_control & ND_SMART_CTEMP_TRIP));
+	if (alarm_control & ND_SMART_CTEMP_TRIP)
+		util_record_double(rec, UTIL_FIELD_CTRL_TEMPERATURE_THRESHOLD,
+				health->ctrl_temperature_threshold);
+
+	util_record_bool(rec, UTIL_FIELD_ALARM_ENABLED_SPARES,
+			!!(alarm_control & ND_SMART_SPARE_TRIP));
+	if (alarm_control & ND_SMART_SPARE_TRIP)
+		util_record_u64(rec, UTIL_FIELD_SPARES_THRESHOLD,
+				health->spares_threshold);
+}
+
+/* the util_dimm_health_to_json() field set added to a dimm record */
+int util_dimm_health_to_record(struct ndctl_dimm *dimm,
+		struct util_record *rec)
+{
+	struct smart_health health;
+	struct ndctl_cmd *cmd;
+	unsigned int flags;
+	int rc;
+
+	cmd = ndctl_dimm_cmd_new_smart(dimm);
+	if (!cmd)
+		return -ENOMEM;
+
+	rc = ndctl_cmd_submit(cmd);
+	if (rc || ndctl_cmd_get_firmware_status(cmd))
+		smart_health_decode(dimm, NULL, &health);
+	else
+		smart_health_decode(dimm, cmd, &health);
+	ndctl_cmd_unref(cmd);
+	flags = health.flags;
+
+	if (health.health_state)
+		util_record_str(rec, UTIL_FIELD_HEALTH_STATE,
+				health.health_state);
+	if (flags & ND_SMART_TEMP_VALID)
+		util_record_double(rec, UTIL_FIELD_TEMPERATURE,
+				health.temperature);
+	if (flags & ND_SMART_CTEMP_VALID)
+		util_record_double(rec, UTIL_FIELD_CTRL_TEMPERATURE,
+				health.ctrl_temperature);
+	if (flags & ND_SMART_SPARES_VALID)
+		util_record_u64(rec, UTIL_FIELD_SPARES, health.spares);
+
+	if (flags & ND_SMART_ALARM_VALID) {
+		unsigned int alarm_flags = health.alarm_flags;
+
+		util_record_bool(rec, UTIL_FIELD_ALARM_TEMPERATURE,
+				!!(alarm_flags & ND_SMART_TEMP_TRIP));
+		util_record_bool(rec, UTIL_FIELD_ALARM_CTRL_TEMPERATURE,
+				!!(alarm_flags & ND_SMART_CTEMP_TRIP));
+		util_record_bool(rec, UTIL_FIELD_ALARM_SPARES,
+				!!(alarm_flags & ND_SMART_SPARE_TRIP));
+	}
+
+	smart_threshold_to_record(&health, rec);
+
+	if (flags & ND_SMART_USED_VALID)
+		util_record_u64(rec, UTIL_FIELD_LIFE_USED, health.life_used);
+	if (flags & ND_SMART_SHUTDOWN_VALID)
+		util_record_str(rec, UTIL_FIELD_SHUTDOWN_STATE,
+				health.shutdown_dirty ? "dirty" : "clean");
+	if (flags & ND_SMART_SHUTDOWN_COUNT_VALID)
+		util_record_u64(rec, UTIL_FIELD_SHUTDOWN_COUNT,
+				health.shutdown_count);
+	return 0;
+}
@@ -0,0 +1,90 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* Copyright(c) 2018 Intel Corporation. All rights reserved. */
+#include <string.h>
+#include <ndctl/libndctl.h>
+#include <ndctl.h>
+#include "smart.h"
+
+static void smart_threshold_decode(struct ndctl_dimm *dimm,
+		struct smart_health *health)
+{
+	struct ndctl_cmd *cmd;
+	int rc;
+
+	cmd = ndctl_dimm_cmd_new_smart_threshold(dimm);
+	if (!cmd)
+		return;
+
+	rc = ndctl_cmd_submit(cmd);
+	if (rc || ndctl_cmd_get_firmware_status(cmd))
+		goto out;
+
+	health->threshold = true;
+	health->alarm_control =
+		ndctl_cmd_smart_threshold_get_alarm_control(cmd);
+	if (health->alarm_control & ND_SMART_TEMP_TRIP)
+		health->temperature_threshold = ndctl_decode_smart_temperature(
+				ndctl_cmd_smart_threshold_get_temperature(cmd));
+	if (health->alarm_control & ND_SMART_CTEMP_TRIP)
+		health->ctrl_temperature_threshold =
+			ndctl_decode_smart_temperature(
+				ndctl_cmd_smart_threshold_get_ctrl_temperature(
+					cmd));
+	if (health->alarm_control & ND_SMART_SPARE_TRIP)
+		health->spares_threshold =
+			ndctl_cmd_smart_threshold_get_spares(cmd);
+ out:
+	ndctl_cmd_unref(cmd);
+}
+
+/*
+ * smart_health_decode - decode a smart command the caller submitted,
+ * @cmd is NULL when that failed, and fetch the dimm's alarm thresholds
+ */
+void smart_health_decode(struct ndctl_dimm *dimm, struct ndctl_cmd *cmd,
+		struct smart_health *health)
+{
+	unsigned int flags;
+
+	memset(health, 0, sizeof(*health));
+	if (!cmd) {
+		health->health_state = "unknown";
+		return;
+	}
+
+	flags = ndctl_cmd_smart_get_flags(cmd);
+	health->flags = flags;
+	if (flags & ND_SMART_HEALTH_VALID) {
+		unsigned int state = ndctl_cmd_smart_get_health(cmd);
+
+		if (state & ND_SMART_FATAL_HEALTH)
+			health->health_state = "fatal";
+		else if (state & ND_SMART_CRITICAL_HEALTH)
+			health->health_state = "critical";
+		else if (state & ND_SMART_NON_CRITICAL_HEALTH)
+			health->health_state = "non-critical";
+		else
+			health->health_state = "ok";
+	}
+
+	if (flags & ND_SMART_TEMP_VALID)
+		health->temperature = ndctl_decode_smart_temperature(
+				ndctl_cmd_smart_get_temperature(cmd));
+	if (flags & ND_SMART_CTEMP_VALID)
+		health->ctrl_temperature = ndctl_decode_smart_temperature(
+				ndctl_cmd_smart_get_ctrl_temperature(cmd));
+	if (flags & ND_SMART_SPARES_VALID)
+		health->spares = ndctl_cmd_smart_get_spares(cmd);
+	if (flags & ND_SMART_ALARM_VALID)
+		health->alarm_flags = ndctl_cmd_smart_get_alarm_flags(cmd);
+	if (flags & ND_SMART_USED_VALID)
+		health->life_used = ndctl_cmd_smart_get_life_used(cmd);
+	if (flags & ND_SMART_SHUTDOWN_VALID)
+		health->shutdown_dirty =
+			!!ndctl_cmd_smart_get_shutdown_state(cmd);
+	if (flags & ND_SMART_SHUTDOWN_COUNT_VALID)
+		health->shutdown_count =
+			ndctl_cmd_smart_get_shutdown_count(cmd);
+
+	smart_threshold_decode(dimm, health);
+}
@@ -0,0 +1,36 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* Copyright(c) 2018 Intel Corporation. All rights reserved. */
+#ifndef __NDCTL_UTIL_SMART_H__
+#define __NDCTL_UTIL_SMART_H__
+#include <stdbool.h>
+#include <ndctl/libndctl.h>
+
+/*
+ * struct smart_health - decoded smart and smart threshold payloads, the
+ * one source of the health fields of the json and record listings
+ * @flags: ND_SMART_*_VALID fields of the smart payload, 0 if unknown
+ * @health_state: NULL if not valid, "unknown" if the smart command failed
+ * @alarm_flags: ND_SMART_*_TRIP alarms raised, with ND_SMART_ALARM_VALID
+ * @threshold: the smart threshold command succeeded
+ * @alarm_control: ND_SMART_*_TRIP alarms enabled, with @threshold
+ */
+struct smart_health {
+	unsigned int flags;
+	const char *health_state;
+	double temperature;
+	double ctrl_temperature;
+	unsigned int spares;
+	unsigned int alarm_flags;
+	unsigned int life_used;
+	bool shutdown_dirty;
+	unsigned int shutdown_count;
+	bool threshold;
+	unsigned int alarm_control;
+	double temperature_threshold;
+	double ctrl_temperature_threshold;
+	unsigned int spares_threshold;
+};
+
+void smart_health_decode(struct ndctl_dimm *dimm, struct ndctl_cmd *cmd,
+		struct smart_health *health);
+#endif /* __NDCTL_UTIL_SMART_H__ */
@@ -0,0 +1,47 @@
+#!/bin/bash -Ex
+
+# SPDX-License-Identifier: GPL-2.0
+# Copyright(c) 2018 Intel Corporation. All rights reserved.
+
+rc=77
+
+. ./common
+
+check_prereq "jq"
+
+trap 'err $LINENO' ERR
+
+init()
+{
+	$NDCTL disable-region -b $NFIT_TEST_BUS0 all
+	$NDCTL zero-labels -b $NFIT_TEST_BUS0 all
+	$NDCTL enable-region -b $NFIT_TEST_BUS0 all
+}
+
+# each command sees the changes of the ones before it in the same ctx
+do_test()
+{
+	region=$($NDCTL list -b $NFIT_TEST_BUS0 -R -t pmem | jq -r 'sort_by(-.size) | .[].dev' | head -1)
+
+	json=$($NDCTL batch <<- EOF
+		create-namespace -r $region -t pmem -m raw -n batch0
+		list -r $region -N
+		destroy-namespace -f -r $region all
+		list -r $region -N
+	EOF
+	)
+
+	# the new namespace is printed by create and the first list only
+	count=$(echo "$json" | jq -s '[.[] | if type == "array" then .[] else . end | select(.name == "batch0")] | length')
+	[ $count -eq 2 ]
+
+	# --watch never returns, batch rejects it
+	! echo "list --watch" | $NDCTL batch
+}
+
+modprobe nfit_test
+rc=1
+init
+do_test
+_cleanup
+exit 0
@@ -49,6 +49,11 @@ if dd if=/dev/$blockdev of=/dev/null iflag=direct bs=512 skip=$sector count=$len
 	echo "fail: $LINENO" && exit 1
 fi
 
+# a directed scrub of just the injected sectors finds them again
+json=$($NDCTL start-scrub $NFIT_TEST_BUS0 --namespace=$dev --range=$sector+$len)
+[ $(echo $json | jq ".[0].scrubbed_ranges") -ne 1 ] && echo "fail: $LINENO" && exit 1
+[ $(echo $json | jq ".[0].media_errors | length") -lt 1 ] && echo "fail: $LINENO" && exit 1
+
 size_raw=$size
 sector_raw=$sector
 
@@ -71,6 +76,13 @@ if read sector len < /sys/block/$blockdev/badblocks; then
 	echo "fail: $LINENO" && exit 1
 fi
 
+# a full scrub waited on with --wait completes without finding them again
+json=$($NDCTL start-scrub $NFIT_TEST_BUS0 --wait)
+[ $(echo $json | jq -r ".[0].scrub_state") != "idle" ] && echo "fail: $LINENO" && exit 1
+if read sector len < /sys/block/$blockdev/badblocks; then
+	echo "fail: $LINENO" && exit 1
+fi
+
 if check_min_kver "4.9"; then
 	# check for re-appearance of stale badblocks from poison_list
 	$NDCTL disable-region -b $NFIT_TEST_BUS0 all
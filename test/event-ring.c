@@ -0,0 +1,159 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* Copyright(c) 2018 Intel Corporation. All rights reserved. */
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <ndctl/libndctl.h>
+
+#define NR_RECORDS 16
+#define NR_POSTS 200000
+
+/*
+ * One producer thread posts NR_POSTS records, each carrying its index in
+ * several fields, into a ring small enough that the consumer is regularly
+ * lapped. Every record the consumer gets must be internally consistent
+ * and newer than the last one, and together with the lost count account
+ * for every post.
+ */
+static void *producer(void *arg)
+{
+	struct ndctl_event_ring *ring = arg;
+	struct ndctl_event_record rec;
+	unsigned int i;
+
+	for (i = 0; i < NR_POSTS; i++) {
+		memset(&rec, 0, sizeof(rec));
+		rec.bus_id = i;
+		rec.temperature = i * 7;
+		rec.life_used = ~i;
+		rec.shutdown_count = i ^ 0x5a5a5a5a;
+		if (ndctl_event_ring_post(ring, &rec) != 0
+				|| rec.seq != (uint64_t) i + 1)
+			return (void *) -1L;
+	}
+	ndctl_event_ring_close(ring);
+	return NULL;
+}
+
+static int check_record(struct ndctl_event_record *rec, uint64_t last)
+{
+	uint32_t i = rec->bus_id;
+
+	if (rec->seq != (uint64_t) i + 1 || rec->temperature != i * 7
+			|| rec->life_used != ~i
+			|| rec->shutdown_count != (i ^ 0x5a5a5a5a)) {
+		fprintf(stderr, "torn record seq: %llu index: %u\n",
+				(unsigned long long) rec->seq, i);
+		return -ENXIO;
+	}
+	if (rec->seq <= last) {
+		fprintf(stderr, "record seq: %llu after: %llu\n",
+				(unsigned long long) rec->seq,
+				(unsigned long long) last);
+		return -ENXIO;
+	}
+	return 0;
+}
+
+static int test_event_ring(struct ndctl_ctx *ctx)
+{
+	char path[] = "/tmp/ndctl-event-ring-XXXXXX";
+	struct ndctl_event_ring *ring, *reader;
+	unsigned long long nr_read = 0, lost;
+	struct ndctl_event_record rec;
+	uint64_t last = 0;
+	pthread_t thread;
+	void *status;
+	int fd, rc;
+
+	fd = mkstemp(path);
+	if (fd < 0)
+		return -errno;
+	close(fd);
+
+	ring = ndctl_event_ring_new(ctx, path, NR_RECORDS);
+	if (!ring) {
+		unlink(path);
+		return -ENOMEM;
+	}
+
+	reader = ndctl_event_ring_open(ctx, path);
+	unlink(path);
+	if (!reader) {
+		ndctl_event_ring_close(ring);
+		return -ENXIO;
+	}
+
+	if (ndctl_event_ring_post(reader, &rec) != -EPERM) {
+		fprintf(stderr, "consumer was allowed to post\n");
+		ndctl_event_ring_close(reader);
+		ndctl_event_ring_close(ring);
+		return -ENXIO;
+	}
+
+	rc = pthread_create(&thread, NULL, producer, ring);
+	if (rc) {
+		ndctl_event_ring_close(reader);
+		ndctl_event_ring_close(ring);
+		return -rc;
+	}
+
+	for (;;) {
+		rc = ndctl_event_ring_read(reader, &rec);
+		if (rc == 1) {
+			rc = check_record(&rec, last);
+			if (rc)
+				break;
+			last = rec.seq;
+			nr_read++;
+			continue;
+		}
+		if (rc < 0)
+			break;
+		rc = ndctl_event_ring_wait(reader, 1000);
+		if (rc == -ETIMEDOUT) {
+			fprintf(stderr, "timed out after seq: %llu\n",
+					(unsigned long long) last);
+			break;
+		}
+	}
+
+	pthread_join(thread, &status);
+	lost = ndctl_event_ring_get_lost(reader);
+	ndctl_event_ring_close(reader);
+
+	if (status) {
+		fprintf(stderr, "producer failed\n");
+		return -ENXIO;
+	}
+	if (rc != -EPIPE)
+		return rc < 0 ? rc : -ENXIO;
+	if (nr_read + lost != NR_POSTS || last != NR_POSTS) {
+		fprintf(stderr, "read: %llu lost: %llu last: %llu of %d\n",
+				nr_read, lost, (unsigned long long) last,
+				NR_POSTS);
+		return -ENXIO;
+	}
+
+	fprintf(stderr, "read: %llu lost: %llu\n", nr_read, lost);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct ndctl_ctx *ctx;
+	int rc;
+
+	rc = ndctl_new(&ctx);
+	if (rc < 0)
+		return EXIT_FAILURE;
+
+	rc = test_event_ring(ctx);
+	ndctl_unref(ctx);
+
+	fprintf(stderr, "%s: %s\n", argv[0], rc ? "FAIL" : "PASS");
+	return rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
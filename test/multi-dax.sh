@@ -36,6 +36,44 @@ chardev1=$(echo $json | jq ". | select(.mode == \"devdax\") | .daxregion.devices
 json=$($NDCTL create-namespace -b $NFIT_TEST_BUS0 -r $region -t pmem -m devdax -a 4096 -s 16M)
 chardev2=$(echo $json | jq ". | select(.mode == \"devdax\") | .daxregion.devices[0].chardev")
 
+# plan two more 16M namespaces, the plan is listed but nothing is created
+nr_ns=$($NDCTL list -b $NFIT_TEST_BUS0 -r $region -N | jq -s "flatten | length")
+json=$($NDCTL create-namespace -b $NFIT_TEST_BUS0 -r $region -t pmem -m devdax -a 4096 -s 16M --count=2 --plan)
+[ $(echo $json | jq "length") -ne 2 ] && echo "fail: $LINENO" && exit 1
+[ $(echo $json | jq -c "[.[].size] | unique") != "[16777216]" ] && echo "fail: $LINENO" && exit 1
+[ $(echo $json | jq ".[1].start >= .[0].start + .[0].size") != "true" ] && echo "fail: $LINENO" && exit 1
+[ $($NDCTL list -b $NFIT_TEST_BUS0 -r $region -N | jq -s "flatten | length") -ne $nr_ns ] && echo "fail: $LINENO" && exit 1
+
+# without --mode the plan is for the default fsdax mode
+json=$($NDCTL create-namespace -b $NFIT_TEST_BUS0 -r $region -s 16M --plan)
+[ $(echo $json | jq "length") -ne 1 ] && echo "fail: $LINENO" && exit 1
+[ $($NDCTL list -b $NFIT_TEST_BUS0 -r $region -N | jq -s "flatten | length") -ne $nr_ns ] && echo "fail: $LINENO" && exit 1
+
+# carve them, they are listed together as one array
+json=$($NDCTL create-namespace -b $NFIT_TEST_BUS0 -r $region -t pmem -m devdax -a 4096 -s 16M --count=2)
+[ $(echo $json | jq "length") -ne 2 ] && echo "fail: $LINENO" && exit 1
+[ $(echo $json | jq "[.[].size] | unique | length") -ne 1 ] && echo "fail: $LINENO" && exit 1
+[ $(echo $json | jq "[.[].daxregion.devices[0].chardev] | unique | length") -ne 2 ] && echo "fail: $LINENO" && exit 1
+
+# the namespaces of the region can be selected as a range and a list
+read first last nr_ns <<< $($NDCTL list -b $NFIT_TEST_BUS0 -r $region -N | jq -r "[.[].dev | split(\".\")[1] | tonumber] | sort | \"\\(.[0]) \\(.[-1]) \\(length)\"")
+ns="namespace${region#region}"
+[ $($NDCTL list -N -n $ns.$first-$ns.$last | jq -s "flatten | length") -ne $nr_ns ] && echo "fail: $LINENO" && exit 1
+[ $($NDCTL list -N -n $ns.$first,$ns.$last | jq -s "flatten | length") -ne 2 ] && echo "fail: $LINENO" && exit 1
+
+# likewise the dimms of the bus, by name or by id
+read first last nr_dimms <<< $($NDCTL list -b $NFIT_TEST_BUS0 -D | jq -r "[.[].dev | ltrimstr(\"nmem\") | tonumber] | sort | \"\\(.[0]) \\(.[-1]) \\(length)\"")
+[ $($NDCTL list -b $NFIT_TEST_BUS0 -D -d nmem$first-nmem$last | jq -s "flatten | length") -ne $nr_dimms ] && echo "fail: $LINENO" && exit 1
+[ $($NDCTL list -b $NFIT_TEST_BUS0 -D -d $first-$last | jq -s "flatten | length") -ne $nr_dimms ] && echo "fail: $LINENO" && exit 1
+[ $($NDCTL list -b $NFIT_TEST_BUS0 -D -d "$first $last" | jq -s "flatten | length") -ne 2 ] && echo "fail: $LINENO" && exit 1
+
+# the flat formats emit one record per namespace
+[ $($NDCTL list -b $NFIT_TEST_BUS0 -r $region -N --format=ndjson | jq -s "[.[] | select(.type == \"namespace\")] | length") -ne $nr_ns ] && echo "fail: $LINENO" && exit 1
+json=$($NDCTL list -b $NFIT_TEST_BUS0 -r $region -N --format=csv)
+[ "$(echo "$json" | head -1 | cut -d, -f1,2)" != "type,dev" ] && echo "fail: $LINENO" && exit 1
+[ $(echo "$json" | grep -c "^namespace,") -ne $nr_ns ] && echo "fail: $LINENO" && exit 1
+[ "$($NDCTL list -b $NFIT_TEST_BUS0 -r $region -N --format=binary | head -c 4)" != "ndr1" ] && echo "fail: $LINENO" && exit 1
+
 _cleanup
 
 exit 0
@@ -11,6 +11,8 @@
  * General Public License for more details.
  */
 #include <stdio.h>
+#include <ctype.h>
+#include <errno.h>
 #include <string.h>
 #include <stdlib.h>
 #include <limits.h>
@@ -23,298 +25,403 @@
 #include <ndctl/libndctl.h>
 #include <daxctl/libdaxctl.h>
 
-#define NUMA_NO_NODE    (-1)
+enum filter_class {
+	FILTER_BUS,
+	FILTER_REGION,
+	FILTER_DIMM,
+	FILTER_NAMESPACE,
+};
 
-struct ndctl_bus *util_bus_filter(struct ndctl_bus *bus, const char *__ident)
+static const char *filter_prefix[] = {
+	[FILTER_BUS] = "ndbus",
+	[FILTER_REGION] = "region",
+	[FILTER_DIMM] = "nmem",
+	[FILTER_NAMESPACE] = "namespace",
+};
+
+/*
+ * Parse a 'prefixN' device name or bare id 'N', or for namespaces a
+ * 'namespaceX.Y' device name or 'X.Y' tuple. When @tuple is false for a
+ * namespace the parent (region) id is inherited from the caller, this is
+ * how the tail of a 'X.Y-Z' range is parsed.
+ */
+static int parse_id(const char *str, enum filter_class class, bool tuple,
+		unsigned long *parent, unsigned long *id)
 {
-	char *end = NULL, *ident, *save;
-	unsigned long bus_id, id;
-	const char *provider, *devname, *name;
+	const char *prefix = filter_prefix[class];
+	size_t len = strlen(prefix);
+	int base = 0;
+	char *end;
+
+	if (strncmp(str, prefix, len) == 0) {
+		str += len;
+		base = 10;
+	}
 
-	if (!__ident)
-		return bus;
+	if (class == FILTER_NAMESPACE && tuple) {
+		if (!isdigit(str[0]))
+			return -EINVAL;
+		*parent = strtoul(str, &end, 10);
+		if (end[0] != '.')
+			return -EINVAL;
+		str = end + 1;
+		base = 10;
+	} else if (class == FILTER_NAMESPACE && base == 10)
+		return -EINVAL;
+
+	if (!isdigit(str[0]))
+		return -EINVAL;
+	*id = strtoul(str, &end, base);
+	if (end[0])
+		return -EINVAL;
+	return 0;
+}
 
-	ident = strdup(__ident);
-	if (!ident)
-		return NULL;
+static int ids_add_range(struct util_filter_ids *ids, unsigned long parent,
+		unsigned long start, unsigned long end)
+{
+	struct util_filter_range *ranges;
+
+	ranges = realloc(ids->ranges, sizeof(*ranges) * (ids->num_ranges + 1));
+	if (!ranges)
+		return -ENOMEM;
+	ranges[ids->num_ranges++] = (struct util_filter_range) {
+		.parent = parent,
+		.start = start,
+		.end = end,
+	};
+	ids->ranges = ranges;
+	return 0;
+}
 
-	for (name = strtok_r(ident, " ", &save); name;
-			name = strtok_r(NULL, " ", &save)) {
-		if (strcmp(name, "all") == 0)
-			break;
+static int ids_add_name(struct util_filter_ids *ids, char *name)
+{
+	char **names;
 
-		bus_id = strtoul(ident, &end, 0);
-		if (end == ident || end[0])
-			bus_id = ULONG_MAX;
+	names = realloc(ids->names, sizeof(*names) * (ids->num_names + 1));
+	if (!names)
+		return -ENOMEM;
+	names[ids->num_names++] = name;
+	ids->names = names;
+	return 0;
+}
 
-		provider = ndctl_bus_get_provider(bus);
-		devname = ndctl_bus_get_devname(bus);
-		id = ndctl_bus_get_id(bus);
+static int ids_add_token(struct util_filter_ids *ids, char *name,
+		enum filter_class class)
+{
+	unsigned long parent = 0, end_parent, start, end;
+	char *sep;
 
-		if (bus_id < ULONG_MAX && bus_id == id)
-			break;
+	if (strcmp(name, "all") == 0) {
+		ids->all = true;
+		return 0;
+	}
 
-		if (bus_id == ULONG_MAX && (strcmp(provider, name) == 0
-				|| strcmp(devname, name) == 0))
-			break;
+	if (parse_id(name, class, true, &parent, &start) == 0)
+		return ids_add_range(ids, parent, start, start);
+
+	/*
+	 * 'nmem0-nmem11', 'nmem0-11', '0-11', 'namespace1.0-namespace1.3',
+	 * '1.0-3'. Anything that does not parse as a range is treated as a
+	 * name.
+	 */
+	sep = strchr(name, '-');
+	if (sep) {
+		*sep = '\0';
+		if (parse_id(name, class, true, &parent, &start) == 0) {
+			int rc;
+
+			end_parent = parent;
+			rc = parse_id(sep + 1, class, true, &end_parent, &end);
+			if (rc) {
+				end_parent = parent;
+				rc = parse_id(sep + 1, class, false,
+						&end_parent, &end);
+			}
+			if (rc == 0) {
+				if (end_parent != parent || end < start)
+					return -ERANGE;
+				return ids_add_range(ids, parent, start, end);
+			}
+		}
+		*sep = '-';
 	}
-	free(ident);
 
-	if (name)
-		return bus;
-	return NULL;
+	return ids_add_name(ids, name);
 }
 
-struct ndctl_region *util_region_filter(struct ndctl_region *region,
-		const char *__ident)
+static void util_filter_ids_release(struct util_filter_ids *ids)
 {
-	char *end = NULL, *ident, *save;
-	const char *name, *region_name;
-	unsigned long region_id, id;
-
-	if (!__ident)
-		return region;
-
-	ident = strdup(__ident);
-	if (!ident)
-		return NULL;
+	free(ids->ranges);
+	free(ids->names);
+	free(ids->buf);
+	memset(ids, 0, sizeof(*ids));
+}
 
-	for (name = strtok_r(ident, " ", &save); name;
-			name = strtok_r(NULL, " ", &save)) {
-		if (strcmp(name, "all") == 0)
-			break;
+/*
+ * Compile a space or comma separated list of identifiers into id ranges
+ * and residual names.
+ */
+static int util_filter_ids_parse(struct util_filter_ids *ids,
+		const char *ident, enum filter_class class)
+{
+	char *name, *save;
+	int rc = 0;
 
-		region_id = strtoul(ident, &end, 0);
-		if (end == ident || end[0])
-			region_id = ULONG_MAX;
+	memset(ids, 0, sizeof(*ids));
+	if (!ident) {
+		ids->all = true;
+		return 0;
+	}
 
-		region_name = ndctl_region_get_devname(region);
-		id = ndctl_region_get_id(region);
+	ids->buf = strdup(ident);
+	if (!ids->buf)
+		return -ENOMEM;
 
-		if (region_id < ULONG_MAX && region_id == id)
-			break;
-
-		if (region_id == ULONG_MAX && strcmp(region_name, name) == 0)
+	for (name = strtok_r(ids->buf, " ,", &save); name;
+			name = strtok_r(NULL, " ,", &save)) {
+		rc = ids_add_token(ids, name, class);
+		if (rc)
 			break;
 	}
-	free(ident);
 
-	if (name)
-		return region;
-	return NULL;
+	if (rc)
+		util_filter_ids_release(ids);
+	return rc;
 }
 
-struct ndctl_namespace *util_namespace_filter(struct ndctl_namespace *ndns,
-		const char *__ident)
+static bool ids_match(struct util_filter_ids *ids, unsigned long parent,
+		unsigned long id, const char *devname, const char *alias)
 {
-	struct ndctl_region *region = ndctl_namespace_get_region(ndns);
-	unsigned long region_id, ndns_id;
-	const char *name;
-	char *ident, *save;
+	int i;
 
-	if (!__ident)
-		return ndns;
+	if (ids->all)
+		return true;
 
-	ident = strdup(__ident);
-	if (!ident)
-		return NULL;
-
-	for (name = strtok_r(ident, " ", &save); name;
-			name = strtok_r(NULL, " ", &save)) {
-		if (strcmp(name, "all") == 0)
-			break;
+	for (i = 0; i < ids->num_ranges; i++) {
+		struct util_filter_range *range = &ids->ranges[i];
 
-		if (strcmp(name, ndctl_namespace_get_devname(ndns)) == 0)
-			break;
+		if (range->parent == parent && id >= range->start
+				&& id <= range->end)
+			return true;
+	}
 
-		if (sscanf(name, "%ld.%ld", &region_id, &ndns_id) == 2
-				&& ndctl_region_get_id(region) == region_id
-				&& ndctl_namespace_get_id(ndns) == ndns_id)
-			break;
+	for (i = 0; i < ids->num_names; i++) {
+		if (strcmp(ids->names[i], devname) == 0)
+			return true;
+		if (alias && strcmp(ids->names[i], alias) == 0)
+			return true;
 	}
-	free(ident);
 
-	if (name)
-		return ndns;
-	return NULL;
+	return false;
 }
 
-struct ndctl_dimm *util_dimm_filter(struct ndctl_dimm *dimm,
-		const char *__ident)
+static bool ids_match_bus(struct util_filter_ids *ids, struct ndctl_bus *bus)
 {
-	char *end = NULL, *ident, *save;
-	const char *name, *dimm_name;
-	unsigned long dimm_id, id;
-
-	if (!__ident)
-		return dimm;
-
-	ident = strdup(__ident);
-	if (!ident)
-		return NULL;
-
-	for (name = strtok_r(ident, " ", &save); name;
-			name = strtok_r(NULL, " ", &save)) {
-		if (strcmp(name, "all") == 0)
-			break;
-
-		dimm_id = strtoul(ident, &end, 0);
-		if (end == ident || end[0])
-			dimm_id = ULONG_MAX;
+	return ids_match(ids, 0, ndctl_bus_get_id(bus),
+			ndctl_bus_get_devname(bus),
+			ndctl_bus_get_provider(bus));
+}
 
-		dimm_name = ndctl_dimm_get_devname(dimm);
-		id = ndctl_dimm_get_id(dimm);
+static bool ids_match_region(struct util_filter_ids *ids,
+		struct ndctl_region *region)
+{
+	return ids_match(ids, 0, ndctl_region_get_id(region),
+			ndctl_region_get_devname(region), NULL);
+}
 
-		if (dimm_id < ULONG_MAX && dimm_id == id)
-			break;
+static bool ids_match_dimm(struct util_filter_ids *ids,
+		struct ndctl_dimm *dimm)
+{
+	return ids_match(ids, 0, ndctl_dimm_get_id(dimm),
+			ndctl_dimm_get_devname(dimm), NULL);
+}
 
-		if (dimm_id == ULONG_MAX && strcmp(dimm_name, name) == 0)
-			break;
-	}
-	free(ident);
+static bool ids_match_namespace(struct util_filter_ids *ids,
+		struct ndctl_namespace *ndns)
+{
+	struct ndctl_region *region = ndctl_namespace_get_region(ndns);
 
-	if (name)
-		return dimm;
-	return NULL;
+	return ids_match(ids, ndctl_region_get_id(region),
+			ndctl_namespace_get_id(ndns),
+			ndctl_namespace_get_devname(ndns), NULL);
 }
 
-struct ndctl_bus *util_bus_filter_by_dimm(struct ndctl_bus *bus,
-		const char *ident)
+static bool ids_match_bus_by_dimm(struct util_filter_ids *ids,
+		struct ndctl_bus *bus)
 {
 	struct ndctl_dimm *dimm;
 
-	if (!ident || strcmp(ident, "all") == 0)
-		return bus;
+	if (ids->all)
+		return true;
 
 	ndctl_dimm_foreach(bus, dimm)
-		if (util_dimm_filter(dimm, ident))
-			return bus;
-	return NULL;
+		if (ids_match_dimm(ids, dimm))
+			return true;
+	return false;
 }
 
-struct ndctl_bus *util_bus_filter_by_region(struct ndctl_bus *bus,
-		const char *ident)
+static bool ids_match_bus_by_region(struct util_filter_ids *ids,
+		struct ndctl_bus *bus)
 {
 	struct ndctl_region *region;
 
-	if (!ident || strcmp(ident, "all") == 0)
-		return bus;
+	if (ids->all)
+		return true;
 
 	ndctl_region_foreach(bus, region)
-		if (util_region_filter(region, ident))
-			return bus;
-	return NULL;
+		if (ids_match_region(ids, region))
+			return true;
+	return false;
 }
 
-struct ndctl_bus *util_bus_filter_by_namespace(struct ndctl_bus *bus,
-		const char *ident)
+static bool ids_match_bus_by_namespace(struct util_filter_ids *ids,
+		struct ndctl_bus *bus)
 {
 	struct ndctl_region *region;
 	struct ndctl_namespace *ndns;
 
-	if (!ident || strcmp(ident, "all") == 0)
-		return bus;
+	if (ids->all)
+		return true;
 
 	ndctl_region_foreach(bus, region)
 		ndctl_namespace_foreach(region, ndns)
-			if (util_namespace_filter(ndns, ident))
-				return bus;
-	return NULL;
+			if (ids_match_namespace(ids, ndns))
+				return true;
+	return false;
 }
 
-struct ndctl_region *util_region_filter_by_dimm(struct ndctl_region *region,
-		const char *ident)
+static bool ids_match_region_by_dimm(struct util_filter_ids *ids,
+		struct ndctl_region *region)
 {
 	struct ndctl_dimm *dimm;
 
-	if (!ident || strcmp(ident, "all") == 0)
-		return region;
+	if (ids->all)
+		return true;
 
 	ndctl_dimm_foreach_in_region(region, dimm)
-		if (util_dimm_filter(dimm, ident))
-			return region;
+		if (ids_match_dimm(ids, dimm))
+			return true;
+	return false;
+}
 
-	return NULL;
+static bool ids_match_region_by_namespace(struct util_filter_ids *ids,
+		struct ndctl_region *region)
+{
+	struct ndctl_namespace *ndns;
+
+	if (ids->all)
+		return true;
+
+	ndctl_namespace_foreach(region, ndns)
+		if (ids_match_namespace(ids, ndns))
+			return true;
+	return false;
 }
 
-struct ndctl_dimm *util_dimm_filter_by_region(struct ndctl_dimm *dimm,
-		const char *ident)
+static bool ids_match_dimm_by_region(struct util_filter_ids *ids,
+		struct ndctl_dimm *dimm)
 {
 	struct ndctl_bus *bus = ndctl_dimm_get_bus(dimm);
 	struct ndctl_region *region;
 	struct ndctl_dimm *check;
 
-	if (!ident || strcmp(ident, "all") == 0)
-		return dimm;
+	if (ids->all)
+		return true;
 
 	ndctl_region_foreach(bus, region) {
-		if (!util_region_filter(region, ident))
+		if (!ids_match_region(ids, region))
 			continue;
 		ndctl_dimm_foreach_in_region(region, check)
 			if (check == dimm)
-				return dimm;
+				return true;
 	}
-
-	return NULL;
+	return false;
 }
 
-struct ndctl_dimm *util_dimm_filter_by_namespace(struct ndctl_dimm *dimm,
-		const char *ident)
+static bool ids_match_dimm_by_namespace(struct util_filter_ids *ids,
+		struct ndctl_dimm *dimm)
 {
 	struct ndctl_bus *bus = ndctl_dimm_get_bus(dimm);
 	struct ndctl_namespace *ndns;
 	struct ndctl_region *region;
 	struct ndctl_dimm *check;
 
-	if (!ident || strcmp(ident, "all") == 0)
-		return dimm;
+	if (ids->all)
+		return true;
 
 	ndctl_region_foreach(bus, region) {
 		ndctl_namespace_foreach(region, ndns) {
-			if (!util_namespace_filter(ndns, ident))
+			if (!ids_match_namespace(ids, ndns))
 				continue;
 			ndctl_dimm_foreach_in_region(region, check)
 				if (check == dimm)
-					return dimm;
+					return true;
 		}
 	}
-
-	return NULL;
+	return false;
 }
 
-struct ndctl_dimm *util_dimm_filter_by_numa_node(struct ndctl_dimm *dimm,
-		int numa_node)
+static bool dimm_match_numa_node(struct ndctl_dimm *dimm, int numa_node)
 {
 	struct ndctl_bus *bus = ndctl_dimm_get_bus(dimm);
 	struct ndctl_region *region;
 	struct ndctl_dimm *check;
 
 	if (numa_node == NUMA_NO_NODE)
-		return dimm;
+		return true;
 
 	ndctl_region_foreach(bus, region)
 		ndctl_dimm_foreach_in_region(region, check)
 			if (check == dimm &&
 			    ndctl_region_get_numa_node(region) == numa_node)
-				return dimm;
-
-	return NULL;
+				return true;
+	return false;
 }
 
-struct ndctl_region *util_region_filter_by_namespace(struct ndctl_region *region,
-		const char *ident)
-{
-	struct ndctl_namespace *ndns;
-
-	if (!ident || strcmp(ident, "all") == 0)
-		return region;
-
-	ndctl_namespace_foreach(region, ndns)
-		if (util_namespace_filter(ndns, ident))
-			return region;
-	return NULL;
+/*
+ * The string based helpers below compile @ident once per call, prefer
+ * util_filter_compile() when matching many objects against the same
+ * identifiers.
+ */
+#define DEFINE_IDENT_FILTER(type, name, class, match)			\
+type *name(type *obj, const char *ident)				\
+{									\
+	struct util_filter_ids ids;					\
+	bool found;							\
+									\
+	if (!ident)							\
+		return obj;						\
+	if (util_filter_ids_parse(&ids, ident, class) < 0)		\
+		return NULL;						\
+	found = match(&ids, obj);					\
+	util_filter_ids_release(&ids);					\
+	return found ? obj : NULL;					\
 }
 
+DEFINE_IDENT_FILTER(struct ndctl_bus, util_bus_filter, FILTER_BUS,
+		ids_match_bus)
+DEFINE_IDENT_FILTER(struct ndctl_region, util_region_filter, FILTER_REGION,
+		ids_match_region)
+DEFINE_IDENT_FILTER(struct ndctl_namespace, util_namespace_filter,
+		FILTER_NAMESPACE, ids_match_namespace)
+DEFINE_IDENT_FILTER(struct ndctl_dimm, util_dimm_filter, FILTER_DIMM,
+		ids_match_dimm)
+DEFINE_IDENT_FILTER(struct ndctl_bus, util_bus_filter_by_dimm, FILTER_DIMM,
+		ids_match_bus_by_dimm)
+DEFINE_IDENT_FILTER(struct ndctl_bus, util_bus_filter_by_region,
+		FILTER_REGION, ids_match_bus_by_region)
+DEFINE_IDENT_FILTER(struct ndctl_bus, util_bus_filter_by_namespace,
+		FILTER_NAMESPACE, ids_match_bus_by_namespace)
+DEFINE_IDENT_FILTER(struct ndctl_region, util_region_filter_by_dimm,
+		FILTER_DIMM, ids_match_region_by_dimm)
+DEFINE_IDENT_FILTER(struct ndctl_dimm, util_dimm_filter_by_region,
+		FILTER_REGION, ids_match_dimm_by_region)
+DEFINE_IDENT_FILTER(struct ndctl_dimm, util_dimm_filter_by_namespace,
+		FILTER_NAMESPACE, ids_match_dimm_by_namespace)
+DEFINE_IDENT_FILTER(struct ndctl_region, util_region_filter_by_namespace,
+		FILTER_NAMESPACE, ids_match_region_by_namespace)
+
 struct daxctl_dev *util_daxctl_dev_filter(struct daxctl_dev *dev,
 		const char *ident)
 {
@@ -358,13 +465,33 @@ static enum ndctl_namespace_mode mode_to_type(const char *mode)
 	return NDCTL_NS_MODE_UNKNOWN;
 }
 
-int util_filter_walk(struct ndctl_ctx *ctx, struct util_filter_ctx *fctx,
+void util_filter_release(struct util_filter *filter)
+{
+	util_filter_ids_release(&filter->bus);
+	util_filter_ids_release(&filter->region);
+	util_filter_ids_release(&filter->dimm);
+	util_filter_ids_release(&filter->namespace);
+}
+
+static int filter_ids_compile(struct util_filter_ids *ids, const char *ident,
+		enum filter_class class, const char *desc)
+{
+	int rc = util_filter_ids_parse(ids, ident, class);
+
+	if (rc == -ERANGE)
+		error("invalid %s range: '%s'\n", desc, ident);
+	return rc;
+}
+
+int util_filter_compile(struct util_filter *filter,
 		struct util_filter_params *param)
 {
-	struct ndctl_bus *bus;
-	unsigned int type = 0;
-	int numa_node = NUMA_NO_NODE;
 	char *end = NULL;
+	int rc;
+
+	memset(filter, 0, sizeof(*filter));
+	filter->mode = -1;
+	filter->numa_node = NUMA_NO_NODE;
 
 	if (param->type && (strcmp(param->type, "pmem") != 0
 				&& strcmp(param->type, "blk") != 0)) {
@@ -375,14 +502,17 @@ int util_filter_walk(struct ndctl_ctx *ctx, struct util_filter_ctx *fctx,
 
 	if (param->type) {
 		if (strcmp(param->type, "pmem") == 0)
-			type = ND_DEVICE_REGION_PMEM;
+			filter->type = ND_DEVICE_REGION_PMEM;
 		else
-			type = ND_DEVICE_REGION_BLK;
+			filter->type = ND_DEVICE_REGION_BLK;
 	}
 
-	if (mode_to_type(param->mode) == NDCTL_NS_MODE_UNKNOWN) {
-		error("invalid mode: '%s'\n", param->mode);
-		return -EINVAL;
+	if (param->mode) {
+		filter->mode = mode_to_type(param->mode);
+		if (filter->mode == NDCTL_NS_MODE_UNKNOWN) {
+			error("invalid mode: '%s'\n", param->mode);
+			return -EINVAL;
+		}
 	}
 
 	if (param->numa_node && strcmp(param->numa_node, "all") != 0) {
@@ -393,21 +523,84 @@ int util_filter_walk(struct ndctl_ctx *ctx, struct util_filter_ctx *fctx,
 			return -EINVAL;
 		}
 
-		numa_node = strtol(param->numa_node, &end, 0);
+		filter->numa_node = strtol(param->numa_node, &end, 0);
 		if (end == param->numa_node || end[0]) {
 			error("invalid numa_node: '%s'\n", param->numa_node);
 			return -EINVAL;
 		}
 	}
 
+	rc = filter_ids_compile(&filter->bus, param->bus, FILTER_BUS, "bus");
+	if (!rc)
+		rc = filter_ids_compile(&filter->region, param->region,
+				FILTER_REGION, "region");
+	if (!rc)
+		rc = filter_ids_compile(&filter->dimm, param->dimm,
+				FILTER_DIMM, "dimm");
+	if (!rc)
+		rc = filter_ids_compile(&filter->namespace, param->namespace,
+				FILTER_NAMESPACE, "namespace");
+	if (rc)
+		util_filter_release(filter);
+	return rc;
+}
+
+bool util_filter_match_bus(struct util_filter *filter, struct ndctl_bus *bus)
+{
+	return ids_match_bus(&filter->bus, bus);
+}
+
+bool util_filter_match_region(struct util_filter *filter,
+		struct ndctl_region *region)
+{
+	if (!ids_match_region(&filter->region, region))
+		return false;
+	if (filter->numa_node != NUMA_NO_NODE
+			&& ndctl_region_get_numa_node(region)
+			!= filter->numa_node)
+		return false;
+	if (filter->type && ndctl_region_get_type(region) != filter->type)
+		return false;
+	return true;
+}
+
+bool util_filter_match_dimm(struct util_filter *filter,
+		struct ndctl_dimm *dimm)
+{
+	return ids_match_dimm(&filter->dimm, dimm);
+}
+
+bool util_filter_match_namespace(struct util_filter *filter,
+		struct ndctl_namespace *ndns)
+{
+	if (!ids_match_namespace(&filter->namespace, ndns))
+		return false;
+	if (filter->mode >= 0
+			&& (int) ndctl_namespace_get_mode(ndns) != filter->mode)
+		return false;
+	return true;
+}
+
+int util_filter_walk(struct ndctl_ctx *ctx, struct util_filter_ctx *fctx,
+		struct util_filter_params *param)
+{
+	struct util_filter filter;
+	struct ndctl_bus *bus;
+	int rc;
+
+	rc = util_filter_compile(&filter, param);
+	if (rc)
+		return rc;
+
 	ndctl_bus_foreach(ctx, bus) {
 		struct ndctl_region *region;
 		struct ndctl_dimm *dimm;
 
-		if (!util_bus_filter(bus, param->bus)
-				|| !util_bus_filter_by_dimm(bus, param->dimm)
-				|| !util_bus_filter_by_region(bus, param->region)
-				|| !util_bus_filter_by_namespace(bus, param->namespace))
+		if (!util_filter_match_bus(&filter, bus)
+				|| !ids_match_bus_by_dimm(&filter.dimm, bus)
+				|| !ids_match_bus_by_region(&filter.region, bus)
+				|| !ids_match_bus_by_namespace(&filter.namespace,
+					bus))
 			continue;
 
 		if (!fctx->filter_bus(bus, fctx))
@@ -417,13 +610,13 @@ int util_filter_walk(struct ndctl_ctx *ctx, struct util_filter_ctx *fctx,
 			if (!fctx->filter_dimm)
 				break;
 
-			if (!util_dimm_filter(dimm, param->dimm)
-					|| !util_dimm_filter_by_region(dimm,
-						param->region)
-					|| !util_dimm_filter_by_namespace(dimm,
-						param->namespace)
-					|| !util_dimm_filter_by_numa_node(dimm,
-						numa_node))
+			if (!util_filter_match_dimm(&filter, dimm)
+					|| !ids_match_dimm_by_region(
+						&filter.region, dimm)
+					|| !ids_match_dimm_by_namespace(
+						&filter.namespace, dimm)
+					|| !dimm_match_numa_node(dimm,
+						filter.numa_node))
 				continue;
 
 			fctx->filter_dimm(dimm, fctx);
@@ -432,38 +625,27 @@ int util_filter_walk(struct ndctl_ctx *ctx, struct util_filter_ctx *fctx,
 		ndctl_region_foreach(bus, region) {
 			struct ndctl_namespace *ndns;
 
-			if (!util_region_filter(region, param->region)
-					|| !util_region_filter_by_dimm(region,
-						param->dimm)
-					|| !util_region_filter_by_namespace(region,
-						param->namespace))
-				continue;
-
-			if (numa_node != NUMA_NO_NODE &&
-			    ndctl_region_get_numa_node(region) != numa_node)
-				continue;
-
-			if (type && ndctl_region_get_type(region) != type)
+			if (!util_filter_match_region(&filter, region)
+					|| !ids_match_region_by_dimm(
+						&filter.dimm, region)
+					|| !ids_match_region_by_namespace(
+						&filter.namespace, region))
 				continue;
 
 			if (!fctx->filter_region(region, fctx))
 				continue;
 
 			ndctl_namespace_foreach(region, ndns) {
-				enum ndctl_namespace_mode mode;
-
 				if (!fctx->filter_namespace)
 					break;
-				if (!util_namespace_filter(ndns, param->namespace))
-					continue;
-
-				mode = ndctl_namespace_get_mode(ndns);
-				if (param->mode && mode_to_type(param->mode) != mode)
+				if (!util_filter_match_namespace(&filter, ndns))
 					continue;
 
 				fctx->filter_namespace(ndns, fctx);
 			}
 		}
 	}
+
+	util_filter_release(&filter);
 	return 0;
 }
@@ -40,7 +40,7 @@ struct daxctl_dev *util_daxctl_dev_filter(struct daxctl_dev *dev,
 
 struct json_object;
 
-/* json object hierarchy for the util_filter_walk() performed by cmd_list() */
+/* json object hierarchy for util_filter_walk() callbacks */
 struct list_filter_arg {
 	struct json_object *jnamespaces;
 	struct json_object *jregions;
@@ -53,8 +53,12 @@ struct list_filter_arg {
 
 struct monitor_filter_arg {
 	struct list_head dimms;
+	struct list_head regions;
+	struct list_head busses;
 	int maxfd_dimm;
 	int num_dimm;
+	int num_region;
+	int num_bus;
 	unsigned long flags;
 };
 
@@ -89,6 +93,58 @@ struct util_filter_params {
 	const char *numa_node;
 };
 
+/*
+ * struct util_filter_ids - compiled form of an object identifier list
+ * @all: no identifier, or the keyword "all", was specified
+ * @ranges: inclusive id ranges, @parent is the region id of namespace
+ *	'X.Y' identifiers and 0 otherwise
+ * @names: identifiers that do not parse as ids (e.g. bus provider names)
+ */
+struct util_filter_range {
+	unsigned long parent;
+	unsigned long start;
+	unsigned long end;
+};
+
+struct util_filter_ids {
+	bool all;
+	int num_ranges;
+	struct util_filter_range *ranges;
+	int num_names;
+	char **names;
+	char *buf;
+};
+
+/*
+ * struct util_filter - util_filter_params compiled by util_filter_compile()
+ * so that util_filter_walk() and friends evaluate integer predicates
+ * rather than re-parsing strings for every candidate object.
+ * @type: region type, or 0 for any
+ * @mode: enum ndctl_namespace_mode, or -1 for any
+ * @numa_node: numa node, or -1 (NUMA_NO_NODE) for any
+ */
+#define NUMA_NO_NODE    (-1)
+struct util_filter {
+	struct util_filter_ids bus;
+	struct util_filter_ids region;
+	struct util_filter_ids dimm;
+	struct util_filter_ids namespace;
+	unsigned int type;
+	int mode;
+	int numa_node;
+};
+
+int util_filter_compile(struct util_filter *filter,
+		struct util_filter_params *param);
+void util_filter_release(struct util_filter *filter);
+bool util_filter_match_bus(struct util_filter *filter, struct ndctl_bus *bus);
+bool util_filter_match_region(struct util_filter *filter,
+		struct ndctl_region *region);
+bool util_filter_match_dimm(struct util_filter *filter,
+		struct ndctl_dimm *dimm);
+bool util_filter_match_namespace(struct util_filter *filter,
+		struct ndctl_namespace *ndns);
+
 struct ndctl_ctx;
 int util_filter_walk(struct ndctl_ctx *ctx, struct util_filter_ctx *fctx,
 		struct util_filter_params *param);
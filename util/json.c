@@ -122,6 +122,171 @@ void util_display_json_array(FILE *f_out, struct json_object *jarray,
 	json_object_put(jarray);
 }
 
+void util_json_stream_init(struct util_json_stream *js, FILE *f_out,
+		unsigned long flags)
+{
+	memset(js, 0, sizeof(*js));
+	js->f_out = f_out;
+	js->f = f_out;
+	js->flags = flags;
+}
+
+static void stream_indent(struct util_json_stream *js, int level)
+{
+	fprintf(js->f, "%*s", level * 2, "");
+}
+
+/*
+ * Write a JSON_C_TO_STRING_PRETTY rendered value, or the deferred first
+ * list element, re-indented to @level.
+ */
+static void stream_write(struct util_json_stream *js, const char *str,
+		int level)
+{
+	const char *nl;
+
+	while ((nl = strchr(str, '\n'))) {
+		fwrite(str, 1, nl - str + 1, js->f);
+		stream_indent(js, level);
+		str = nl + 1;
+	}
+	fputs(str, js->f);
+}
+
+static void stream_push(struct util_json_stream *js, bool array)
+{
+	fputs(array ? "[\n" : "{\n", js->f);
+	js->array[js->depth] = array;
+	js->count[js->depth] = 0;
+	js->depth++;
+}
+
+/*
+ * Emit the first list element into a buffer when --human output is
+ * requested, a list of one is displayed as the bare element.
+ */
+static void stream_list_element(struct util_json_stream *js)
+{
+	FILE *f;
+
+	if (js->list_count++ == 0) {
+		if (js->flags & UTIL_JSON_HUMAN) {
+			f = open_memstream(&js->buf, &js->buf_len);
+			if (f) {
+				js->f = f;
+				return;
+			}
+		}
+		stream_push(js, true);
+		js->list_depth = 1;
+		return;
+	}
+
+	if (js->f == js->f_out)
+		return;
+
+	fclose(js->f);
+	js->f = js->f_out;
+	stream_push(js, true);
+	js->list_depth = 1;
+	js->count[0] = 1;
+	stream_indent(js, 1);
+	stream_write(js, js->buf, 1);
+	free(js->buf);
+	js->buf = NULL;
+}
+
+static void stream_member(struct util_json_stream *js, const char *key)
+{
+	if (js->list && js->depth == js->list_depth)
+		stream_list_element(js);
+
+	if (js->depth) {
+		if (js->count[js->depth - 1]++)
+			fputs(",\n", js->f);
+		stream_indent(js, js->depth);
+	}
+
+	if (key)
+		fprintf(js->f, "\"%s\":", key);
+}
+
+static void stream_complete(struct util_json_stream *js)
+{
+	if (js->depth == 0 && !js->list)
+		fputc('\n', js->f);
+}
+
+void util_json_stream_list_begin(struct util_json_stream *js)
+{
+	js->list = true;
+	js->list_count = 0;
+	js->list_depth = js->depth;
+}
+
+void util_json_stream_array_begin(struct util_json_stream *js,
+		const char *key)
+{
+	stream_member(js, key);
+	stream_push(js, true);
+}
+
+void util_json_stream_object_begin(struct util_json_stream *js,
+		const char *key, struct json_object *jobj)
+{
+	stream_member(js, key);
+	stream_push(js, false);
+	if (!jobj)
+		return;
+
+	{
+		json_object_object_foreach(jobj, jkey, jval) {
+			stream_member(js, jkey);
+			stream_write(js, json_object_to_json_string_ext(jval,
+						JSON_C_TO_STRING_PRETTY),
+					js->depth);
+		}
+	}
+	json_object_put(jobj);
+}
+
+void util_json_stream_add(struct util_json_stream *js, const char *key,
+		struct json_object *jobj)
+{
+	stream_member(js, key);
+	stream_write(js, json_object_to_json_string_ext(jobj,
+				JSON_C_TO_STRING_PRETTY), js->depth);
+	json_object_put(jobj);
+	stream_complete(js);
+}
+
+void util_json_stream_end(struct util_json_stream *js)
+{
+	if (js->list && js->depth == js->list_depth) {
+		js->list = false;
+		if (js->f != js->f_out) {
+			fclose(js->f);
+			js->f = js->f_out;
+			fprintf(js->f, "%s\n", js->buf);
+			free(js->buf);
+			js->buf = NULL;
+			return;
+		}
+		if (!js->list_count)
+			return;
+	}
+
+	if (!js->depth)
+		return;
+
+	js->depth--;
+	if (js->count[js->depth])
+		fputc('\n', js->f);
+	stream_indent(js, js->depth);
+	fputc(js->array[js->depth] ? ']' : '}', js->f);
+	stream_complete(js);
+}
+
 struct json_object *util_bus_to_json(struct ndctl_bus *bus)
 {
 	struct json_object *jbus = json_object_new_object();
@@ -959,6 +1124,29 @@ struct json_object *util_namespace_to_json(struct ndctl_namespace *ndns,
 	return NULL;
 }
 
+/*
+ * Media error count for a namespace as reported by util_namespace_to_json()
+ * without building the badblocks list.
+ */
+unsigned int util_namespace_badblock_count(struct ndctl_namespace *ndns)
+{
+	struct ndctl_btt *btt = ndctl_namespace_get_btt(ndns);
+	struct ndctl_pfn *pfn = ndctl_namespace_get_pfn(ndns);
+	struct ndctl_dax *dax = ndctl_namespace_get_dax(ndns);
+	unsigned int bb_count = 0;
+
+	if (pfn)
+		util_pfn_badblocks_to_json(pfn, &bb_count, 0);
+	else if (dax)
+		util_dax_badblocks_to_json(dax, &bb_count, 0);
+	else if (btt)
+		util_btt_badblocks_to_json(btt, &bb_count);
+	else
+		util_region_badblocks_to_json(ndctl_namespace_get_region(ndns),
+				&bb_count, 0);
+	return bb_count;
+}
+
 struct json_object *util_mapping_to_json(struct ndctl_mapping *mapping,
 		unsigned long flags)
 {
@@ -29,6 +29,43 @@ enum util_json_flags {
 struct json_object;
 void util_display_json_array(FILE *f_out, struct json_object *jarray,
 		unsigned long flags);
+
+#define UTIL_JSON_STREAM_DEPTH 8
+
+/*
+ * struct util_json_stream - emit JSON_C_TO_STRING_PRETTY formatted output
+ * incrementally as objects are generated rather than building the full
+ * json_object hierarchy first. Objects and arrays are opened with
+ * util_json_stream_{object,array}_begin(), filled with
+ * util_json_stream_add(), and closed with util_json_stream_end(). A
+ * top-level list started with util_json_stream_list_begin() follows the
+ * util_display_json_array() convention of displaying a single element
+ * without the enclosing array in UTIL_JSON_HUMAN mode.
+ */
+struct util_json_stream {
+	FILE *f_out;
+	FILE *f;
+	unsigned long flags;
+	int depth;
+	int count[UTIL_JSON_STREAM_DEPTH];
+	bool array[UTIL_JSON_STREAM_DEPTH];
+	bool list;
+	int list_depth;
+	int list_count;
+	char *buf;
+	size_t buf_len;
+};
+
+void util_json_stream_init(struct util_json_stream *js, FILE *f_out,
+		unsigned long flags);
+void util_json_stream_list_begin(struct util_json_stream *js);
+void util_json_stream_array_begin(struct util_json_stream *js,
+		const char *key);
+void util_json_stream_object_begin(struct util_json_stream *js,
+		const char *key, struct json_object *jobj);
+void util_json_stream_add(struct util_json_stream *js, const char *key,
+		struct json_object *jobj);
+void util_json_stream_end(struct util_json_stream *js);
 struct json_object *util_bus_to_json(struct ndctl_bus *bus);
 struct json_object *util_dimm_to_json(struct ndctl_dimm *dimm,
 		unsigned long flags);
@@ -36,6 +73,7 @@ struct json_object *util_mapping_to_json(struct ndctl_mapping *mapping,
 		unsigned long flags);
 struct json_object *util_namespace_to_json(struct ndctl_namespace *ndns,
 		unsigned long flags);
+unsigned int util_namespace_badblock_count(struct ndctl_namespace *ndns);
 struct json_object *util_badblock_rec_to_json(u64 block, u64 count,
 		unsigned long flags);
 struct daxctl_region;
@@ -54,6 +92,8 @@ struct json_object *util_json_object_size(unsigned long long size,
 struct json_object *util_json_object_hex(unsigned long long val,
 		unsigned long flags);
 struct json_object *util_dimm_health_to_json(struct ndctl_dimm *dimm);
+struct json_object *util_dimm_smart_to_json(struct ndctl_dimm *dimm,
+		struct ndctl_cmd *cmd);
 struct json_object *util_dimm_firmware_to_json(struct ndctl_dimm *dimm,
 		unsigned long flags);
 #endif /* __NDCTL_JSON_H__ */
@@ -0,0 +1,642 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* Copyright(c) 2018 Intel Corporation. All rights reserved. */
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <util/json.h>
+#include <util/record.h>
+#include <uuid/uuid.h>
+#include <ndctl/libndctl.h>
+#include <daxctl/libdaxctl.h>
+#include <ccan/endian/endian.h>
+#include <ccan/array_size/array_size.h>
+#include <ndctl.h>
+
+static const char *field_names[] = {
+	[UTIL_FIELD_DEV] = "dev",
+	[UTIL_FIELD_BUS] = "bus",
+	[UTIL_FIELD_REGION] = "region",
+	[UTIL_FIELD_PROVIDER] = "provider",
+	[UTIL_FIELD_SCRUB_STATE] = "scrub_state",
+	[UTIL_FIELD_ID] = "id",
+	[UTIL_FIELD_HANDLE] = "handle",
+	[UTIL_FIELD_PHYS_ID] = "phys_id",
+	[UTIL_FIELD_STATE] = "state",
+	[UTIL_FIELD_FLAG_FAILED_MAP] = "flag_failed_map",
+	[UTIL_FIELD_FLAG_FAILED_SAVE] = "flag_failed_save",
+	[UTIL_FIELD_FLAG_FAILED_ARM] = "flag_failed_arm",
+	[UTIL_FIELD_FLAG_FAILED_RESTORE] = "flag_failed_restore",
+	[UTIL_FIELD_FLAG_FAILED_FLUSH] = "flag_failed_flush",
+	[UTIL_FIELD_FLAG_SMART_EVENT] = "flag_smart_event",
+	[UTIL_FIELD_HEALTH_STATE] = "health_state",
+	[UTIL_FIELD_TEMPERATURE] = "temperature_celsius",
+	[UTIL_FIELD_CTRL_TEMPERATURE] = "controller_temperature_celsius",
+	[UTIL_FIELD_SPARES] = "spares_percentage",
+	[UTIL_FIELD_ALARM_TEMPERATURE] = "alarm_temperature",
+	[UTIL_FIELD_ALARM_CTRL_TEMPERATURE] = "alarm_controller_temperature",
+	[UTIL_FIELD_ALARM_SPARES] = "alarm_spares",
+	[UTIL_FIELD_ALARM_ENABLED_TEMPERATURE] =
+		"alarm_enabled_media_temperature",
+	[UTIL_FIELD_TEMPERATURE_THRESHOLD] = "temperature_threshold",
+	[UTIL_FIELD_ALARM_ENABLED_CTRL_TEMPERATURE] =
+		"alarm_enabled_ctrl_temperature",
+	[UTIL_FIELD_CTRL_TEMPERATURE_THRESHOLD] =
+		"controller_temperature_threshold",
+	[UTIL_FIELD_ALARM_ENABLED_SPARES] = "alarm_enabled_spares",
+	[UTIL_FIELD_SPARES_THRESHOLD] = "spares_threshold",
+	[UTIL_FIELD_LIFE_USED] = "life_used_percentage",
+	[UTIL_FIELD_SHUTDOWN_STATE] = "shutdown_state",
+	[UTIL_FIELD_SHUTDOWN_COUNT] = "shutdown_count",
+	[UTIL_FIELD_SIZE] = "size",
+	[UTIL_FIELD_AVAILABLE_SIZE] = "available_size",
+	[UTIL_FIELD_MAX_AVAILABLE_EXTENT] = "max_available_extent",
+	[UTIL_FIELD_TYPE] = "type",
+	[UTIL_FIELD_NUMA_NODE] = "numa_node",
+	[UTIL_FIELD_ISET_ID] = "iset_id",
+	[UTIL_FIELD_BADBLOCK_COUNT] = "badblock_count",
+	[UTIL_FIELD_PERSISTENCE_DOMAIN] = "persistence_domain",
+	[UTIL_FIELD_DIMM] = "dimm",
+	[UTIL_FIELD_OFFSET] = "offset",
+	[UTIL_FIELD_LENGTH] = "length",
+	[UTIL_FIELD_POSITION] = "position",
+	[UTIL_FIELD_MODE] = "mode",
+	[UTIL_FIELD_MAP] = "map",
+	[UTIL_FIELD_UUID] = "uuid",
+	[UTIL_FIELD_RAW_UUID] = "raw_uuid",
+	[UTIL_FIELD_SECTOR_SIZE] = "sector_size",
+	[UTIL_FIELD_BLOCKDEV] = "blockdev",
+	[UTIL_FIELD_CHARDEV] = "chardev",
+	[UTIL_FIELD_NAME] = "name",
+};
+
+static const char *type_names[] = {
+	[UTIL_RECORD_BUS] = "bus",
+	[UTIL_RECORD_DIMM] = "dimm",
+	[UTIL_RECORD_REGION] = "region",
+	[UTIL_RECORD_MAPPING] = "mapping",
+	[UTIL_RECORD_NAMESPACE] = "namespace",
+};
+
+static const enum util_record_field bus_fields[] = {
+	UTIL_FIELD_DEV, UTIL_FIELD_PROVIDER, UTIL_FIELD_SCRUB_STATE,
+};
+
+static const enum util_record_field dimm_fields[] = {
+	UTIL_FIELD_DEV, UTIL_FIELD_BUS, UTIL_FIELD_ID, UTIL_FIELD_HANDLE,
+	UTIL_FIELD_PHYS_ID, UTIL_FIELD_STATE, UTIL_FIELD_FLAG_FAILED_MAP,
+	UTIL_FIELD_FLAG_FAILED_SAVE, UTIL_FIELD_FLAG_FAILED_ARM,
+	UTIL_FIELD_FLAG_FAILED_RESTORE, UTIL_FIELD_FLAG_FAILED_FLUSH,
+	UTIL_FIELD_FLAG_SMART_EVENT, UTIL_FIELD_HEALTH_STATE,
+	UTIL_FIELD_TEMPERATURE, UTIL_FIELD_CTRL_TEMPERATURE,
+	UTIL_FIELD_SPARES, UTIL_FIELD_ALARM_TEMPERATURE,
+	UTIL_FIELD_ALARM_CTRL_TEMPERATURE, UTIL_FIELD_ALARM_SPARES,
+	UTIL_FIELD_ALARM_ENABLED_TEMPERATURE,
+	UTIL_FIELD_TEMPERATURE_THRESHOLD,
+	UTIL_FIELD_ALARM_ENABLED_CTRL_TEMPERATURE,
+	UTIL_FIELD_CTRL_TEMPERATURE_THRESHOLD,
+	UTIL_FIELD_ALARM_ENABLED_SPARES, UTIL_FIELD_SPARES_THRESHOLD,
+	UTIL_FIELD_LIFE_USED, UTIL_FIELD_SHUTDOWN_STATE,
+	UTIL_FIELD_SHUTDOWN_COUNT,
+};
+
+static const enum util_record_field region_fields[] = {
+	UTIL_FIELD_DEV, UTIL_FIELD_BUS, UTIL_FIELD_SIZE,
+	UTIL_FIELD_AVAILABLE_SIZE, UTIL_FIELD_MAX_AVAILABLE_EXTENT,
+	UTIL_FIELD_TYPE, UTIL_FIELD_NUMA_NODE, UTIL_FIELD_ISET_ID,
+	UTIL_FIELD_STATE, UTIL_FIELD_BADBLOCK_COUNT,
+	UTIL_FIELD_PERSISTENCE_DOMAIN,
+};
+
+static const enum util_record_field mapping_fields[] = {
+	UTIL_FIELD_REGION, UTIL_FIELD_DIMM, UTIL_FIELD_OFFSET,
+	UTIL_FIELD_LENGTH, UTIL_FIELD_POSITION,
+};
+
+static const enum util_record_field namespace_fields[] = {
+	UTIL_FIELD_DEV, UTIL_FIELD_BUS, UTIL_FIELD_REGION, UTIL_FIELD_MODE,
+	UTIL_FIELD_MAP, UTIL_FIELD_SIZE, UTIL_FIELD_UUID, UTIL_FIELD_RAW_UUID,
+	UTIL_FIELD_SECTOR_SIZE, UTIL_FIELD_BLOCKDEV, UTIL_FIELD_CHARDEV,
+	UTIL_FIELD_STATE, UTIL_FIELD_NAME, UTIL_FIELD_NUMA_NODE,
+	UTIL_FIELD_BADBLOCK_COUNT,
+};
+
+static const struct {
+	const enum util_record_field *fields;
+	int num_fields;
+} record_fields[] = {
+	[UTIL_RECORD_BUS] = { bus_fields, ARRAY_SIZE(bus_fields) },
+	[UTIL_RECORD_DIMM] = { dimm_fields, ARRAY_SIZE(dimm_fields) },
+	[UTIL_RECORD_REGION] = { region_fields, ARRAY_SIZE(region_fields) },
+	[UTIL_RECORD_MAPPING] = { mapping_fields, ARRAY_SIZE(mapping_fields) },
+	[UTIL_RECORD_NAMESPACE] = { namespace_fields,
+		ARRAY_SIZE(namespace_fields) },
+};
+
+int util_record_parse_format(const char *format,
+		enum util_record_format *fmt)
+{
+	if (!format || strcmp(format, "json") == 0)
+		*fmt = UTIL_RECORD_FMT_JSON;
+	else if (strcmp(format, "csv") == 0)
+		*fmt = UTIL_RECORD_FMT_CSV;
+	else if (strcmp(format, "ndjson") == 0)
+		*fmt = UTIL_RECORD_FMT_NDJSON;
+	else if (strcmp(format, "binary") == 0)
+		*fmt = UTIL_RECORD_FMT_BINARY;
+	else
+		return -EINVAL;
+	return 0;
+}
+
+void util_record_init(struct util_record *rec, FILE *f_out,
+		enum util_record_format format)
+{
+	memset(rec, 0, sizeof(*rec));
+	rec->f_out = f_out;
+	rec->format = format;
+}
+
+void util_record_release(struct util_record *rec)
+{
+	free(rec->strbuf);
+	rec->strbuf = NULL;
+}
+
+void util_record_begin(struct util_record *rec, enum util_record_type type)
+{
+	int i;
+
+	rec->type = type;
+	rec->error = 0;
+	rec->strbuf_len = 0;
+	for (i = 0; i < UTIL_FIELD_MAX; i++)
+		rec->values[i].kind = UTIL_RECORD_NONE;
+}
+
+void util_record_str(struct util_record *rec, enum util_record_field field,
+		const char *val)
+{
+	size_t len = strlen(val) + 1;
+
+	if (rec->strbuf_len + len > rec->strbuf_size) {
+		size_t size = (rec->strbuf_len + len) * 2;
+		char *buf = realloc(rec->strbuf, size);
+
+		if (!buf) {
+			rec->error = -ENOMEM;
+			return;
+		}
+		rec->strbuf = buf;
+		rec->strbuf_size = size;
+	}
+
+	memcpy(rec->strbuf + rec->strbuf_len, val, len);
+	rec->values[field].kind = UTIL_RECORD_STR;
+	rec->values[field].str = rec->strbuf_len;
+	rec->strbuf_len += len;
+}
+
+void util_record_u64(struct util_record *rec, enum util_record_field field,
+		u64 val)
+{
+	rec->values[field].kind = UTIL_RECORD_U64;
+	rec->values[field].num = val;
+}
+
+void util_record_s64(struct util_record *rec, enum util_record_field field,
+		s64 val)
+{
+	rec->values[field].kind = UTIL_RECORD_S64;
+	rec->values[field].snum = val;
+}
+
+void util_record_double(struct util_record *rec, enum util_record_field field,
+		double val)
+{
+	rec->values[field].kind = UTIL_RECORD_DOUBLE;
+	rec->values[field].dbl = val;
+}
+
+void util_record_bool(struct util_record *rec, enum util_record_field field,
+		bool val)
+{
+	rec->values[field].kind = UTIL_RECORD_BOOL;
+	rec->values[field].flag = val;
+}
+
+static void csv_str(FILE *f, const char *str)
+{
+	if (!strpbrk(str, ",\"\n")) {
+		fputs(str, f);
+		return;
+	}
+
+	fputc('"', f);
+	for (; *str; str++) {
+		if (*str == '"')
+			fputc('"', f);
+		fputc(*str, f);
+	}
+	fputc('"', f);
+}
+
+static void json_str(FILE *f, const char *str)
+{
+	fputc('"', f);
+	for (; *str; str++) {
+		unsigned char c = *str;
+
+		if (c == '"' || c == '\\')
+			fprintf(f, "\\%c", c);
+		else if (c < 0x20)
+			fprintf(f, "\\u%04x", c);
+		else
+			fputc(c, f);
+	}
+	fputc('"', f);
+}
+
+static void record_value(struct util_record *rec,
+		struct util_record_value *val)
+{
+	FILE *f = rec->f_out;
+
+	switch (val->kind) {
+	case UTIL_RECORD_STR:
+		if (rec->format == UTIL_RECORD_FMT_CSV)
+			csv_str(f, rec->strbuf + val->str);
+		else
+			json_str(f, rec->strbuf + val->str);
+		break;
+	case UTIL_RECORD_U64:
+		fprintf(f, "%llu", (unsigned long long) val->num);
+		break;
+	case UTIL_RECORD_S64:
+		fprintf(f, "%lld", (long long) val->snum);
+		break;
+	case UTIL_RECORD_DOUBLE:
+		fprintf(f, "%g", val->dbl);
+		break;
+	case UTIL_RECORD_BOOL:
+		fputs(val->flag ? "true" : "false", f);
+		break;
+	default:
+		break;
+	}
+}
+
+static int record_csv(struct util_record *rec)
+{
+	const enum util_record_field *fields = record_fields[rec->type].fields;
+	int i, num_fields = record_fields[rec->type].num_fields;
+	FILE *f = rec->f_out;
+
+	if (!(rec->headers & (1UL << rec->type))) {
+		rec->headers |= 1UL << rec->type;
+		fputs("type", f);
+		for (i = 0; i < num_fields; i++)
+			fprintf(f, ",%s", field_names[fields[i]]);
+		fputc('\n', f);
+	}
+
+	fputs(type_names[rec->type], f);
+	for (i = 0; i < num_fields; i++) {
+		fputc(',', f);
+		record_value(rec, &rec->values[fields[i]]);
+	}
+	fputc('\n', f);
+	return 0;
+}
+
+static int record_ndjson(struct util_record *rec)
+{
+	const enum util_record_field *fields = record_fields[rec->type].fields;
+	int i, num_fields = record_fields[rec->type].num_fields;
+	FILE *f = rec->f_out;
+
+	fprintf(f, "{\"type\":\"%s\"", type_names[rec->type]);
+	for (i = 0; i < num_fields; i++) {
+		struct util_record_value *val = &rec->values[fields[i]];
+
+		if (val->kind == UTIL_RECORD_NONE)
+			continue;
+		fprintf(f, ",\"%s\":", field_names[fields[i]]);
+		record_value(rec, val);
+	}
+	fputs("}\n", f);
+	return 0;
+}
+
+static size_t binary_put(u8 *buf, size_t len, size_t size, const void *src,
+		size_t count)
+{
+	if (len + count <= size)
+		memcpy(buf + len, src, count);
+	return len + count;
+}
+
+static int record_binary(struct util_record *rec)
+{
+	const enum util_record_field *fields = record_fields[rec->type].fields;
+	int i, num_fields = record_fields[rec->type].num_fields;
+	u8 buf[4096], hdr[2], nfields = 0;
+	size_t len = sizeof(u16) + sizeof(hdr);
+	leint16_t len16;
+
+	if (!rec->magic) {
+		rec->magic = true;
+		fwrite("ndr1", 1, 4, rec->f_out);
+	}
+
+	for (i = 0; i < num_fields; i++) {
+		struct util_record_value *val = &rec->values[fields[i]];
+		u8 key[2] = { fields[i], val->kind };
+		leint64_t val64;
+		u64 bits;
+		u8 flag;
+
+		switch (val->kind) {
+		case UTIL_RECORD_STR: {
+			const char *str = rec->strbuf + val->str;
+			size_t slen = strlen(str);
+
+			if (slen > USHRT_MAX)
+				slen = USHRT_MAX;
+			len = binary_put(buf, len, sizeof(buf), key, sizeof(key));
+			len16 = cpu_to_le16(slen);
+			len = binary_put(buf, len, sizeof(buf), &len16,
+					sizeof(len16));
+			len = binary_put(buf, len, sizeof(buf), str, slen);
+			break;
+		}
+		case UTIL_RECORD_U64:
+		case UTIL_RECORD_S64:
+		case UTIL_RECORD_DOUBLE:
+			if (val->kind == UTIL_RECORD_DOUBLE)
+				memcpy(&bits, &val->dbl, sizeof(bits));
+			else
+				bits = val->num;
+			val64 = cpu_to_le64(bits);
+			len = binary_put(buf, len, sizeof(buf), key, sizeof(key));
+			len = binary_put(buf, len, sizeof(buf), &val64,
+					sizeof(val64));
+			break;
+		case UTIL_RECORD_BOOL:
+			flag = val->flag;
+			len = binary_put(buf, len, sizeof(buf), key, sizeof(key));
+			len = binary_put(buf, len, sizeof(buf), &flag,
+					sizeof(flag));
+			break;
+		default:
+			continue;
+		}
+		nfields++;
+	}
+
+	if (len > sizeof(buf))
+		return -E2BIG;
+
+	len16 = cpu_to_le16(len - sizeof(u16));
+	memcpy(buf, &len16, sizeof(len16));
+	hdr[0] = rec->type;
+	hdr[1] = nfields;
+	memcpy(buf + sizeof(u16), hdr, sizeof(hdr));
+
+	if (fwrite(buf, 1, len, rec->f_out) != len)
+		return -EIO;
+	return 0;
+}
+
+int util_record_end(struct util_record *rec)
+{
+	if (rec->error)
+		return rec->error;
+
+	switch (rec->format) {
+	case UTIL_RECORD_FMT_CSV:
+		return record_csv(rec);
+	case UTIL_RECORD_FMT_NDJSON:
+		return record_ndjson(rec);
+	case UTIL_RECORD_FMT_BINARY:
+		return record_binary(rec);
+	default:
+		return -EINVAL;
+	}
+}
+
+void util_bus_to_record(struct ndctl_bus *bus, struct util_record *rec)
+{
+	int scrub;
+
+	util_record_str(rec, UTIL_FIELD_PROVIDER, ndctl_bus_get_provider(bus));
+	util_record_str(rec, UTIL_FIELD_DEV, ndctl_bus_get_devname(bus));
+
+	scrub = ndctl_bus_get_scrub_state(bus);
+	if (scrub >= 0)
+		util_record_str(rec, UTIL_FIELD_SCRUB_STATE,
+				scrub ? "active" : "idle");
+}
+
+void util_dimm_to_record(struct ndctl_dimm *dimm, struct util_record *rec)
+{
+	const char *id = ndctl_dimm_get_unique_id(dimm);
+	unsigned int handle = ndctl_dimm_get_handle(dimm);
+	unsigned short phys_id = ndctl_dimm_get_phys_id(dimm);
+	struct ndctl_bus *bus = ndctl_dimm_get_bus(dimm);
+
+	util_record_str(rec, UTIL_FIELD_DEV, ndctl_dimm_get_devname(dimm));
+	util_record_str(rec, UTIL_FIELD_BUS, ndctl_bus_get_devname(bus));
+	if (id)
+		util_record_str(rec, UTIL_FIELD_ID, id);
+	if (handle < UINT_MAX)
+		util_record_u64(rec, UTIL_FIELD_HANDLE, handle);
+	if (phys_id < USHRT_MAX)
+		util_record_u64(rec, UTIL_FIELD_PHYS_ID, phys_id);
+	if (!ndctl_dimm_is_enabled(dimm))
+		util_record_str(rec, UTIL_FIELD_STATE, "disabled");
+	if (ndctl_dimm_failed_map(dimm))
+		util_record_bool(rec, UTIL_FIELD_FLAG_FAILED_MAP, true);
+	if (ndctl_dimm_failed_save(dimm))
+		util_record_bool(rec, UTIL_FIELD_FLAG_FAILED_SAVE, true);
+	if (ndctl_dimm_failed_arm(dimm))
+		util_record_bool(rec, UTIL_FIELD_FLAG_FAILED_ARM, true);
+	if (ndctl_dimm_failed_restore(dimm))
+		util_record_bool(rec, UTIL_FIELD_FLAG_FAILED_RESTORE, true);
+	if (ndctl_dimm_failed_flush(dimm))
+		util_record_bool(rec, UTIL_FIELD_FLAG_FAILED_FLUSH, true);
+	if (ndctl_dimm_smart_pending(dimm))
+		util_record_bool(rec, UTIL_FIELD_FLAG_SMART_EVENT, true);
+}
+
+void util_mapping_to_record(struct ndctl_mapping *mapping,
+		struct util_record *rec)
+{
+	struct ndctl_region *region = ndctl_mapping_get_region(mapping);
+	struct ndctl_dimm *dimm = ndctl_mapping_get_dimm(mapping);
+	int position;
+
+	util_record_str(rec, UTIL_FIELD_REGION,
+			ndctl_region_get_devname(region));
+	util_record_str(rec, UTIL_FIELD_DIMM, ndctl_dimm_get_devname(dimm));
+	util_record_u64(rec, UTIL_FIELD_OFFSET,
+			ndctl_mapping_get_offset(mapping));
+	util_record_u64(rec, UTIL_FIELD_LENGTH,
+			ndctl_mapping_get_length(mapping));
+	position = ndctl_mapping_get_position(mapping);
+	if (position >= 0)
+		util_record_u64(rec, UTIL_FIELD_POSITION, position);
+}
+
+static void util_raw_uuid_to_record(struct ndctl_namespace *ndns,
+		struct util_record *rec, unsigned long flags)
+{
+	char buf[40];
+	uuid_t raw_uuid;
+
+	if (!(flags & UTIL_JSON_VERBOSE))
+		return;
+
+	ndctl_namespace_get_uuid(ndns, raw_uuid);
+	if (uuid_is_null(raw_uuid))
+		return;
+	uuid_unparse(raw_uuid, buf);
+	util_record_str(rec, UTIL_FIELD_RAW_UUID, buf);
+}
+
+/* fails, like util_namespace_to_json(), for a half configured namespace */
+int util_namespace_to_record(struct ndctl_namespace *ndns,
+		struct util_record *rec, unsigned long flags)
+{
+	struct ndctl_region *region = ndctl_namespace_get_region(ndns);
+	struct ndctl_bus *bus = ndctl_namespace_get_bus(ndns);
+	enum ndctl_pfn_loc loc = NDCTL_PFN_LOC_NONE;
+	const char *locations[] = {
+		[NDCTL_PFN_LOC_NONE] = "none",
+		[NDCTL_PFN_LOC_RAM] = "mem",
+		[NDCTL_PFN_LOC_PMEM] = "dev",
+	};
+	unsigned long long size = ULLONG_MAX;
+	unsigned int sector_size = UINT_MAX;
+	enum ndctl_namespace_mode mode;
+	const char *bdev = NULL, *name;
+	const char *mode_name = NULL;
+	unsigned int bb_count;
+	struct ndctl_btt *btt;
+	struct ndctl_pfn *pfn;
+	struct ndctl_dax *dax;
+	char buf[40];
+	uuid_t uuid;
+	int numa;
+
+	util_record_str(rec, UTIL_FIELD_DEV, ndctl_namespace_get_devname(ndns));
+	util_record_str(rec, UTIL_FIELD_BUS, ndctl_bus_get_devname(bus));
+	util_record_str(rec, UTIL_FIELD_REGION,
+			ndctl_region_get_devname(region));
+
+	btt = ndctl_namespace_get_btt(ndns);
+	dax = ndctl_namespace_get_dax(ndns);
+	pfn = ndctl_namespace_get_pfn(ndns);
+	mode = ndctl_namespace_get_mode(ndns);
+	switch (mode) {
+	case NDCTL_NS_MODE_MEMORY:
+		if (pfn) {
+			size = ndctl_pfn_get_size(pfn);
+			loc = ndctl_pfn_get_location(pfn);
+		} else {
+			size = ndctl_namespace_get_size(ndns);
+			loc = NDCTL_PFN_LOC_RAM;
+		}
+		mode_name = "fsdax";
+		break;
+	case NDCTL_NS_MODE_DAX:
+		if (!dax)
+			return -ENXIO;
+		size = ndctl_dax_get_size(dax);
+		mode_name = "devdax";
+		loc = ndctl_dax_get_location(dax);
+		break;
+	case NDCTL_NS_MODE_SAFE:
+		if (!btt)
+			return -ENXIO;
+		mode_name = "sector";
+		size = ndctl_btt_get_size(btt);
+		break;
+	case NDCTL_NS_MODE_RAW:
+		size = ndctl_namespace_get_size(ndns);
+		mode_name = "raw";
+		break;
+	default:
+		break;
+	}
+	if (mode_name)
+		util_record_str(rec, UTIL_FIELD_MODE, mode_name);
+
+	if ((mode != NDCTL_NS_MODE_SAFE) && (mode != NDCTL_NS_MODE_RAW))
+		util_record_str(rec, UTIL_FIELD_MAP, locations[loc]);
+
+	if (size < ULLONG_MAX)
+		util_record_u64(rec, UTIL_FIELD_SIZE, size);
+
+	if (btt) {
+		ndctl_btt_get_uuid(btt, uuid);
+		uuid_unparse(uuid, buf);
+		util_record_str(rec, UTIL_FIELD_UUID, buf);
+		util_raw_uuid_to_record(ndns, rec, flags);
+		bdev = ndctl_btt_get_block_device(btt);
+	} else if (pfn) {
+		ndctl_pfn_get_uuid(pfn, uuid);
+		uuid_unparse(uuid, buf);
+		util_record_str(rec, UTIL_FIELD_UUID, buf);
+		util_raw_uuid_to_record(ndns, rec, flags);
+		bdev = ndctl_pfn_get_block_device(pfn);
+	} else if (dax) {
+		struct daxctl_region *dax_region;
+		struct daxctl_dev *dev;
+
+		dax_region = ndctl_dax_get_daxctl_region(dax);
+		ndctl_dax_get_uuid(dax, uuid);
+		uuid_unparse(uuid, buf);
+		util_record_str(rec, UTIL_FIELD_UUID, buf);
+		util_raw_uuid_to_record(ndns, rec, flags);
+		dev = dax_region ? daxctl_dev_get_first(dax_region) : NULL;
+		if (dev)
+			util_record_str(rec, UTIL_FIELD_CHARDEV,
+					daxctl_dev_get_devname(dev));
+	} else if (ndctl_namespace_get_type(ndns) != ND_DEVICE_NAMESPACE_IO) {
+		ndctl_namespace_get_uuid(ndns, uuid);
+		uuid_unparse(uuid, buf);
+		util_record_str(rec, UTIL_FIELD_UUID, buf);
+		bdev = ndctl_namespace_get_block_device(ndns);
+	} else
+		bdev = ndctl_namespace_get_block_device(ndns);
+
+	if (btt)
+		sector_size = ndctl_btt_get_sector_size(btt);
+	else if (!dax) {
+		sector_size = ndctl_namespace_get_sector_size(ndns);
+		if (!sector_size || sector_size == UINT_MAX)
+			sector_size = 512;
+	}
+	if (sector_size < UINT_MAX && flags & UTIL_JSON_VERBOSE)
+		util_record_u64(rec, UTIL_FIELD_SECTOR_SIZE, sector_size);
+
+	if (bdev && bdev[0])
+		util_record_str(rec, UTIL_FIELD_BLOCKDEV, bdev);
+
+	if (!ndctl_namespace_is_active(ndns))
+		util_record_str(rec, UTIL_FIELD_STATE, "disabled");
+
+	name = ndctl_namespace_get_alt_name(ndns);
+	if (name && name[0])
+		util_record_str(rec, UTIL_FIELD_NAME, name);
+
+	numa = ndctl_namespace_get_numa_node(ndns);
+	if (numa >= 0 && flags & UTIL_JSON_VERBOSE)
+		util_record_s64(rec, UTIL_FIELD_NUMA_NODE, numa);
+
+	bb_count = util_namespace_badblock_count(ndns);
+	if (bb_count)
+		util_record_u64(rec, UTIL_FIELD_BADBLOCK_COUNT, bb_count);
+	return 0;
+}
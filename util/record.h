@@ -0,0 +1,164 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* Copyright(c) 2018 Intel Corporation. All rights reserved. */
+#ifndef __NDCTL_RECORD_H__
+#define __NDCTL_RECORD_H__
+#include <stdio.h>
+#include <stdbool.h>
+#include <ndctl/libndctl.h>
+#include <ccan/short_types/short_types.h>
+
+/*
+ * Flat, one record per object, alternatives to the json_object hierarchy
+ * built by the util_*_to_json() helpers. Records carry the same field
+ * names as the json output, nested arrays (badblocks, mappings, firmware)
+ * are not represented, and the parent device is identified by the "bus"
+ * and "region" fields.
+ */
+enum util_record_format {
+	UTIL_RECORD_FMT_JSON,
+	UTIL_RECORD_FMT_CSV,
+	UTIL_RECORD_FMT_NDJSON,
+	UTIL_RECORD_FMT_BINARY,
+};
+
+enum util_record_type {
+	UTIL_RECORD_BUS,
+	UTIL_RECORD_DIMM,
+	UTIL_RECORD_REGION,
+	UTIL_RECORD_MAPPING,
+	UTIL_RECORD_NAMESPACE,
+	UTIL_RECORD_TYPE_MAX,
+};
+
+/*
+ * Field ids are stable, they are the field keys of the binary format.
+ * Only append new fields.
+ */
+enum util_record_field {
+	UTIL_FIELD_DEV,
+	UTIL_FIELD_BUS,
+	UTIL_FIELD_REGION,
+	UTIL_FIELD_PROVIDER,
+	UTIL_FIELD_SCRUB_STATE,
+	UTIL_FIELD_ID,
+	UTIL_FIELD_HANDLE,
+	UTIL_FIELD_PHYS_ID,
+	UTIL_FIELD_STATE,
+	UTIL_FIELD_FLAG_FAILED_MAP,
+	UTIL_FIELD_FLAG_FAILED_SAVE,
+	UTIL_FIELD_FLAG_FAILED_ARM,
+	UTIL_FIELD_FLAG_FAILED_RESTORE,
+	UTIL_FIELD_FLAG_FAILED_FLUSH,
+	UTIL_FIELD_FLAG_SMART_EVENT,
+	UTIL_FIELD_HEALTH_STATE,
+	UTIL_FIELD_TEMPERATURE,
+	UTIL_FIELD_CTRL_TEMPERATURE,
+	UTIL_FIELD_SPARES,
+	UTIL_FIELD_ALARM_TEMPERATURE,
+	UTIL_FIELD_ALARM_CTRL_TEMPERATURE,
+	UTIL_FIELD_ALARM_SPARES,
+	UTIL_FIELD_ALARM_ENABLED_TEMPERATURE,
+	UTIL_FIELD_TEMPERATURE_THRESHOLD,
+	UTIL_FIELD_ALARM_ENABLED_CTRL_TEMPERATURE,
+	UTIL_FIELD_CTRL_TEMPERATURE_THRESHOLD,
+	UTIL_FIELD_ALARM_ENABLED_SPARES,
+	UTIL_FIELD_SPARES_THRESHOLD,
+	UTIL_FIELD_LIFE_USED,
+	UTIL_FIELD_SHUTDOWN_STATE,
+	UTIL_FIELD_SHUTDOWN_COUNT,
+	UTIL_FIELD_SIZE,
+	UTIL_FIELD_AVAILABLE_SIZE,
+	UTIL_FIELD_MAX_AVAILABLE_EXTENT,
+	UTIL_FIELD_TYPE,
+	UTIL_FIELD_NUMA_NODE,
+	UTIL_FIELD_ISET_ID,
+	UTIL_FIELD_BADBLOCK_COUNT,
+	UTIL_FIELD_PERSISTENCE_DOMAIN,
+	UTIL_FIELD_DIMM,
+	UTIL_FIELD_OFFSET,
+	UTIL_FIELD_LENGTH,
+	UTIL_FIELD_POSITION,
+	UTIL_FIELD_MODE,
+	UTIL_FIELD_MAP,
+	UTIL_FIELD_UUID,
+	UTIL_FIELD_RAW_UUID,
+	UTIL_FIELD_SECTOR_SIZE,
+	UTIL_FIELD_BLOCKDEV,
+	UTIL_FIELD_CHARDEV,
+	UTIL_FIELD_NAME,
+	UTIL_FIELD_MAX,
+};
+
+enum util_record_kind {
+	UTIL_RECORD_NONE,
+	UTIL_RECORD_STR,
+	UTIL_RECORD_U64,
+	UTIL_RECORD_S64,
+	UTIL_RECORD_DOUBLE,
+	UTIL_RECORD_BOOL,
+};
+
+struct util_record_value {
+	enum util_record_kind kind;
+	union {
+		size_t str;
+		u64 num;
+		s64 snum;
+		double dbl;
+		bool flag;
+	};
+};
+
+/*
+ * struct util_record - writer for the flat output formats
+ * @headers: record types that have had a csv header emitted
+ * @error: first failure building the record, returned by util_record_end()
+ * @strbuf: copies of string values for the record being built
+ *
+ * The binary format starts with the 4 byte magic "ndr1". Each record is a
+ * little-endian u16 byte length of the remainder of the record, a u8
+ * enum util_record_type, and a u8 field count, followed by the fields.
+ * Each field is a u8 enum util_record_field, a u8 enum util_record_kind,
+ * and the value: 8 bytes little-endian for u64, s64, and double, 1 byte
+ * for bool, and a little-endian u16 length plus the bytes for strings.
+ */
+struct util_record {
+	FILE *f_out;
+	enum util_record_format format;
+	enum util_record_type type;
+	unsigned long headers;
+	bool magic;
+	int error;
+	struct util_record_value values[UTIL_FIELD_MAX];
+	char *strbuf;
+	size_t strbuf_len;
+	size_t strbuf_size;
+};
+
+int util_record_parse_format(const char *format,
+		enum util_record_format *fmt);
+void util_record_init(struct util_record *rec, FILE *f_out,
+		enum util_record_format format);
+void util_record_release(struct util_record *rec);
+void util_record_begin(struct util_record *rec, enum util_record_type type);
+int util_record_end(struct util_record *rec);
+void util_record_str(struct util_record *rec, enum util_record_field field,
+		const char *val);
+void util_record_u64(struct util_record *rec, enum util_record_field field,
+		u64 val);
+void util_record_s64(struct util_record *rec, enum util_record_field field,
+		s64 val);
+void util_record_double(struct util_record *rec, enum util_record_field field,
+		double val);
+void util_record_bool(struct util_record *rec, enum util_record_field field,
+		bool val);
+
+void util_bus_to_record(struct ndctl_bus *bus, struct util_record *rec);
+void util_dimm_to_record(struct ndctl_dimm *dimm, struct util_record *rec);
+void util_mapping_to_record(struct ndctl_mapping *mapping,
+		struct util_record *rec);
+int util_namespace_to_record(struct ndctl_namespace *ndns,
+		struct util_record *rec, unsigned long flags);
+int util_dimm_health_to_record(struct ndctl_dimm *dimm,
+		struct util_record *rec);
+#endif /* __NDCTL_RECORD_H__ */